@@ -2,6 +2,10 @@
 
 namespace ipmsg {
 
+std::atomic<uint64_t> ConfigVarBase::s_epoch{0};
+std::atomic<uint64_t> ConfigVarBase::s_modified{0};
+thread_local const ConfigVarBase* ConfigVarBase::t_loading = nullptr;
+
 // Config::ConVarBaseMap Config::s_datas;
 ConfigVarBase::ptr Config::LookupBase(const std::string& name) {
     RWMutexType::ReadLock lock(GetMutex());
@@ -14,60 +18,191 @@ ConfigVarBase::ptr Config::LookupBase(const std::string& name) {
 }
 
 
+/// FNV-1a
+static uint64_t HashBytes(uint64_t h, const char* data, size_t len) {
+    for(size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t HashCombine(uint64_t h, uint64_t v) {
+    return HashBytes(h, (const char*)&v, sizeof(v));
+}
+
+/**
+ * @brief 待转换的配置参数及其来源节点
+ */
+struct LoadItem {
+    ConfigVarBase::ptr var;
+    YAML::Node node;
+    uint64_t hash;
+};
+
+/**
+ * @brief 可按名称查找的节点的子树哈希值
+ */
+struct NodeHash {
+    uint64_t hash;
+    /// 子树之后第一个节点的下标, 用于跳过整棵子树
+    size_t end;
+};
+
+/**
+ * @brief 先序遍历节点, 计算子树的哈希值
+ * @details 序列内部的节点不按名称查找, 只参与哈希, 不单独记录
+ * @param[in] record 是否记录该节点
+ */
+static uint64_t HashMember(const YAML::Node& node, std::vector<NodeHash>& output, bool record = true) {
+    size_t pos = output.size();
+    if(record) {
+        output.push_back(NodeHash{0, 0});
+    }
+    uint64_t h = HashCombine(14695981039346656037ull, node.Type());
+    if(node.IsScalar()) {
+        const std::string& v = node.Scalar();
+        h = HashBytes(h, v.c_str(), v.size() + 1);
+    } else if(node.IsSequence()) {
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            h = HashCombine(h, HashMember(*it, output, false));
+        }
+    } else if(node.IsMap()) {
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            const std::string& key = it->first.Scalar();
+            h = HashBytes(h, key.c_str(), key.size() + 1);
+            h = HashCombine(h, HashMember(it->second, output, record));
+        }
+    }
+    /// 0保留给"没有加载过"
+    h = h ? h : 1;
+    if(record) {
+        output[pos].hash = h;
+        output[pos].end = output.size();
+    }
+    return h;
+}
+
+/**
+ * @brief 增量加载的状态, 由加载锁保护
+ */
+struct LoadState {
+    Mutex mutex;
+    /// 上次加载时各个Map节点的子树哈希值
+    std::map<std::string, uint64_t> hashes;
+    /// 上次加载开始时的外部修改次数
+    uint64_t modified = (uint64_t)-1;
+};
+
+static LoadState& GetLoadState() {
+    static LoadState s_state;
+    return s_state;
+}
+
 ///"A.B", 10
 /// A:
 ///     B: 10
 ///     C: str
+/**
+ * @brief 先序遍历节点, 收集有对应配置参数的节点, 父节点排在子节点之前
+ * @param[in] hashes HashMember计算的子树哈希值, idx 当前节点的下标
+ * @param[in] prev 上次加载的Map子树哈希值, 为nullptr时不跳过子树
+ * @param[out] next 本次加载的Map子树哈希值
+ */
 static void ListAllMember(const std::string& prefix,
                           const YAML::Node& node,
-                          std::list<std::pair<std::string, const YAML::Node> >& output) {
-
-     /// @brief 如果前缀【配置参数】有非法字符 -- 不属于这段字串【abcdefghikjlmnopqrstuvwxyz._012345678】
-     if(prefix.find_first_not_of("abcdefghikjlmnopqrstuvwxyz._012345678")
+                          const std::vector<NodeHash>& hashes,
+                          size_t& idx,
+                          const std::map<std::string, uint64_t>* prev,
+                          std::map<std::string, uint64_t>& next,
+                          std::vector<LoadItem>& output) {
+    const NodeHash& nh = hashes[idx++];
+     /// @brief 如果前缀【配置参数】有非法字符 -- 不属于这段字串【abcdefghikjlmnopqrstuvwxyz._0123456789】
+     if(prefix.find_first_not_of("abcdefghikjlmnopqrstuvwxyz._0123456789")
             != std::string::npos) {
         LOG_ERROR(LOG_ROOT()) << "Config invalid name: " << prefix << " : " << node;
+        idx = nh.end;
         return;
     }
 
-    /// @brief 如果没有非法字符,添加到list里面去,2次，第一次prefix : "" 第二次 prefix:"logs"
-    output.push_back(std::make_pair(prefix, node));
-    // std::cout << node << std::endl;
+    if(node.IsMap()) {
+        if(prev) {
+            auto it = prev->find(prefix);
+            if(it != prev->end() && it->second == nh.hash) {
+                /// 子树没有变化, 沿用其中所有Map节点的记录
+                std::string sub = prefix.empty() ? "" : prefix + ".";
+                for(auto i = prev->lower_bound(sub); i != prev->end()
+                        && i->first.compare(0, sub.size(), sub) == 0; ++i) {
+                    next.insert(*i);
+                }
+                next[prefix] = nh.hash;
+                idx = nh.end;
+                return;
+            }
+        }
+        next[prefix] = nh.hash;
+    }
+
+    if(!prefix.empty()) {
+        ConfigVarBase::ptr var = Config::LookupBase(prefix); /// 根据map查找key
+        if(var) {
+            output.push_back(LoadItem{var, node, nh.hash});
+        }
+    }
+
     /// @brief 如果是Map[Object] -- xx: , 遍历它
     if(node.IsMap()) {
         for(auto it = node.begin(); it != node.end(); ++it) {
             ListAllMember(prefix.empty() ? it->first.Scalar()
-                    : prefix + "." + it->first.Scalar(), it->second, output);
+                    : prefix + "." + it->first.Scalar(), it->second
+                    , hashes, idx, prev, next, output);
         }
     }
-
 }
 
-void Config::LoadFromYaml(const YAML::Node& root) {
-    std::list<std::pair<std::string, const YAML::Node> > all_nodes;
+size_t Config::LoadFromYaml(const YAML::Node& root) {
+    LoadState& state = GetLoadState();
+    Mutex::Lock lock(state.mutex);
+    /// 先取修改次数, 加载期间其他线程的修改会让下次加载不跳过子树
+    uint64_t modified = ConfigVarBase::s_modified.load(std::memory_order_acquire);
+
+    std::vector<NodeHash> hashes;
+    HashMember(root, hashes);
+
+    std::vector<LoadItem> all_nodes;
+    std::map<std::string, uint64_t> next;
+    size_t idx = 0;
     // std::cout << root << std::endl;
-    ListAllMember("", root, all_nodes);
+    ListAllMember("", root, hashes, idx
+            ,modified == state.modified ? &state.hashes : nullptr, next, all_nodes);
 
+    size_t loaded = 0;
     for(auto& i : all_nodes) {
-        std::string key = i.first;
-        if(key.empty()) {
+        ConfigVarBase::ptr& var = i.var;
+        /// 来源子树没有变化, 且之后没有通过setValue修改过, 跳过
+        if(var->m_loadHash == i.hash
+                && var->m_loadVersion == var->getVersion()) {
             continue;
         }
-
-        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-        ConfigVarBase::ptr var = LookupBase(key); /// 根据map查找key
-
-        /// 如果找到配置参数
-        if(var) {
-            /// 如果不是纯量,可能是yml文件里面的相应位置有 【非空格】 键 例如 Tab
-            if(i.second.IsScalar()){
-                var->fromString(i.second.Scalar());
-            }else {
-                std::stringstream ss;
-                ss << i.second;
-                var->fromString(ss.str());
-            }
+        ++loaded;
+        ConfigVarBase::t_loading = var.get();
+        bool ok = var->fromNode(i.node);
+        ConfigVarBase::t_loading = nullptr;
+        if(ok) {
+            var->m_loadHash = i.hash;
+            var->m_loadVersion = var->getVersion();
+        } else {
+            var->m_loadHash = 0;
+            /// 转换失败的参数所在的子树下次不能跳过
+            modified = (uint64_t)-1;
         }
     }
+
+    state.hashes.swap(next);
+    state.modified = modified;
+    /// 值变化时setValue已经更新过纪元, 这里保证整批加载后缓存一定刷新
+    ConfigVarBase::BumpEpoch();
+    return loaded;
 }
 
 void Config::Visit(std::function<void(ConfigVarBase::ptr)> cb) {
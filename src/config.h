@@ -11,6 +11,8 @@
 #ifndef _CONFIG_H__
 #define _CONFIG_H__
 #include <memory>
+#include <atomic>
+#include <type_traits>
 #include <boost/lexical_cast.hpp>
 #include <yaml-cpp/yaml.h>
 #include <functional> /// 回调函数
@@ -24,6 +26,7 @@
 #include <iostream> /// ostream 用于operator<< 重载
 #include "log.h"
 #include "util.h"
+#include "rcu.h"
 
 namespace ipmsg {
 
@@ -44,6 +47,8 @@ public:
         ,m_description(description) {
         // std::cout << "Enter ConfigVarBase - " << name << " - " << description << std::endl;
         std::transform(m_name.begin(), m_name.end(), m_name.begin(), ::tolower); /// 转换成小写
+        /// 新注册的参数可能位于上次加载时跳过的子树中
+        s_modified.fetch_add(1, std::memory_order_release);
     }
 
     /**
@@ -71,13 +76,65 @@ public:
      */
     virtual bool fromString(const std::string& val) = 0;
 
+    /**
+     * @brief 从YAML节点初始化值
+     * @return 转换成功返回true
+     */
+    virtual bool fromNode(const YAML::Node& node) = 0;
+
     virtual std::string getTypeName() const = 0;
 
+    /**
+     * @brief 返回值的版本号, 值每变化一次加1
+     */
+    uint64_t getVersion() const { return m_version.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 返回全局配置纪元
+     * @details 任意配置参数的值发生变化时加1, 用于判断缓存的值是否过期
+     */
+    static uint64_t GetEpoch() {
+        return s_epoch.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 使所有缓存的配置值失效
+     */
+    static void BumpEpoch() {
+        s_epoch.fetch_add(1, std::memory_order_release);
+    }
+
+protected:
+    /**
+     * @brief 值已经变化, 更新版本号及全局纪元
+     */
+    void markChanged() {
+        m_version.fetch_add(1, std::memory_order_release);
+        /// 只有LoadFromYaml正在转换的参数自身不算修改, 回调中修改的其他参数照常计数
+        if(t_loading != this) {
+            s_modified.fetch_add(1, std::memory_order_release);
+        }
+        BumpEpoch();
+    }
+
 private:
+    friend class Config;
+    /// 全局配置纪元
+    static std::atomic<uint64_t> s_epoch;
+    /// LoadFromYaml以外的修改次数, 包括新注册的参数
+    static std::atomic<uint64_t> s_modified;
+    /// 当前线程中LoadFromYaml正在转换的参数
+    static thread_local const ConfigVarBase* t_loading;
     // 配置参数的名称
     std::string m_name;
     // 配置参数的描述
     std::string m_description;
+    /// 值的版本号
+    std::atomic<uint64_t> m_version{0};
+    /// 上次从YAML加载时源节点的哈希值, 0表示没有加载过
+    uint64_t m_loadHash = 0;
+    /// 上次从YAML加载后的版本号
+    uint64_t m_loadVersion = 0;
 };
 
 /**
@@ -355,6 +412,224 @@ public:
 
 
 /**
+ * @brief YAML节点转换成T类型
+ * @details 纯量直接交给LexicalCast<std::string, T>, 不再序列化成字符串重新解析;
+ *          其他节点序列化后交给LexicalCast<std::string, T>. 容器的偏特化只遍历一次节点,
+ *          逐个元素递归转换. 自定义类型可以特化NodeCast直接读取节点
+ */
+template<class T>
+class NodeCast {
+public:
+    T operator() (const YAML::Node& node) {
+        if(node.IsScalar()) {
+            return LexicalCast<std::string, T>()(node.Scalar());
+        }
+        std::stringstream ss;
+        ss << node;
+        return LexicalCast<std::string, T>()(ss.str());
+    }
+};
+
+/**
+ *  @brief 对vector容器的偏特化，YAML节点转换成vector类型
+ */
+template<class T>
+class NodeCast<std::vector<T> > {
+public:
+    std::vector<T> operator() (const YAML::Node& node) {
+        std::vector<T> vec;
+        vec.reserve(node.size());
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            vec.push_back(NodeCast<T>()(*it));
+        }
+        return vec;
+    }
+};
+
+/**
+ *  @brief 对list容器的偏特化，YAML节点转换成list类型
+ */
+template<class T>
+class NodeCast<std::list<T> > {
+public:
+    std::list<T> operator() (const YAML::Node& node) {
+        std::list<T> vec;
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            vec.push_back(NodeCast<T>()(*it));
+        }
+        return vec;
+    }
+};
+
+/**
+ *  @brief 对set容器的偏特化，YAML节点转换成set类型
+ */
+template<class T>
+class NodeCast<std::set<T> > {
+public:
+    std::set<T> operator() (const YAML::Node& node) {
+        std::set<T> vec;
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            vec.insert(NodeCast<T>()(*it));
+        }
+        return vec;
+    }
+};
+
+/**
+ *  @brief 对unordered_set容器的偏特化，YAML节点转换成unordered_set类型
+ */
+template<class T>
+class NodeCast<std::unordered_set<T> > {
+public:
+    std::unordered_set<T> operator() (const YAML::Node& node) {
+        std::unordered_set<T> vec;
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            vec.insert(NodeCast<T>()(*it));
+        }
+        return vec;
+    }
+};
+
+/**
+ *  @brief 对map容器的偏特化，YAML节点转换成map类型
+ */
+template<class T>
+class NodeCast<std::map<std::string, T> > {
+public:
+    std::map<std::string, T> operator() (const YAML::Node& node) {
+        std::map<std::string, T> vec;
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            vec.insert(std::make_pair(it->first.Scalar(), NodeCast<T>()(it->second)));
+        }
+        return vec;
+    }
+};
+
+/**
+ *  @brief 对unordered_map容器的偏特化，YAML节点转换成unordered_map类型
+ */
+template<class T>
+class NodeCast<std::unordered_map<std::string, T> > {
+public:
+    std::unordered_map<std::string, T> operator() (const YAML::Node& node) {
+        std::unordered_map<std::string, T> vec;
+        for(auto it = node.begin(); it != node.end(); ++it) {
+            vec.insert(std::make_pair(it->first.Scalar(), NodeCast<T>()(it->second)));
+        }
+        return vec;
+    }
+};
+
+/**
+ * @brief 配置参数值的存放方式, 读取不加锁
+ * @details 默认实现: 值保存在堆上的不可变对象中, 修改时原子地替换指针,
+ *          旧对象通过RCU在所有读者离开后释放. 读者拿到的快照在析构前不会被释放
+ */
+template<class T, bool Atomic = std::is_trivially_copyable<T>::value && sizeof(T) <= 8>
+class ConfigValueHolder {
+public:
+    /**
+     * @brief 只读快照, 持有期间处于RCU读临界区
+     * @details 不能跨线程使用, 持有期间不能让出协程, 也不能修改配置
+     */
+    class Snapshot {
+    public:
+        explicit Snapshot(const std::atomic<const T*>& ptr)
+            :m_locked(true) {
+            Rcu::ReadLock();
+            m_ptr = ptr.load(std::memory_order_acquire);
+        }
+        Snapshot(Snapshot&& rhs)
+            :m_ptr(rhs.m_ptr)
+            ,m_locked(rhs.m_locked) {
+            rhs.m_locked = false;
+        }
+        ~Snapshot() {
+            if(m_locked) {
+                Rcu::ReadUnlock();
+            }
+        }
+        const T& operator*() const { return *m_ptr; }
+        const T* operator->() const { return m_ptr; }
+        const T* get() const { return m_ptr; }
+    private:
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+    private:
+        const T* m_ptr;
+        bool m_locked;
+    };
+
+    explicit ConfigValueHolder(const T& v)
+        :m_ptr(new T(v)) {
+    }
+
+    ~ConfigValueHolder() {
+        delete m_ptr.load();
+    }
+
+    Snapshot snapshot() const {
+        return Snapshot(m_ptr);
+    }
+
+    T load() const {
+        RcuReadLock lock;
+        return *m_ptr.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 发布新值, 旧值在宽限期后释放
+     */
+    void store(const T& v) {
+        const T* old = m_ptr.exchange(new T(v), std::memory_order_acq_rel);
+        Rcu::Retire(const_cast<T*>(old));
+    }
+private:
+    std::atomic<const T*> m_ptr;
+};
+
+/**
+ * @brief 不超过8字节的平凡可复制类型直接保存在std::atomic中
+ */
+template<class T>
+class ConfigValueHolder<T, true> {
+public:
+    /**
+     * @brief 快照即值的副本
+     */
+    class Snapshot {
+    public:
+        explicit Snapshot(const T& v)
+            :m_val(v) {
+        }
+        const T& operator*() const { return m_val; }
+        const T* operator->() const { return &m_val; }
+        const T* get() const { return &m_val; }
+    private:
+        T m_val;
+    };
+
+    explicit ConfigValueHolder(const T& v)
+        :m_val(v) {
+    }
+
+    Snapshot snapshot() const {
+        return Snapshot(load());
+    }
+
+    T load() const {
+        return m_val.load(std::memory_order_acquire);
+    }
+
+    void store(const T& v) {
+        m_val.store(v, std::memory_order_release);
+    }
+private:
+    std::atomic<T> m_val;
+};
+
+/**
  * @brief 配置参数模板子类,保存对应类型的参数值
  * @details T 参数的具体类型
  *          FromStr 从std::string转换成T类型的仿函数
@@ -370,6 +645,44 @@ class ConfigVar : public ConfigVarBase {
 public:
     typedef std::shared_ptr<ConfigVar> ptr; // [T=int] 不是类型名
     typedef RWMutex RWMutexType;
+    typedef typename ConfigValueHolder<T>::Snapshot Snapshot;
+
+    /**
+     * @brief 配置值的本地缓存
+     * @details 保存值的副本及读取时的全局纪元, 每次访问只比较一次纪元,
+     *          纪元变化时才重新读取. 本身不是线程安全的, 一般定义为thread_local或局部变量
+     * @code
+     *  static thread_local ConfigVar<int>::Cached s_port(g_port);
+     *  int port = *s_port;
+     * @endcode
+     */
+    class Cached {
+    public:
+        explicit Cached(const std::shared_ptr<ConfigVar>& var)
+            :m_var(var)
+            ,m_epoch(ConfigVarBase::GetEpoch())
+            ,m_val(var->getValue()) {
+        }
+
+        /**
+         * @brief 返回缓存的值, 过期时先刷新
+         */
+        const T& get() {
+            uint64_t epoch = ConfigVarBase::GetEpoch();
+            if(__builtin_expect(epoch != m_epoch, 0)) {
+                m_epoch = epoch;
+                m_val = m_var->getValue();
+            }
+            return m_val;
+        }
+
+        const T& operator*() { return get(); }
+        const T* operator->() { return &get(); }
+    private:
+        std::shared_ptr<ConfigVar> m_var;
+        uint64_t m_epoch;
+        T m_val;
+    };
     /**
      * @brief 更改配置时调用回调函数,通知系统
      * @param[in] old_value 原值
@@ -399,16 +712,15 @@ public:
     std::string toString() override {
         try {
             // return boost::lexical_cast<std::string>(m_val);
-            RWMutexType::ReadLock lock(m_mutex);
             /**
              *  ToStr std::string operator() (const T&)
              *  但是基础类型转换可以交给LexicalCast 来做
              */
-            return ToStr()(m_val);
+            return ToStr()(*getSnapshot());
         }
         catch (std::exception& e) {
             LOG_ERROR(LOG_ROOT()) << "ConfigVar::toString() exception" << e.what()
-                << " convert : " << typeid(m_val).name() << " to string ";
+                << " convert : " << typeid(T).name() << " to string ";
         }
 
         return "";
@@ -428,29 +740,62 @@ public:
         }
         catch (std::exception& e) {
             LOG_ERROR(LOG_ROOT()) << "ConfigVar::fromString() exception" << e.what()
-                << " convert : string to " << typeid(m_val).name()
+                << " convert : string to " << typeid(T).name()
                 << " - " << val;
         }
         return false;
     }
 
-    const T getValue() {
-        RWMutexType::ReadLock lock(m_mutex);
-        return m_val;
+    /**
+     * @brief 从YAML节点初始化值, 不经过字符串
+     * @details 使用默认的FromStr时由NodeCast一次遍历节点完成转换,
+     *          自定义的FromStr只对非纯量节点序列化一次
+     */
+    bool fromNode(const YAML::Node& node) override {
+        try {
+            setValue(castNode(node, std::is_same<FromStr, LexicalCast<std::string, T> >()));
+            return true;
+        }
+        catch (std::exception& e) {
+            LOG_ERROR(LOG_ROOT()) << "ConfigVar::fromNode() exception" << e.what()
+                << " convert : node to " << typeid(T).name()
+                << " - " << node;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 返回参数值的副本, 不加锁
+     */
+    const T getValue() const {
+        return m_val.load();
+    }
+
+    /**
+     * @brief 返回参数值的只读快照, 不加锁也不复制容器
+     * @details 快照在析构前保持有效, 期间的修改不影响快照内容;
+     *          持有期间不能让出协程, 也不能在同一线程中修改配置
+     */
+    Snapshot getSnapshot() const {
+        return m_val.snapshot();
     }
 
     void setValue(const T& v) {
+        /// 写者之间互斥, 读者不受影响
+        RWMutexType::WriteLock wlock(m_writeMutex);
         {
+            /// 写入很少, 复制旧值, 避免回调在RCU读临界区内执行
+            const T old = m_val.load();
             RWMutexType::ReadLock lock(m_mutex);
-            if(v == m_val) {  /// 需要在main.cpp 中的Person类下重载== 操作符
+            if(v == old) {  /// 需要在main.cpp 中的Person类下重载== 操作符
                 return;
             }
             for(auto& i : m_cbs) {
-                i.second(m_val, v); /// 调用回调函数【oldvalue, newvalue】
+                i.second(old, v); /// 调用回调函数【oldvalue, newvalue】
             }
         } /// 出了域释放（析构）ReadLock
-        RWMutexType::WriteLock lock(m_mutex);
-        m_val = v;
+        m_val.store(v);
+        markChanged();
     }
 
     std::string getTypeName() const override { return typeid(T).name(); }
@@ -498,8 +843,31 @@ public:
     }
 
 private:
-    T m_val;
+    /**
+     * @brief 默认的FromStr, 由NodeCast直接转换
+     */
+    T castNode(const YAML::Node& node, std::true_type) {
+        return NodeCast<T>()(node);
+    }
+
+    /**
+     * @brief 自定义的FromStr, 非纯量节点序列化后转换
+     */
+    T castNode(const YAML::Node& node, std::false_type) {
+        if(node.IsScalar()) {
+            return FromStr()(node.Scalar());
+        }
+        std::stringstream ss;
+        ss << node;
+        return FromStr()(ss.str());
+    }
+
+private:
+    ConfigValueHolder<T> m_val;
+    /// 保护回调函数组
     RWMutexType m_mutex;
+    /// 串行化setValue
+    RWMutexType m_writeMutex;
     /**
      *  @brief 变更回调函数组, uint64_t key,要求唯一，一般可以用hash值
      *  @detail 回调函数【functional】没法判断是否是同一个funcion（）
@@ -583,8 +951,12 @@ public:
 
     /**
      * @brief 使用YAML::Node初始化配置模块
+     * @details 增量加载: 记录每个配置参数来源子树的哈希值, 子树没有变化
+     *          且参数没有被程序修改过时跳过转换. 上次加载后没有其他修改时,
+     *          哈希值不变的整棵子树连查找也跳过
+     * @return 实际转换的配置参数个数
      */
-    static void LoadFromYaml(const YAML::Node& root);
+    static size_t LoadFromYaml(const YAML::Node& root);
 
     /**
      * @brief 查找配置参数,返回配置参数的基类
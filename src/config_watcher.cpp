@@ -0,0 +1,304 @@
+#include "config_watcher.h"
+#include "config.h"
+#include "log.h"
+#include <algorithm>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+namespace ipmsg {
+
+static Logger::ptr g_logger = LOG_NAME("system");
+
+/// 会引起重新加载的事件: 写完关闭, 移入(rename保存), 删除, 移出
+static const uint32_t s_watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM;
+
+static uint64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static bool IsConfigFile(const std::string& name) {
+    if(name.empty() || name[0] == '.') {
+        return false;
+    }
+    size_t pos = name.rfind('.');
+    if(pos == std::string::npos) {
+        return false;
+    }
+    std::string ext = name.substr(pos);
+    return ext == ".yml" || ext == ".yaml";
+}
+
+/**
+ * @brief 把src合并到dst, 两边都是Map时逐个键合并, 否则src覆盖dst
+ */
+static void MergeNode(YAML::Node& dst, const YAML::Node& src) {
+    for(auto it = src.begin(); it != src.end(); ++it) {
+        const std::string& key = it->first.Scalar();
+        YAML::Node d = dst[key];
+        if(d.IsMap() && it->second.IsMap()) {
+            MergeNode(d, it->second);
+        } else {
+            dst[key] = YAML::Clone(it->second);
+        }
+    }
+}
+
+ConfigWatcher::ConfigWatcher(uint32_t debounce_ms)
+    :m_debounce(debounce_ms) {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_fd < 0) {
+        LOG_ERROR(g_logger) << "ConfigWatcher inotify_init1 errno=" << errno
+            << " errstr=" << strerror(errno);
+    }
+    if(pipe2(m_wakeup, O_NONBLOCK | O_CLOEXEC)) {
+        LOG_ERROR(g_logger) << "ConfigWatcher pipe2 errno=" << errno
+            << " errstr=" << strerror(errno);
+        m_wakeup[0] = m_wakeup[1] = -1;
+    }
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+    if(m_fd >= 0) {
+        close(m_fd);
+    }
+    if(m_wakeup[0] >= 0) {
+        close(m_wakeup[0]);
+        close(m_wakeup[1]);
+    }
+}
+
+bool ConfigWatcher::addPath(const std::string& path) {
+    struct stat st;
+    if(stat(path.c_str(), &st)) {
+        LOG_ERROR(g_logger) << "ConfigWatcher addPath " << path << " errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    bool is_dir = S_ISDIR(st.st_mode);
+    std::string dir = path;
+    std::string name;
+    if(!is_dir) {
+        size_t pos = path.rfind('/');
+        dir = pos == std::string::npos ? "." : (pos == 0 ? "/" : path.substr(0, pos));
+        name = path.substr(pos == std::string::npos ? 0 : pos + 1);
+    }
+    if(m_fd < 0) {
+        return false;
+    }
+    int wd = inotify_add_watch(m_fd, dir.c_str(), s_watch_mask);
+    if(wd < 0) {
+        LOG_ERROR(g_logger) << "ConfigWatcher inotify_add_watch " << dir << " errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    Mutex::Lock lock(m_mutex);
+    Watch& w = m_watches[wd];
+    w.dir = dir;
+    w.names.insert(name);
+    m_paths.push_back(std::make_pair(path, is_dir));
+    return true;
+}
+
+bool ConfigWatcher::start() {
+    bool rt = reload();
+    if(!m_thread && m_fd >= 0 && m_wakeup[0] >= 0) {
+        m_stopping = false;
+        m_thread.reset(new Thread(std::bind(&ConfigWatcher::run, this), "config_watch"));
+    }
+    return rt;
+}
+
+void ConfigWatcher::stop() {
+    if(!m_thread) {
+        return;
+    }
+    m_stopping = true;
+    char c = 0;
+    if(write(m_wakeup[1], &c, 1) < 0) {
+        /// 管道已满说明已经有未处理的唤醒
+    }
+    m_thread->join();
+    m_thread.reset();
+}
+
+bool ConfigWatcher::reload() {
+    return doReload(0);
+}
+
+ConfigWatcher::Stats ConfigWatcher::getStats() const {
+    Mutex::Lock lock(m_statsMutex);
+    return m_stats;
+}
+
+std::vector<std::string> ConfigWatcher::listFiles() {
+    std::vector<std::pair<std::string, bool> > paths;
+    {
+        Mutex::Lock lock(m_mutex);
+        paths = m_paths;
+    }
+    std::vector<std::string> files;
+    for(auto& i : paths) {
+        if(!i.second) {
+            files.push_back(i.first);
+            continue;
+        }
+        DIR* d = opendir(i.first.c_str());
+        if(!d) {
+            LOG_WARN(g_logger) << "ConfigWatcher opendir " << i.first << " errno=" << errno
+                << " errstr=" << strerror(errno);
+            continue;
+        }
+        std::vector<std::string> names;
+        while(struct dirent* dp = readdir(d)) {
+            if(IsConfigFile(dp->d_name)) {
+                names.push_back(dp->d_name);
+            }
+        }
+        closedir(d);
+        std::sort(names.begin(), names.end());
+        for(auto& n : names) {
+            files.push_back(i.first + "/" + n);
+        }
+    }
+    return files;
+}
+
+bool ConfigWatcher::doReload(uint64_t first_us) {
+    Mutex::Lock lock(m_reloadMutex);
+    uint64_t start = NowUs();
+    YAML::Node root;
+    std::vector<std::string> files = listFiles();
+    for(auto& f : files) {
+        YAML::Node node;
+        try {
+            node = YAML::LoadFile(f);
+        } catch(std::exception& e) {
+            /// 文件可能在列出后被删除或正在替换, 任何错误都保留原值
+            LOG_ERROR(g_logger) << "ConfigWatcher parse " << f << " failed: " << e.what()
+                << ", keep old config";
+            Mutex::Lock slock(m_statsMutex);
+            ++m_stats.failures;
+            return false;
+        }
+        if(node.IsMap()) {
+            MergeNode(root, node);
+        } else if(!node.IsNull()) {
+            LOG_ERROR(g_logger) << "ConfigWatcher parse " << f << " failed: root is not a map"
+                << ", keep old config";
+            Mutex::Lock slock(m_statsMutex);
+            ++m_stats.failures;
+            return false;
+        }
+    }
+    uint64_t parsed = NowUs();
+    size_t loaded = Config::LoadFromYaml(root);
+    uint64_t end = NowUs();
+
+    Stats stats;
+    {
+        Mutex::Lock slock(m_statsMutex);
+        ++m_stats.reloads;
+        m_stats.loaded = loaded;
+        m_stats.parse_us = parsed - start;
+        m_stats.apply_us = end - parsed;
+        m_stats.latency_us = first_us ? end - first_us : end - start;
+        m_stats.total_parse_us += m_stats.parse_us;
+        m_stats.total_apply_us += m_stats.apply_us;
+        stats = m_stats;
+    }
+    LOG_INFO(g_logger) << "ConfigWatcher reload files=" << files.size()
+        << " loaded=" << loaded << " parse_us=" << stats.parse_us
+        << " apply_us=" << stats.apply_us << " latency_us=" << stats.latency_us;
+    return true;
+}
+
+bool ConfigWatcher::readEvents() {
+    bool changed = false;
+    /// inotify_event按其自身对齐
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while(true) {
+        ssize_t len = read(m_fd, buf, sizeof(buf));
+        if(len <= 0) {
+            if(len < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        Mutex::Lock lock(m_mutex);
+        for(char* p = buf; p < buf + len;) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if(ev->mask & IN_Q_OVERFLOW) {
+                /// 事件丢失, 无法判断哪些文件变化
+                changed = true;
+                continue;
+            }
+            auto it = m_watches.find(ev->wd);
+            if(it == m_watches.end() || !ev->len) {
+                continue;
+            }
+            std::string name = ev->name;
+            if(it->second.names.count(name)
+                    || (it->second.names.count("") && IsConfigFile(name))) {
+                changed = true;
+                Mutex::Lock slock(m_statsMutex);
+                ++m_stats.events;
+            }
+        }
+    }
+    return changed;
+}
+
+void ConfigWatcher::run() {
+    struct pollfd fds[2];
+    fds[0].fd = m_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_wakeup[0];
+    fds[1].events = POLLIN;
+    uint64_t first = 0;
+    uint64_t deadline = 0;
+    while(!m_stopping) {
+        int timeout = -1;
+        if(deadline) {
+            uint64_t now = NowUs();
+            timeout = deadline > now ? (deadline - now + 999) / 1000 : 0;
+        }
+        int rt = poll(fds, 2, timeout);
+        if(rt < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR(g_logger) << "ConfigWatcher poll errno=" << errno
+                << " errstr=" << strerror(errno);
+            break;
+        }
+        if(fds[1].revents) {
+            char tmp[64];
+            while(read(m_wakeup[0], tmp, sizeof(tmp)) > 0);
+        }
+        uint64_t now = NowUs();
+        if((fds[0].revents & POLLIN) && readEvents()) {
+            if(!first) {
+                first = now;
+            }
+            /// 等到最后一次修改之后m_debounce毫秒, 但不超过第一次修改之后的10倍
+            deadline = std::min(now + m_debounce * 1000ull, first + m_debounce * 10000ull);
+        }
+        if(deadline && now >= deadline) {
+            doReload(first);
+            first = deadline = 0;
+        }
+    }
+}
+
+}
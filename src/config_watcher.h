@@ -0,0 +1,143 @@
+/**
+ * @file config_watcher.h
+ * @brief 配置文件监控, 文件变化后自动重新加载
+ */
+#ifndef __CONFIG_WATCHER_H__
+#define __CONFIG_WATCHER_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <atomic>
+#include <stdint.h>
+#include "thread.h"
+
+namespace ipmsg {
+
+/**
+ * @brief 用inotify监控配置文件及目录, 在后台线程中重新加载
+ * @details 一段时间内的多次修改合并为一次加载(去抖). 所有文件在后台线程中解析,
+ *          全部解析成功后合并成一个文档, 通过一次Config::LoadFromYaml应用,
+ *          配置参数的变化通过各自的addListener回调通知. 任一文件解析失败时
+ *          通过system日志器报告, 所有配置保持原值
+ */
+class ConfigWatcher {
+public:
+    typedef std::shared_ptr<ConfigWatcher> ptr;
+
+    /**
+     * @brief 加载统计, 时间单位为微秒
+     */
+    struct Stats {
+        /// 收到的相关文件事件数
+        uint64_t events = 0;
+        /// 成功加载次数
+        uint64_t reloads = 0;
+        /// 解析失败次数
+        uint64_t failures = 0;
+        /// 最近一次加载实际转换的配置参数个数
+        uint64_t loaded = 0;
+        /// 最近一次从第一个文件事件到加载完成的时间
+        uint64_t latency_us = 0;
+        /// 最近一次读取并解析文件的时间
+        uint64_t parse_us = 0;
+        /// 最近一次应用到配置参数的时间, 包括回调函数
+        uint64_t apply_us = 0;
+        /// 累计解析时间
+        uint64_t total_parse_us = 0;
+        /// 累计应用时间
+        uint64_t total_apply_us = 0;
+    };
+
+    /**
+     * @brief 构造函数
+     * @param[in] debounce_ms 最后一次修改之后等待的时间, 连续修改时最多推迟10倍
+     */
+    ConfigWatcher(uint32_t debounce_ms = 200);
+
+    /**
+     * @brief 析构函数, 停止后台线程
+     */
+    ~ConfigWatcher();
+
+    /**
+     * @brief 添加监控的配置文件或目录
+     * @details 目录下所有.yml/.yaml文件按文件名顺序加载, 同名参数后加载的生效;
+     *          监控文件时实际监控其所在目录, 以支持先写临时文件再rename的保存方式
+     * @return 路径不存在或无法监控时返回false
+     */
+    bool addPath(const std::string& path);
+
+    /**
+     * @brief 加载一次所有文件, 然后启动后台线程
+     * @return 首次加载是否成功
+     */
+    bool start();
+
+    /**
+     * @brief 停止后台线程
+     */
+    void stop();
+
+    /**
+     * @brief 立即重新加载所有文件
+     * @return 解析失败时返回false, 配置保持原值
+     */
+    bool reload();
+
+    /**
+     * @brief 返回加载统计
+     */
+    Stats getStats() const;
+private:
+    /**
+     * @brief 一个被监控的目录
+     */
+    struct Watch {
+        std::string dir;
+        /// 监控的文件名, 包含空串表示目录下所有配置文件
+        std::set<std::string> names;
+    };
+
+    void run();
+
+    /**
+     * @brief 读取inotify事件
+     * @return 是否有监控的文件发生变化
+     */
+    bool readEvents();
+
+    /**
+     * @brief 解析并应用所有文件
+     * @param[in] first_us 第一个文件事件的时间, 0表示手动加载
+     */
+    bool doReload(uint64_t first_us);
+
+    /**
+     * @brief 按添加顺序列出需要加载的文件
+     */
+    std::vector<std::string> listFiles();
+private:
+    uint32_t m_debounce;
+    int m_fd = -1;
+    /// 唤醒后台线程的管道
+    int m_wakeup[2] = {-1, -1};
+    std::atomic<bool> m_stopping{false};
+    Thread::ptr m_thread;
+    /// 保护m_paths, m_watches
+    mutable Mutex m_mutex;
+    /// 添加的路径及是否为目录
+    std::vector<std::pair<std::string, bool> > m_paths;
+    /// inotify watch descriptor -> 目录
+    std::map<int, Watch> m_watches;
+    /// 串行化加载
+    Mutex m_reloadMutex;
+    mutable Mutex m_statsMutex;
+    Stats m_stats;
+};
+
+}
+
+#endif
@@ -116,8 +116,13 @@ Fiber::Fiber() {
  */
 Fiber::Fiber(std::function<void()> cb, size_t stack_size)
     :m_id(++s_fiber_id)
-    ,m_cb(cb) {
+    ,m_cb(cb)
+    ,m_mdc(new LogMDC) {
     ++s_fiber_count;
+    /// 继承创建者的日志上下文
+    if(LogMDC* mdc = LogMDC::GetCurrent()) {
+        *m_mdc = *mdc;
+    }
     m_stack_size = stack_size ? stack_size : g_fiber_stack_size->getValue();
 
     m_stack = StackAllocator::Alloc(m_stack_size);
@@ -158,6 +163,7 @@ Fiber::~Fiber() {
             SetThis(nullptr);
         }
     }
+    delete m_mdc;
 
     LOG_DEBUG(g_logger) << "Fiber::~Fiber id=" << m_id
                               << " total=" << s_fiber_count;
@@ -174,6 +180,9 @@ void Fiber::reset(std::function<void()> cb) {
             || m_state == STATE_EXCEPT
             || m_state == STATE_INIT);
     m_cb = cb;
+    /// 复用的协程重新继承调用者的日志上下文
+    LogMDC* mdc = LogMDC::GetCurrent();
+    *m_mdc = mdc ? *mdc : LogMDC();
     if(getcontext(&m_ctx)) {
         ASSERT_MACRO2(false, "getcontext");
     }
@@ -213,6 +222,7 @@ void Fiber::swapOut() {
 //设置当前协程
 void Fiber::SetThis(Fiber* f) {
     t_fiber = f;
+    LogMDC::SetCurrent(f ? f->m_mdc : nullptr);
 }
 
 /**
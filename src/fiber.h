@@ -9,6 +9,7 @@
 namespace ipmsg {
 
 class Scheduler;
+class LogMDC;
 
 /// shared_from_this 在构造函数中无法使用，因为没有构建完成
 class Fiber : public std::enable_shared_from_this<Fiber> {
@@ -71,7 +72,7 @@ public:
 
 public:
     /**
-     * @brief 设置当前线程的运行协程
+     * @brief 设置当前线程的运行协程, 同时切换日志上下文
      * @param[in] f 运行协程
      */
     static void SetThis(Fiber* f);
@@ -121,6 +122,8 @@ private:
     void* m_stack = nullptr;
     /// 协程运行函数
     std::function<void()> m_cb;
+    /// 协程的日志上下文, 主协程为nullptr(使用线程的上下文)
+    LogMDC* m_mdc = nullptr;
 };
 
 
@@ -2,6 +2,7 @@
 #define __IPMSG_H__
 
 #include "config.h"
+#include "config_watcher.h"
 #include "log.h"
 #include "util.h"
 #include "singleton.h"
@@ -9,5 +10,6 @@
 #include "macro.h"
 #include "mutex.h"
 #include "fiber.h"
+#include "rcu.h"
 
 #endif // __IPMSG_H__
@@ -1,9 +1,33 @@
 #include <map>
+#include <unordered_set>
+#include <deque>
+#include <algorithm>
+#include <string.h>
 #include <cstdarg>
+#include <cmath>
 #include <functional>
 #include "log.h"
 #include "config.h"
+#include "rcu.h"
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <stddef.h>
+#include <signal.h>
+#include <execinfo.h>
+#include <dirent.h>
+#include <zlib.h>
+#include <cxxabi.h>
+#include <iomanip>
+#include <typeinfo>
 
 namespace ipmsg {
 
@@ -47,12 +71,178 @@ LogLevel::Level LogLevel::FromString(const std::string& str) {
 #undef XX
 }
 
-LogEventWrap::LogEventWrap(LogEvent::ptr e)
-	:m_event(e){
+LogEventWrap::LogEventWrap(LogEvent::ptr e, uint64_t suppressed)
+	:m_event(std::move(e))
+	,m_suppressed(suppressed) {
 }
 
 LogEventWrap::~LogEventWrap() {
-	m_event->getLogger()->log(m_event->getLevel(), m_event);
+	if (m_suppressed) {
+		m_event->addSuppressed(m_suppressed);
+	}
+	m_event->m_logger->log(m_event->getLevel(), *m_event);
+}
+
+void LogFields::clear() {
+	m_count = 0;
+	m_more.clear();
+	m_data.clear();
+}
+
+void LogFields::setString(Field& f, const char* s, size_t len) {
+	f.type = STRING;
+	f.s.off = m_data.size();
+	f.s.len = len;
+	m_data.append(s, len);
+}
+
+/// 当前协程的日志上下文, nullptr时使用线程自己的
+static thread_local LogMDC* t_mdc = nullptr;
+
+const std::string* LogMDC::find(const char* key, size_t len) const {
+	for (auto& i : m_entries) {
+		if (i.first.size() == len && memcmp(i.first.data(), key, len) == 0) {
+			return &i.second;
+		}
+	}
+	return nullptr;
+}
+
+/// 线程自己的上下文是否已析构, 线程退出阶段(如析构thread_local对象时)的日志不再带上下文
+static thread_local bool t_mdc_destroyed = false;
+
+struct ThreadMDC {
+	LogMDC mdc;
+	~ThreadMDC() {
+		t_mdc_destroyed = true;
+	}
+};
+
+LogMDC* LogMDC::GetCurrent() {
+	if (t_mdc) {
+		return t_mdc;
+	}
+	if (t_mdc_destroyed) {
+		return nullptr;
+	}
+	static thread_local ThreadMDC s_thread_mdc;
+	return &s_thread_mdc.mdc;
+}
+
+void LogMDC::SetCurrent(LogMDC* mdc) {
+	t_mdc = mdc;
+}
+
+void LogMDC::Put(const std::string& key, const std::string& value) {
+	LogMDC* mdc = GetCurrent();
+	if (!mdc) {
+		return;
+	}
+	Entries& entries = mdc->m_entries;
+	for (auto& i : entries) {
+		if (i.first == key) {
+			i.second = value;
+			return;
+		}
+	}
+	entries.push_back(std::make_pair(key, value));
+}
+
+std::string LogMDC::Get(const std::string& key) {
+	LogMDC* mdc = GetCurrent();
+	const std::string* value = mdc ? mdc->find(key.data(), key.size()) : nullptr;
+	return value ? *value : std::string();
+}
+
+void LogMDC::Remove(const std::string& key) {
+	LogMDC* mdc = GetCurrent();
+	if (!mdc) {
+		return;
+	}
+	Entries& entries = mdc->m_entries;
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		if (it->first == key) {
+			entries.erase(it);
+			return;
+		}
+	}
+}
+
+void LogMDC::Clear() {
+	LogMDC* mdc = GetCurrent();
+	if (mdc) {
+		mdc->m_entries.clear();
+	}
+}
+
+LogMDC::Scope::Scope(const std::string& key, const std::string& value)
+	:m_key(key) {
+	LogMDC* mdc = GetCurrent();
+	const std::string* old = mdc ? mdc->find(key.data(), key.size()) : nullptr;
+	m_had = old != nullptr;
+	if (m_had) {
+		m_old = *old;
+	}
+	Put(key, value);
+}
+
+LogMDC::Scope::~Scope() {
+	if (m_had) {
+		Put(m_key, m_old);
+	} else {
+		Remove(m_key);
+	}
+}
+
+void LogEvent::addSuppressed(uint64_t count) {
+	std::string& buf = m_buf.buffer();
+	buf.append(" [suppressed ");
+	buf.append(std::to_string(count));
+	buf.push_back(']');
+}
+
+uint64_t LogSite::NowUs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
+
+uint64_t LogSite::everyN(uint64_t n) {
+	uint64_t c = m_state.fetch_add(1, std::memory_order_relaxed);
+	if (n <= 1) {
+		return 1;
+	}
+	if (c % n) {
+		return 0;
+	}
+	return c ? n : 1;
+}
+
+uint64_t LogSite::everyMs(uint64_t ms) {
+	/// 加1避免与初始值0冲突
+	uint64_t now = NowUs() + 1;
+	uint64_t last = m_state.load(std::memory_order_relaxed);
+	if ((last && now - last < ms * 1000)
+			|| !m_state.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+		return drop();
+	}
+	return pass();
+}
+
+uint64_t LogSite::tokenBucket(uint64_t interval_us, uint32_t burst) {
+	uint64_t now = NowUs();
+	/// 理论到达时间最多比当前时间超前tolerance, 即最多连续放行burst条
+	uint64_t tolerance = interval_us * (burst ? burst - 1 : 0);
+	uint64_t tat = m_state.load(std::memory_order_relaxed);
+	while (true) {
+		uint64_t base = std::max(tat, now);
+		if (base - now > tolerance) {
+			return drop();
+		}
+		if (m_state.compare_exchange_weak(tat, base + interval_us, std::memory_order_relaxed)) {
+			return pass();
+		}
+	}
 }
 
 void LogEvent::format(const char* fmt, ...)
@@ -67,18 +257,401 @@ void LogEvent::format(const char* fmt, ...)
 
 void LogEvent::format(const char* fmt, va_list al)
 {
-	char* buf = nullptr;
-	int len = vasprintf(&buf, fmt, al); // 根据fmt 和 va_list 分配内存
-	/*std::cout << "fmt = " << fmt << std::endl;
-	std::cout << "buf = " << buf << std::endl;
-	std::cout << __FILE__ << "  " << __LINE__ << "  " << "len = " << len << std::endl;*/
-	if (len != -1) { // vasprintf 失败返回 -1
-		m_ss << std::string(buf, len);
-		free(buf);
+	/// 直接格式化到内容缓冲区的剩余容量中, 不够时扩容后再格式化一次;
+	/// resize会填充新增的部分, 大缓冲区中只预留一段
+	std::string& buf = m_buf.buffer();
+	size_t old = buf.size();
+	size_t avail = std::min(std::max(buf.capacity() - old, (size_t)256), (size_t)1024);
+	buf.resize(old + avail);
+	va_list cp;
+	va_copy(cp, al);
+	int len = vsnprintf(&buf[old], avail + 1, fmt, cp);
+	va_end(cp);
+	if (len < 0) { // vsnprintf 失败返回 -1
+		buf.resize(old);
+		return;
+	}
+	if ((size_t)len > avail) {
+		buf.resize(old + len);
+		vsnprintf(&buf[old], len + 1, fmt, al);
+	}
+	buf.resize(old + len);
+}
+
+const char* LogFmt::Next(std::string& out, const char* fmt, Spec* spec) {
+	while (true) {
+		const char* p = strchr(fmt, '%');
+		if (!p) {
+			out.append(fmt);
+			return fmt + strlen(fmt);
+		}
+		out.append(fmt, p - fmt);
+		if (p[1] == '%') {
+			out.push_back('%');
+			fmt = p + 2;
+			continue;
+		}
+		if (!spec) {
+			/// 编译期检查保证不会出现多余的转换说明, 原样输出
+			out.push_back('%');
+			fmt = p + 1;
+			continue;
+		}
+		spec->left = spec->zero = spec->plus = spec->space = spec->alt = false;
+		spec->width = 0;
+		spec->precision = -1;
+		for (++p; ; ++p) {
+			if (*p == '-') spec->left = true;
+			else if (*p == '0') spec->zero = true;
+			else if (*p == '+') spec->plus = true;
+			else if (*p == ' ') spec->space = true;
+			else if (*p == '#') spec->alt = true;
+			else break;
+		}
+		for (; *p >= '0' && *p <= '9'; ++p) {
+			spec->width = spec->width * 10 + (*p - '0');
+		}
+		if (*p == '.') {
+			spec->precision = 0;
+			for (++p; *p >= '0' && *p <= '9'; ++p) {
+				spec->precision = spec->precision * 10 + (*p - '0');
+			}
+		}
+		while (*p && IsModifier(*p)) {
+			++p;
+		}
+		spec->conv = *p;
+		return *p ? p + 1 : p;
 	}
 }
 
-std::stringstream& LogEventWrap::getSS() {
+/**
+ * @brief 按宽度写入前缀、补零和主体
+ */
+static void LogFmtPad(std::string& out, int width, bool left, bool zero
+		,const char* prefix, size_t prefix_len, size_t zeros, const char* body, size_t len) {
+	if (width == 0 && zeros == 0) {
+		if (prefix_len) {
+			out.append(prefix, prefix_len);
+		}
+		out.append(body, len);
+		return;
+	}
+	size_t total = prefix_len + zeros + len;
+	size_t pad = (size_t)width > total ? width - total : 0;
+	if (zero && !left) {
+		zeros += pad;
+		pad = 0;
+	}
+	if (!left) {
+		out.append(pad, ' ');
+	}
+	out.append(prefix, prefix_len);
+	out.append(zeros, '0');
+	out.append(body, len);
+	if (left) {
+		out.append(pad, ' ');
+	}
+}
+
+void LogFmt::WriteInt(std::string& out, const Spec& spec, uint64_t v, bool negative) {
+	if (spec.conv == 'c') {
+		char c = (char)(negative ? 0 - v : v);
+		LogFmtPad(out, spec.width, spec.left, false, "", 0, 0, &c, 1);
+		return;
+	}
+	static const char s_digits[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+	char tmp[24];
+	char* end = tmp + sizeof(tmp);
+	char* p = end;
+	char prefix[2];
+	size_t prefix_len = 0;
+	if (spec.conv == 'x' || spec.conv == 'X') {
+		const char* hex = spec.conv == 'x' ? "0123456789abcdef" : "0123456789ABCDEF";
+		do {
+			*--p = hex[v & 0xf];
+			v >>= 4;
+		} while (v);
+		if (spec.alt) {
+			prefix[0] = '0';
+			prefix[1] = spec.conv;
+			prefix_len = 2;
+		}
+	} else if (spec.conv == 'o') {
+		do {
+			*--p = '0' + (v & 7);
+			v >>= 3;
+		} while (v);
+		if (spec.alt && *p != '0') {
+			*--p = '0';
+		}
+	} else {
+		/// 每次转换两位, 减少除法次数
+		while (v >= 100) {
+			const char* d = s_digits + (v % 100) * 2;
+			v /= 100;
+			*--p = d[1];
+			*--p = d[0];
+		}
+		if (v >= 10) {
+			*--p = s_digits[v * 2 + 1];
+			*--p = s_digits[v * 2];
+		} else {
+			*--p = '0' + v;
+		}
+		if (negative) {
+			prefix[prefix_len++] = '-';
+		} else if (spec.plus && spec.conv != 'u') {
+			prefix[prefix_len++] = '+';
+		} else if (spec.space && spec.conv != 'u') {
+			prefix[prefix_len++] = ' ';
+		}
+	}
+	size_t len = end - p;
+	size_t zeros = 0;
+	if (spec.precision >= 0) {
+		if (spec.precision == 0 && len == 1 && *p == '0') {
+			len = 0;
+		}
+		zeros = (size_t)spec.precision > len ? spec.precision - len : 0;
+	}
+	LogFmtPad(out, spec.width, spec.left, spec.zero && spec.precision < 0
+			,prefix, prefix_len, zeros, p, len);
+}
+
+void LogFmt::WriteFloat(std::string& out, const Spec& spec, double v) {
+	char fmt[32];
+	char* p = fmt;
+	*p++ = '%';
+	if (spec.left) *p++ = '-';
+	if (spec.zero) *p++ = '0';
+	if (spec.plus) *p++ = '+';
+	if (spec.space) *p++ = ' ';
+	if (spec.alt) *p++ = '#';
+	*p++ = '*';
+	*p++ = '.';
+	*p++ = '*';
+	*p++ = spec.conv;
+	*p = '\0';
+	int precision = spec.precision < 0 ? 6 : spec.precision;
+	char buf[64];
+	int len = snprintf(buf, sizeof(buf), fmt, spec.width, precision, v);
+	if (len < 0) {
+		return;
+	}
+	if ((size_t)len < sizeof(buf)) {
+		out.append(buf, len);
+		return;
+	}
+	size_t old = out.size();
+	out.resize(old + len);
+	snprintf(&out[old], len + 1, fmt, spec.width, precision, v);
+}
+
+void LogFmt::WriteStr(std::string& out, const Spec& spec, const char* s, size_t len) {
+	if (spec.precision >= 0 && (size_t)spec.precision < len) {
+		len = spec.precision;
+	}
+	LogFmtPad(out, spec.width, spec.left, false, "", 0, 0, s, len);
+}
+
+void LogFmt::WriteStr(std::string& out, const Spec& spec, const char* s) {
+	if (!s) {
+		s = "(null)";
+	}
+	WriteStr(out, spec, s, strlen(s));
+}
+
+/**
+ * @brief 用CLOCK_REALTIME_COARSE获取当前秒内的微秒数
+ * @param[in] sec 日志事件的秒数, 与当前时间不在同一秒时返回0
+ */
+static uint32_t CurrentUsec(uint64_t sec) {
+	struct timespec ts;
+	if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) || (uint64_t)ts.tv_sec != sec) {
+		return 0;
+	}
+	return ts.tv_nsec / 1000;
+}
+
+LogStreamBuf::int_type LogStreamBuf::overflow(int_type c) {
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		m_buf.push_back(traits_type::to_char_type(c));
+	}
+	return traits_type::not_eof(c);
+}
+
+std::streamsize LogStreamBuf::xsputn(const char* s, std::streamsize n) {
+	m_buf.append(s, n);
+	return n;
+}
+
+namespace {
+
+/// 每个线程缓存的日志事件数量上限
+static const size_t s_event_pool_size = 32;
+/// 回收时保留的内容缓冲区容量上限
+static const size_t s_event_max_capacity = 64 * 1024;
+/// shared_ptr 控制块的内存块大小
+static const size_t s_block_size = 64;
+
+/**
+ * @brief 线程局部的日志事件池及控制块内存池
+ */
+struct LogEventPool {
+	std::vector<LogEvent*> events;
+	std::vector<void*> blocks;
+
+	~LogEventPool();
+};
+
+static thread_local LogEventPool* t_event_pool = nullptr;
+/// 线程退出后不再使用事件池
+static thread_local bool t_event_pool_dead = false;
+
+/**
+ * @brief 线程退出时释放事件池
+ */
+struct LogEventPoolReaper {
+	~LogEventPoolReaper() {
+		delete t_event_pool;
+		t_event_pool = nullptr;
+		t_event_pool_dead = true;
+	}
+	void touch() {}
+};
+
+static thread_local LogEventPoolReaper t_event_pool_reaper;
+
+static LogEventPool* GetEventPool() {
+	if (!t_event_pool && !t_event_pool_dead) {
+		t_event_pool_reaper.touch();
+		t_event_pool = new LogEventPool;
+		t_event_pool->events.reserve(s_event_pool_size);
+		t_event_pool->blocks.reserve(s_event_pool_size);
+	}
+	return t_event_pool;
+}
+
+LogEventPool::~LogEventPool() {
+	for (auto i : events) {
+		delete i;
+	}
+	for (auto i : blocks) {
+		::operator delete(i);
+	}
+}
+
+/**
+ * @brief 从线程局部内存块分配shared_ptr控制块的分配器
+ */
+template<class T>
+struct LogEventBlockAllocator {
+	typedef T value_type;
+
+	LogEventBlockAllocator() {}
+	template<class U>
+	LogEventBlockAllocator(const LogEventBlockAllocator<U>&) {}
+
+	T* allocate(size_t n) {
+		static_assert(sizeof(T) <= s_block_size, "LogEvent control block too large");
+		LogEventPool* pool = GetEventPool();
+		if (n == 1 && pool && !pool->blocks.empty()) {
+			void* p = pool->blocks.back();
+			pool->blocks.pop_back();
+			return static_cast<T*>(p);
+		}
+		return static_cast<T*>(::operator new(n == 1 ? s_block_size : n * sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t n) {
+		LogEventPool* pool = GetEventPool();
+		if (n == 1 && pool && pool->blocks.size() < s_event_pool_size) {
+			pool->blocks.push_back(p);
+			return;
+		}
+		::operator delete(p);
+	}
+
+	template<class U>
+	bool operator==(const LogEventBlockAllocator<U>&) const { return true; }
+	template<class U>
+	bool operator!=(const LogEventBlockAllocator<U>&) const { return false; }
+};
+
+}
+
+void LogEvent::Recycler::operator()(LogEvent* event) const {
+	LogEventPool* pool = GetEventPool();
+	if (!pool || pool->events.size() >= s_event_pool_size) {
+		delete event;
+		return;
+	}
+	/// 释放日志器的引用, 保留内容缓冲区的容量
+	event->m_logger = nullptr;
+	std::string& buf = event->m_buf.buffer();
+	if (buf.capacity() > s_event_max_capacity) {
+		std::string().swap(buf);
+	} else {
+		buf.clear();
+	}
+	event->m_fields.clear();
+	event->m_mdc = nullptr;
+	/// 恢复流的状态及格式, 避免影响下一次使用
+	event->m_ss.clear();
+	event->m_ss.flags(std::ios_base::skipws | std::ios_base::dec);
+	event->m_ss.precision(6);
+	event->m_ss.width(0);
+	event->m_ss.fill(' ');
+	pool->events.push_back(event);
+}
+
+LogEvent::ptr LogEvent::Create(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+		,const char* file, int32_t line, uint32_t elapse
+		,uint32_t thread_id, uint32_t fiber_id, uint64_t time
+		,const std::string& thread_name) {
+	LogEventPool* pool = GetEventPool();
+	LogEvent* event = nullptr;
+	if (pool && !pool->events.empty()) {
+		event = pool->events.back();
+		pool->events.pop_back();
+		event->reset(logger, level, file, line, elapse, thread_id
+				,fiber_id, time, thread_name);
+	} else {
+		event = new LogEvent(logger, level, file, line, elapse, thread_id
+				,fiber_id, time, thread_name);
+	}
+	return LogEvent::ptr(event, Recycler(), LogEventBlockAllocator<LogEvent>());
+}
+
+void LogEvent::reset(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+		,const char* file, int32_t line, uint32_t elapse
+		,uint32_t thread_id, uint32_t fiber_id, uint64_t time
+		,const std::string& thread_name) {
+	m_logger = logger.get();
+	m_level = level;
+	m_file = file;
+	m_line = line;
+	m_elapse = elapse;
+	m_threadId = thread_id;
+	m_fiberId = fiber_id;
+	m_time = time;
+	m_usec = CurrentUsec(time);
+	m_threadName = &thread_name;
+	m_mdc = LogMDC::GetCurrent();
+}
+
+LogStream& LogEventWrap::getSS() {
 	return m_event->getSS(); // 调用shared_ptr 里面的getSS()
 }
 
@@ -87,6 +660,7 @@ void LogAppender::setFormatter(LogFormatter::ptr val)
 {
     MutexType::Lock lock(m_mutex);
 	m_formatter = val;
+	++m_formatterVersion;
     if(m_formatter) {
         m_hasFormatter = true;
     }else {
@@ -101,6 +675,233 @@ LogFormatter::ptr LogAppender::getFormatter()
 }
 
 /**
+ * @brief 取对象的智能指针, 对象不由shared_ptr管理时返回不释放对象的指针
+ */
+template<class T>
+static std::shared_ptr<T> SharedOrBorrowed(T& v) {
+	try {
+		return v.shared_from_this();
+	} catch(const std::bad_weak_ptr&) {
+		return std::shared_ptr<T>(&v, [](T*) {});
+	}
+}
+
+void LogAppender::append(Logger& logger, LogLevel::Level level, const LogEvent& event) {
+	/// 只重写了log()的日志目标, 需要时才构造智能指针
+	log(SharedOrBorrowed(logger), level
+			,SharedOrBorrowed(const_cast<LogEvent&>(event)));
+}
+
+void LogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+	/// append()和log()都没有重写, 丢弃日志, 只提示一次
+	static std::atomic<bool> s_warned{false};
+	if(!s_warned.exchange(true)) {
+		std::cerr << "LogAppender: neither append() nor log() is overridden, event dropped" << std::endl;
+	}
+	addCounter(DROPPED);
+}
+
+LogAppender::Metrics LogAppender::getMetrics() const {
+	Metrics m;
+	m.events = m_counters.get(EVENTS);
+	m.bytes = m_counters.get(BYTES);
+	m.format_ns = m_counters.get(FORMAT_NS);
+	m.write_ns = m_counters.get(WRITE_NS);
+	m.dropped = m_counters.get(DROPPED);
+	m.reopens = m_counters.get(REOPENS);
+	return m;
+}
+
+static std::atomic<uint32_t> s_counter_shard{0};
+
+uint32_t LogCounterShard() {
+	static thread_local uint32_t t_shard = s_counter_shard++ % LogCounters<1>::s_shards;
+	return t_shard;
+}
+
+static uint64_t NowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+LogSampleTimer::LogSampleTimer(bool always)
+	:m_last(0)
+	,m_scale(always ? 1 : s_rate) {
+	static thread_local uint32_t t_tick = 0;
+	if (always || ++t_tick % s_rate == 0) {
+		m_last = NowNs();
+	}
+}
+
+uint64_t LogSampleTimer::lap() {
+	if (!m_last) {
+		return 0;
+	}
+	uint64_t now = NowNs();
+	uint64_t used = now - m_last;
+	m_last = now;
+	return used * m_scale;
+}
+
+/**
+*	@brief LogFormatter 编译后的指令类型
+*/
+enum LogFormatOpCode {
+	/// 字面量(字符串/制表符/换行)
+	OP_LITERAL = 0,
+	OP_MESSAGE,
+	OP_LEVEL,
+	OP_ELAPSE,
+	OP_NAME,
+	OP_THREAD_ID,
+	OP_FIBER_ID,
+	OP_THREAD_NAME,
+	OP_DATETIME,
+	OP_FILENAME,
+	OP_LINE,
+	/// JSON对象, arg为时间格式在m_dateFormats中的下标
+	OP_JSON,
+	/// 日志上下文, arg/len为键在m_literals中的偏移和长度, 长度为0时输出全部
+	OP_MDC,
+	/// 以下两条只在编译时使用, 会被合并成字面量
+	OP_NEWLINE,
+	OP_TAB
+};
+
+static char* UIntToText(uint64_t v, char* end);
+
+/**
+ * @brief 输出有符号整数
+ * @param[in] put 输出函数, 形如 put(const char* str, size_t len)
+ */
+template<class Put>
+static void PutInt(Put& put, int64_t v) {
+	char tmp[24];
+	char* end = tmp + sizeof(tmp);
+	char* p = UIntToText(v < 0 ? -(uint64_t)v : (uint64_t)v, end);
+	if (v < 0) {
+		*--p = '-';
+	}
+	put(p, end - p);
+}
+
+template<class Put>
+static void PutUInt(Put& put, uint64_t v) {
+	char tmp[24];
+	char* end = tmp + sizeof(tmp);
+	char* p = UIntToText(v, end);
+	put(p, end - p);
+}
+
+/**
+ * @brief 输出浮点数, 优先使用能还原出原值的较短形式; json为true时非有限值输出null
+ */
+template<class Put>
+static void PutDouble(Put& put, double v, bool json) {
+	if (json && !std::isfinite(v)) {
+		put("null", 4);
+		return;
+	}
+	char tmp[32];
+	int len = snprintf(tmp, sizeof(tmp), "%.15g", v);
+	if (std::isfinite(v) && strtod(tmp, nullptr) != v) {
+		len = snprintf(tmp, sizeof(tmp), "%.17g", v);
+	}
+	put(tmp, len);
+}
+
+/**
+ * @brief 输出带引号的JSON字符串, 不需要转义的部分整段输出; 非ASCII字符按原样输出(UTF-8)
+ */
+template<class Put>
+static void PutJsonString(Put& put, const char* str, size_t len) {
+	static const char s_hex[] = "0123456789abcdef";
+	put("\"", 1);
+	size_t begin = 0;
+	for (size_t i = 0; i < len; ++i) {
+		unsigned char c = str[i];
+		if (c >= 0x20 && c != '"' && c != '\\') {
+			continue;
+		}
+		put(str + begin, i - begin);
+		begin = i + 1;
+		switch (c) {
+		case '"':
+			put("\\\"", 2);
+			break;
+		case '\\':
+			put("\\\\", 2);
+			break;
+		case '\n':
+			put("\\n", 2);
+			break;
+		case '\r':
+			put("\\r", 2);
+			break;
+		case '\t':
+			put("\\t", 2);
+			break;
+		default: {
+			char esc[6] = {'\\', 'u', '0', '0', s_hex[c >> 4], s_hex[c & 15]};
+			put(esc, 6);
+			break;
+		}
+		}
+	}
+	put(str + begin, len - begin);
+	put("\"", 1);
+}
+
+/**
+ * @brief 输出字段的值; json为false时, 含空格、引号、等号或控制字符的字符串加引号转义
+ */
+template<class Put>
+static void PutFieldValue(Put& put, const LogFields& fields, const LogFields::Field& f, bool json) {
+	switch (f.type) {
+	case LogFields::INT:
+		PutInt(put, f.i);
+		break;
+	case LogFields::UINT:
+		PutUInt(put, f.u);
+		break;
+	case LogFields::DOUBLE:
+		PutDouble(put, f.d, json);
+		break;
+	case LogFields::BOOL:
+		f.b ? put("true", 4) : put("false", 5);
+		break;
+	case LogFields::STRING: {
+		const char* str = fields.str(f.s.off);
+		bool quote = json || f.s.len == 0;
+		for (uint32_t i = 0; i < f.s.len && !quote; ++i) {
+			unsigned char c = str[i];
+			quote = c <= ' ' || c == '"' || c == '=' || c == '\\';
+		}
+		quote ? PutJsonString(put, str, f.s.len) : put(str, f.s.len);
+		break;
+	}
+	}
+}
+
+/**
+ * @brief 输出日志内容, 有结构化字段时在其后以" key=value"的形式追加
+ */
+template<class Put>
+static void PutMessage(Put& put, const LogEvent& event) {
+	const std::string& content = event.getContent();
+	put(content.data(), content.size());
+	const LogFields& fields = event.getFields();
+	for (size_t i = 0; i < fields.size(); ++i) {
+		const LogFields::Field& f = fields.at(i);
+		put(" ", 1);
+		put(fields.str(f.key), f.keyLen);
+		put("=", 1);
+		PutFieldValue(put, fields, f, false);
+	}
+}
+
+/**
 *	@brief 返回日志内容
 */
 class MessageFormatItem : public LogFormatter::FormatItem {
@@ -108,8 +909,9 @@ public:
 	MessageFormatItem(const std::string& str = "") {
 		// std::cout << "MessageFormatItem constructor" << std::endl;
 	}
-	void format(std::ostream&os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-		os << event->getContent();
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+		auto put = [&os](const char* str, size_t len) { os.write(str, len); };
+		PutMessage(put, *event);
 	}
 };
 
@@ -121,7 +923,7 @@ public:
 	LevelFormatItem(const std::string& str = "") {
 		// std::cout << "LevelFormatItem constructor" << std::endl;
 	}
-	void format(std::ostream&os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
 		os << LogLevel::ToString(level);
 	}
 };
@@ -134,7 +936,7 @@ public:
 	ElapseFormatItem(const std::string& str = "") {
 		// std::cout << "ElapseFormatItem constructor" << std::endl;
 	}
-	void format(std::ostream&os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
 		os << event->getElapse();
 	}
 };
@@ -145,8 +947,8 @@ public:
 class NameFormatItem : public LogFormatter::FormatItem {
 public:
 	NameFormatItem(const std::string& str = "") {}
-	void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-		os << event->getLogger()->getName();
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+		os << event->getLoggerName();
 	}
 };
 
@@ -158,7 +960,7 @@ public:
 	ThreadIdFormatItem(const std::string& str = "") {
 		// std::cout << "ThreadIdFormatItem constructor" << std::endl;
 	}
-	void format(std::ostream&os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
 		os << event->getThreadId();
 	}
 };
@@ -171,7 +973,7 @@ public:
 	FiberIdFormatItem(const std::string& str = "") {
 		// std::cout << "FiberIdFormatItem constructor" << std::endl;
 	}
-	void format(std::ostream&os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
 		os << event->getFiberId();
 	}
 };
@@ -184,67 +986,280 @@ public:
 	ThreadNameFormatItem(const std::string& str = "") {
 		// std::cout << "ThreadNameFormatItem constructor" << std::endl;
 	}
-	void format(std::ostream&os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
 		os << event->getThreadName();
 	}
-};
-
-/**
-*	@brief 返回特定样式的时间
-*/
-class DateTimeFormatItem : public LogFormatter::FormatItem {
-public:
-	DateTimeFormatItem(const std::string& format = "%Y-%m-%d %H:%M:%S")
-		:m_format(format) {
-		if (m_format.empty()) {
-			m_format = "%Y-%m-%d %H:%M:%S";
-		}
-	}
-	void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-		struct tm tm; // 临时定义的结构体类型,非引用
-		time_t time = event->getTime();
-		localtime_r(&time, &tm); // 线程安全
-		char buf[64];
-		strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-		os << buf;
-	}
-private:
-	std::string m_format;
-};
-
-/**
-*	@brief 返回文件名
-*/
-class FilenameFormatItem : public LogFormatter::FormatItem {
-public:
-	FilenameFormatItem(const std::string& str = "") {}
-	void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-		os << event->getFile();
-	}
 };
 
-/**
-*	@brief 返回行号
+/**
+*	@brief 按秒缓存的时间格式
+*	@details 除strftime的格式外, 支持
+*	    %L 毫秒(3位)
+*	    %f 微秒(6位)
+*	    每个线程按格式缓存最近一秒的strftime结果, 秒数不变时只需要拷贝并填入毫秒/微秒
 */
-class LineFormatItem : public LogFormatter::FormatItem {
+class LogDateFormat {
 public:
-	LineFormatItem(const std::string& str = "") {}
-	void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-		os << event->getLine();
-	}
-};
+	/// 格式化结果的最大长度
+	static const size_t s_max_size = 128;
 
-/**
-*	@brief 返回换行符
-*/
-class NewLineFormatItem : public LogFormatter::FormatItem {
-public:
-	NewLineFormatItem(const std::string& str = "") {}
-	void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-		os << std::endl;
+	LogDateFormat(const std::string& format)
+		:m_id(++s_id) {
+		std::string part;
+		for (size_t i = 0; i < format.size(); ++i) {
+			if (format[i] == '%' && i + 1 < format.size()) {
+				char c = format[i + 1];
+				if (c == 'L' || c == 'f') {
+					m_parts.push_back(std::make_pair(part, 0));
+					m_parts.push_back(std::make_pair(std::string(), c == 'L' ? 3 : 6));
+					part.clear();
+				} else {
+					part.append(format, i, 2);
+				}
+				++i;
+				continue;
+			}
+			part.append(1, format[i]);
+		}
+		if (!part.empty()) {
+			m_parts.push_back(std::make_pair(part, 0));
+		}
 	}
-};
-
+
+	/**
+	* @brief 格式化时间
+	* @param[out] buf 长度至少为s_max_size
+	* @param[in] sec 秒
+	* @param[in] usec 秒内的微秒数
+	* @return 写入的长度
+	*/
+	size_t format(char* buf, uint64_t sec, uint32_t usec) const {
+		static thread_local Cache t_cache[s_cache_size];
+		Cache& c = t_cache[m_id & (s_cache_size - 1)];
+		if (c.id != m_id || c.sec != sec) {
+			render(c, sec);
+		}
+		memcpy(buf, c.text, c.len);
+		for (uint32_t i = 0; i < c.fields; ++i) {
+			/// 从低位开始写入固定宽度的数字
+			uint32_t v = c.widths[i] == 3 ? usec / 1000 : usec;
+			for (int j = c.offsets[i] + c.widths[i] - 1; j >= (int)c.offsets[i]; --j) {
+				buf[j] = '0' + v % 10;
+				v /= 10;
+			}
+		}
+		return c.len;
+	}
+private:
+	/// 每个线程缓存的格式数量, 2的幂
+	static const size_t s_cache_size = 16;
+	/// 单个格式中毫秒/微秒的最大个数
+	static const size_t s_max_fields = 4;
+
+	/**
+	* @brief 线程局部缓存
+	*/
+	struct Cache {
+		uint64_t id = 0;
+		uint64_t sec = 0;
+		uint32_t len = 0;
+		uint32_t fields = 0;
+		uint8_t offsets[s_max_fields];
+		uint8_t widths[s_max_fields];
+		char text[s_max_size];
+	};
+
+	void render(Cache& c, uint64_t sec) const {
+		struct tm tm; // 临时定义的结构体类型,非引用
+		time_t time = sec;
+		localtime_r(&time, &tm); // 线程安全
+		c.id = m_id;
+		c.sec = sec;
+		c.len = 0;
+		c.fields = 0;
+		for (auto& i : m_parts) {
+			size_t left = s_max_size - c.len;
+			if (i.second == 0) {
+				if (!i.first.empty()) {
+					c.len += strftime(c.text + c.len, left, i.first.c_str(), &tm);
+				}
+			} else if (left >= (size_t)i.second && c.fields < s_max_fields) {
+				c.offsets[c.fields] = c.len;
+				c.widths[c.fields] = i.second;
+				++c.fields;
+				c.len += i.second;
+			}
+		}
+	}
+private:
+	static std::atomic<uint64_t> s_id;
+	/// 唯一id, 用于线程局部缓存的查找
+	uint64_t m_id;
+	/// strftime格式(second为0) 或 毫秒/微秒的位数
+	std::vector<std::pair<std::string, int> > m_parts;
+};
+
+std::atomic<uint64_t> LogDateFormat::s_id{0};
+
+/**
+ * @brief 输出日志上下文中key的值, len为0时以"key=value"的形式输出全部, 用空格分隔
+ */
+template<class Put>
+static void PutMDC(Put& put, const LogEvent& event, const char* key, size_t len) {
+	const LogMDC* mdc = event.getMDC();
+	if (!mdc) {
+		return;
+	}
+	if (len) {
+		const std::string* value = mdc->find(key, len);
+		if (value) {
+			put(value->data(), value->size());
+		}
+		return;
+	}
+	bool first = true;
+	for (auto& i : mdc->getEntries()) {
+		if (!first) {
+			put(" ", 1);
+		}
+		first = false;
+		put(i.first.data(), i.first.size());
+		put("=", 1);
+		put(i.second.data(), i.second.size());
+	}
+}
+
+/**
+*	@brief 输出日志上下文, %X{key}输出key的值, %X输出全部
+*/
+class MDCFormatItem : public LogFormatter::FormatItem {
+public:
+	MDCFormatItem(const std::string& key = "")
+		:m_key(key) {
+	}
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+		auto put = [&os](const char* str, size_t len) { os.write(str, len); };
+		PutMDC(put, *event, m_key.data(), m_key.size());
+	}
+private:
+	std::string m_key;
+};
+
+/**
+ * @brief 默认的JSON时间格式
+ */
+static const char* s_json_date_format = "%Y-%m-%dT%H:%M:%S.%L%z";
+
+/**
+ * @brief 将日志事件输出为一个JSON对象, 结构化字段作为对象的属性附在最后
+ */
+template<class Put>
+static void PutJson(Put& put, const LogDateFormat& date, LogLevel::Level level, const LogEvent& event) {
+	char tmp[LogDateFormat::s_max_size];
+	put("{\"time\":\"", 9);
+	put(tmp, date.format(tmp, event.getTime(), event.getUsec()));
+	put("\",\"level\":\"", 11);
+	const char* str = LogLevel::ToString(level);
+	put(str, strlen(str));
+	put("\",\"logger\":", 11);
+	const std::string& name = event.getLoggerName();
+	PutJsonString(put, name.data(), name.size());
+	put(",\"thread\":", 10);
+	PutUInt(put, event.getThreadId());
+	put(",\"thread_name\":", 15);
+	PutJsonString(put, event.getThreadName().data(), event.getThreadName().size());
+	put(",\"fiber\":", 9);
+	PutUInt(put, event.getFiberId());
+	put(",\"file\":", 8);
+	PutJsonString(put, event.getFile(), strlen(event.getFile()));
+	put(",\"line\":", 8);
+	PutInt(put, event.getLine());
+	put(",\"msg\":", 7);
+	PutJsonString(put, event.getContent().data(), event.getContent().size());
+	if (event.getMDC()) {
+		for (auto& i : event.getMDC()->getEntries()) {
+			put(",", 1);
+			PutJsonString(put, i.first.data(), i.first.size());
+			put(":", 1);
+			PutJsonString(put, i.second.data(), i.second.size());
+		}
+	}
+	const LogFields& fields = event.getFields();
+	for (size_t i = 0; i < fields.size(); ++i) {
+		const LogFields::Field& f = fields.at(i);
+		put(",", 1);
+		PutJsonString(put, fields.str(f.key), f.keyLen);
+		put(":", 1);
+		PutFieldValue(put, fields, f, true);
+	}
+	put("}", 1);
+}
+
+/**
+*	@brief 输出JSON对象, %J{时间格式}, 默认时间格式为ISO 8601
+*/
+class JsonFormatItem : public LogFormatter::FormatItem {
+public:
+	JsonFormatItem(const std::string& format = "")
+		:m_format(format.empty() ? s_json_date_format : format) {
+	}
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+		auto put = [&os](const char* str, size_t len) { os.write(str, len); };
+		PutJson(put, m_format, level, *event);
+	}
+private:
+	LogDateFormat m_format;
+};
+
+/**
+*	@brief 返回特定样式的时间
+*/
+class DateTimeFormatItem : public LogFormatter::FormatItem {
+public:
+	DateTimeFormatItem(const std::string& format = "%Y-%m-%d %H:%M:%S")
+		:m_format(format.empty() ? "%Y-%m-%d %H:%M:%S" : format) {
+	}
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+		char buf[LogDateFormat::s_max_size];
+		os.write(buf, m_format.format(buf, event->getTime(), event->getUsec()));
+	}
+private:
+	LogDateFormat m_format;
+};
+
+/**
+*	@brief 返回文件名
+*/
+class FilenameFormatItem : public LogFormatter::FormatItem {
+public:
+	FilenameFormatItem(const std::string& str = "") {}
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+		os << event->getFile();
+	}
+};
+
+/**
+*	@brief 返回行号
+*/
+class LineFormatItem : public LogFormatter::FormatItem {
+public:
+	LineFormatItem(const std::string& str = "") {}
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+		os << event->getLine();
+	}
+};
+
+/**
+*	@brief 返回换行符
+*/
+class NewLineFormatItem : public LogFormatter::FormatItem {
+public:
+	NewLineFormatItem(const std::string& str = "") {}
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
+		os << std::endl;
+	}
+};
+
 /**
 *	@brief 字符串
 */
@@ -252,7 +1267,7 @@ class StringFormatItem : public LogFormatter::FormatItem {
 public:
 	StringFormatItem(const std::string& str)
 		:m_string(str) {}
-	void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
 		os << m_string;
 	}
 private:
@@ -265,7 +1280,7 @@ private:
 class TabFormatItem : public LogFormatter::FormatItem {
 public:
 	TabFormatItem(const std::string& str = "") {}
-	void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
+	void format(std::ostream& os, const Logger::ptr& logger, LogLevel::Level level, const LogEvent::ptr& event) override {
 		os << "\t";
 	}
 private:
@@ -274,7 +1289,7 @@ private:
 
 LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t thread_id,
 	uint32_t fiber_id, uint64_t time, const std::string& thread_name)
-	:m_logger(logger)
+	:m_logger(logger.get())
 	,m_level(level)
 	,m_file(file)
 	,m_line(line)
@@ -282,22 +1297,180 @@ LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, const
 	,m_threadId(thread_id)
 	,m_fiberId(fiber_id)
 	,m_time(time)
-	,m_threadName(thread_name)
+	,m_usec(CurrentUsec(time))
+	,m_threadName(&thread_name)
 {
+	m_mdc = LogMDC::GetCurrent();
 //	std::cout << m_file << " - " << m_line << " - "
 //		<< m_elapse << " - " << m_threadId << " - "
 //		<< m_fiberId <<  std::endl;
 }
 
+std::shared_ptr<Logger> LogEvent::getLogger() const {
+	return m_logger ? m_logger->shared_from_this() : nullptr;
+}
+
+const std::string& LogEvent::getLoggerName() const {
+	return m_logger->getName();
+}
+
+/**
+ * @brief 所有存活的日志器, 用于在配置变化时重新计算缓存
+ * @details 静态初始化期间即会使用, 故在堆上创建且不释放
+ */
+struct LoggerRegistry {
+	Mutex mutex;
+	std::unordered_set<Logger*> loggers;
+};
+
+static LoggerRegistry& GetLoggerRegistry() {
+	static LoggerRegistry* s_registry = new LoggerRegistry;
+	return *s_registry;
+}
+
+/// 日志器配置版本
+static std::atomic<uint64_t> s_logger_epoch{0};
+
 Logger::Logger(const std::string& name)
 	:m_name(name) /// defalut value is "root"
-	,m_level(LogLevel::DEBUG) {
+	,m_level(LogLevel::DEBUG)
+	,m_effectiveLevel(LogLevel::DEBUG)
+	,m_minLevel(LogLevel::DEBUG) {
 	// std::cout << "m_name = " << m_name << std::endl;
 	/**
 	*	以 ptr 所指向的对象替换被管理对象
 	*	销毁旧的实例
 	*/
 	m_formatter.reset(new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n")); // 默认的日志级别
+	m_snapshot = new AppenderSnapshot;
+
+	LoggerRegistry& registry = GetLoggerRegistry();
+	Mutex::Lock lock(registry.mutex);
+	registry.loggers.insert(this);
+	refresh();
+}
+
+Logger::~Logger() {
+	{
+		LoggerRegistry& registry = GetLoggerRegistry();
+		Mutex::Lock lock(registry.mutex);
+		registry.loggers.erase(this);
+	}
+	m_snapshot.load()->release();
+}
+
+void Logger::publishAppenders(MutexType::Lock& lock) {
+	AppenderSnapshot* snapshot = new AppenderSnapshot;
+	snapshot->appenders.assign(m_appenders.begin(), m_appenders.end());
+	AppenderSnapshot* old = m_snapshot.exchange(snapshot);
+	/// 等待仍可能取得旧快照引用的线程离开后再释放发布者的引用, 等待期间不持有锁
+	lock.unlock();
+	Rcu::Retire(old, [](void* p) { ((AppenderSnapshot*)p)->release(); });
+	/// 日志目标是否为空会影响下级日志器实际输出的位置
+	RefreshAll();
+}
+
+void Logger::setLevel(LogLevel::Level val) {
+	Mutex::Lock lock(GetLoggerRegistry().mutex);
+	m_level = val;
+	RefreshAll(true);
+}
+
+Logger::ptr Logger::getParent() const {
+	Mutex::Lock lock(GetLoggerRegistry().mutex);
+	return m_parent;
+}
+
+/**
+* @brief 记录级别的来源: SetCaptureLevel设置的值及各FlightRecorderAppender的级别
+*/
+struct CaptureLevels {
+	Mutex mutex;
+	int manual = 100;
+	std::multiset<int> recorders;
+};
+
+static CaptureLevels& GetCaptureLevels() {
+	static CaptureLevels* s_levels = new CaptureLevels;
+	return *s_levels;
+}
+
+/**
+* @brief 取所有来源中最低的级别, 调用时持有CaptureLevels::mutex
+*/
+static int MinCaptureLevel(const CaptureLevels& levels) {
+	int level = levels.manual;
+	if (!levels.recorders.empty() && *levels.recorders.begin() < level) {
+		level = *levels.recorders.begin();
+	}
+	return level;
+}
+
+void Logger::SetCaptureLevel(LogLevel::Level level) {
+	CaptureLevels& levels = GetCaptureLevels();
+	Mutex::Lock lock(levels.mutex);
+	levels.manual = level;
+	s_captureLevel = MinCaptureLevel(levels);
+	RefreshAll();
+}
+
+void Logger::AddCaptureLevel(LogLevel::Level level) {
+	CaptureLevels& levels = GetCaptureLevels();
+	Mutex::Lock lock(levels.mutex);
+	levels.recorders.insert(level);
+	s_captureLevel = MinCaptureLevel(levels);
+	RefreshAll();
+}
+
+void Logger::DelCaptureLevel(LogLevel::Level level) {
+	CaptureLevels& levels = GetCaptureLevels();
+	Mutex::Lock lock(levels.mutex);
+	auto it = levels.recorders.find(level);
+	if (it != levels.recorders.end()) {
+		levels.recorders.erase(it);
+	}
+	s_captureLevel = MinCaptureLevel(levels);
+	RefreshAll();
+}
+
+uint64_t Logger::GetEpoch() {
+	return s_logger_epoch.load();
+}
+
+void Logger::refresh() {
+	LogLevel::Level level = m_level;
+	Logger* owner = nullptr;
+	/// 沿上级链查找最近设置了级别的和最近有日志目标的日志器
+	for (Logger* l = this; l && (level == LogLevel::UNKNOW || !owner); l = l->m_parent.get()) {
+		if (level == LogLevel::UNKNOW) {
+			level = l->m_level;
+		}
+		if (!owner && !l->m_snapshot.load(std::memory_order_acquire)->appenders.empty()) {
+			owner = l;
+		}
+	}
+	if (level == LogLevel::UNKNOW) {
+		level = LogLevel::DEBUG;
+	}
+	int capture = s_captureLevel.load(std::memory_order_relaxed);
+	m_effectiveLevel.store(level, std::memory_order_relaxed);
+	m_minLevel.store(capture < level ? capture : level, std::memory_order_relaxed);
+	m_appenderOwner.store(owner ? owner : this, std::memory_order_release);
+}
+
+void Logger::RefreshAll(bool locked) {
+	LoggerRegistry& registry = GetLoggerRegistry();
+	if (!locked) {
+		Mutex::Lock lock(registry.mutex);
+		RefreshAll(true);
+		return;
+	}
+	/// 读取其他日志器的快照时防止其被释放
+	RcuReadLock rcu;
+	++s_logger_epoch;
+	for (auto& i : registry.loggers) {
+		i->refresh();
+	}
 }
 
 void Logger::setFormatter(LogFormatter::ptr val) {
@@ -309,6 +1482,7 @@ void Logger::setFormatter(LogFormatter::ptr val) {
         MutexType::Lock ll(i->m_mutex);
         if(!i->m_hasFormatter) {
             i->m_formatter = m_formatter;
+            ++i->m_formatterVersion;
         }
     }
 }
@@ -338,6 +1512,10 @@ std::string Logger::toYamlString() {
     if(m_formatter) {
         node["formatter"] = m_formatter->getPattern();
     }
+    if(m_rateLimit) {
+        node["rate_limit"] = (uint32_t)m_rateLimit;
+        node["burst"] = (uint32_t)m_burst;
+    }
     // std::cout << std::endl << "formatter =" << node["formatter"] << std::endl;
     /**
      *  /// 日志目标集合
@@ -367,13 +1545,16 @@ void Logger::addAppender(LogAppender::ptr appender)
 	if (!appender->getFormatter()) {
         MutexType::Lock ll(appender->m_mutex);
 		appender->m_formatter = m_formatter;
+		++appender->m_formatterVersion;
         // appender->setFormatter(m_formatter);
 	}
 	m_appenders.push_back(appender);
+	publishAppenders(lock);
 }
 
 void Logger::delAppender(LogAppender::ptr appender)
 {
+    MutexType::Lock lock(m_mutex);
 	// m_appenders is a list
 	for (auto it = m_appenders.begin(); it != m_appenders.end(); it++) {
 		if (*it == appender) {
@@ -381,6 +1562,7 @@ void Logger::delAppender(LogAppender::ptr appender)
 			break;
 		}
 	}
+	publishAppenders(lock);
 }
 
 void Logger::clearAppenders()
@@ -388,147 +1570,2103 @@ void Logger::clearAppenders()
     MutexType::Lock lock(m_mutex);
 	// m_appenders is a list
 	m_appenders.clear();
+	publishAppenders(lock);
 }
 
+void Logger::setAppenders(const std::list<LogAppender::ptr>& appenders)
+{
+    MutexType::Lock lock(m_mutex);
+	for (auto& i : appenders) {
+		if (!i->getFormatter()) {
+            MutexType::Lock ll(i->m_mutex);
+			i->m_formatter = m_formatter;
+			++i->m_formatterVersion;
+		}
+	}
+	m_appenders = appenders;
+	publishAppenders(lock);
+}
+
+std::list<LogAppender::ptr> Logger::getAppenders()
+{
+	MutexType::Lock lock(m_mutex);
+	return m_appenders;
+}
+
+void Logger::flush()
+{
+	for (auto& i : getAppenders()) {
+		i->flush();
+	}
+}
+
+Logger::Metrics Logger::getMetrics() const {
+	Metrics m;
+	for (int i = LogLevel::DEBUG; i <= LogLevel::FATAL; ++i) {
+		m.events[i] = m_counters.get(i);
+	}
+	m.throttled = m_counters.get(0);
+	return m;
+}
+
+void Logger::setRateLimit(uint32_t rate, uint32_t burst) {
+	m_burst = burst;
+	m_rateLimit = rate;
+}
+
+std::atomic<int> Logger::s_captureLevel{100};
+
 void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
-	if (level >= m_level) {
-		auto self = shared_from_this(); /// 当类A被shared_ptr管理，且在类A的成员函数里需要把当前类对象作为参数传给其他函数时，就需要传递一个指向自身的share_ptr。
-		MutexType::Lock lock(m_mutex);
-		if (!m_appenders.empty()) { /// m_appenders 不为空的时候
-			for (auto &i : m_appenders) {
-				i->log(self, level, event); // enable_shared_from_this, call LogAppender::log
+	log(level, *event);
+}
+
+void Logger::log(LogLevel::Level level, LogEvent& event) {
+	if (level >= s_captureLevel.load(std::memory_order_relaxed)) {
+		FlightRecorder::Record(level, event);
+	}
+	dispatch(level, event);
+}
+
+void Logger::dispatch(LogLevel::Level level, LogEvent& event) {
+	if (level >= m_effectiveLevel.load(std::memory_order_relaxed)) {
+		uint32_t rate = m_rateLimit.load(std::memory_order_relaxed);
+		if (rate) {
+			uint64_t allow = m_throttle.tokenBucket(1000000 / rate, m_burst.load(std::memory_order_relaxed));
+			if (!allow) {
+				m_counters.add(0);
+				return;
 			}
-		} else if (m_root) { /// 如果m_appender为空且m_root不为空的时候
-			m_root->log(level, event);
+			if (allow > 1) {
+				event.addSuppressed(allow - 1);
+			}
 		}
+		m_counters.add(level);
+		/// 不加锁, 在读临界区内取得当前只读快照的引用, 输出时已离开临界区
+		AppenderSnapshot* snapshot;
+		{
+			RcuReadLock lock;
+			/// 自身没有日志目标时使用最近的有日志目标的上级日志器的快照
+			Logger* owner = m_appenderOwner.load(std::memory_order_acquire);
+			snapshot = owner->m_snapshot.load(std::memory_order_acquire);
+			snapshot->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+		for (auto &i : snapshot->appenders) {
+			i->append(*this, level, event);
+		}
+		snapshot->release();
 	}
 }
 
 void Logger::debug(LogEvent::ptr event) {
-	log(LogLevel::DEBUG, event);
+	log(LogLevel::DEBUG, *event);
 }
 
 void Logger::info(LogEvent::ptr event) {
-	log(LogLevel::INFO, event);
+	log(LogLevel::INFO, *event);
+}
+
+void Logger::warn(LogEvent::ptr event) {
+	log(LogLevel::WARN, *event);
+}
+
+void Logger::error(LogEvent::ptr event) {
+	log(LogLevel::ERROR, *event);
+}
+
+void Logger::fatal(LogEvent::ptr event) {
+	log(LogLevel::FATAL, *event);
+}
+
+const char* FileLogAppender::RotateModeToString(RotateMode mode) {
+	switch(mode) {
+	case ROTATE_HOURLY:
+		return "hourly";
+	case ROTATE_DAILY:
+		return "daily";
+	default:
+		return "none";
+	}
+}
+
+FileLogAppender::RotateMode FileLogAppender::RotateModeFromString(const std::string& str) {
+	if(str == "hourly" || str == "HOURLY") {
+		return ROTATE_HOURLY;
+	}
+	if(str == "daily" || str == "DAILY") {
+		return ROTATE_DAILY;
+	}
+	return ROTATE_NONE;
+}
+
+/**
+* @brief 将src压缩为src.gz后删除src, 先写入临时文件, 避免进程退出时留下不完整的.gz
+*/
+static bool GzipFile(const std::string& src) {
+	int fd = open(src.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	std::string tmp = src + ".gz.tmp";
+	gzFile gz = gzopen(tmp.c_str(), "wb");
+	if (!gz) {
+		close(fd);
+		return false;
+	}
+	char buf[64 * 1024];
+	bool ok = true;
+	while (true) {
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			ok = n == 0;
+			break;
+		}
+		if (gzwrite(gz, buf, n) != n) {
+			ok = false;
+			break;
+		}
+	}
+	close(fd);
+	if (gzclose(gz) != Z_OK || !ok || rename(tmp.c_str(), (src + ".gz").c_str())) {
+		unlink(tmp.c_str());
+		return false;
+	}
+	unlink(src.c_str());
+	return true;
+}
+
+/**
+* @brief 删除最旧的历史文件, 只保留max_files个
+* @details 历史文件名为 "文件名.年月日-时分秒[.序号][.gz]", 序号补零到3位,
+*          去掉.gz后按文件名排序即按时间排序
+*/
+static void PruneRotated(const std::string& filename, uint32_t max_files) {
+	if (max_files == 0) {
+		return;
+	}
+	size_t pos = filename.rfind('/');
+	std::string dir = pos == std::string::npos ? "." : filename.substr(0, pos + 1);
+	std::string prefix = (pos == std::string::npos ? filename : filename.substr(pos + 1)) + ".";
+	DIR* d = opendir(dir.c_str());
+	if (!d) {
+		return;
+	}
+	std::vector<std::string> files;
+	while (struct dirent* ent = readdir(d)) {
+		std::string name = ent->d_name;
+		if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0
+				&& isdigit((unsigned char)name[prefix.size()])
+				&& (name.size() < 4 || name.compare(name.size() - 4, 4, ".tmp") != 0)) {
+			files.push_back(name);
+		}
+	}
+	closedir(d);
+	if (files.size() <= max_files) {
+		return;
+	}
+	/// 压缩与否不影响先后, 否则"x.gz"会排在"x.001"之后
+	auto key = [](const std::string& name) {
+		return name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0
+			? name.substr(0, name.size() - 3) : name;
+	};
+	std::sort(files.begin(), files.end(), [&key](const std::string& a, const std::string& b) {
+		return key(a) < key(b);
+	});
+	for (size_t i = 0; i < files.size() - max_files; ++i) {
+		unlink((pos == std::string::npos ? files[i] : dir + files[i]).c_str());
+	}
+}
+
+/**
+* @brief 后台压缩及清理历史文件的线程
+* @details 所有FileLogAppender共用一个线程, 切分时只把任务放入队列,
+*          写日志的线程不等待压缩和删除. 对象不释放, 与LogFlusher相同
+*/
+class LogRotateWorker {
+public:
+	static LogRotateWorker* GetInstance() {
+		static LogRotateWorker* s_instance = new LogRotateWorker;
+		return s_instance;
+	}
+
+	/**
+	* @brief 添加任务
+	* @param[in] filename 日志文件名, 用于清理历史文件
+	* @param[in] target 需要压缩的历史文件, 为空时不压缩
+	* @param[in] max_files 保留的历史文件个数
+	*/
+	void add(const std::string& filename, const std::string& target, uint32_t max_files) {
+		Mutex::Lock lock(m_mutex);
+		m_tasks.push_back(Task{filename, target, max_files});
+		++m_pending;
+		if (!m_thread) {
+			m_thread.reset(new Thread(std::bind(&LogRotateWorker::run, this), "log_rotate"));
+		}
+		lock.unlock();
+		m_sem.notify();
+	}
+
+	/**
+	* @brief 等待已添加的任务全部完成
+	*/
+	void wait() {
+		while (m_pending.load()) {
+			usleep(1000);
+		}
+	}
+private:
+	struct Task {
+		std::string filename;
+		std::string target;
+		uint32_t max_files;
+	};
+
+	void run() {
+		while (true) {
+			m_sem.wait();
+			Task task;
+			{
+				Mutex::Lock lock(m_mutex);
+				task = m_tasks.front();
+				m_tasks.pop_front();
+			}
+			if (!task.target.empty()) {
+				GzipFile(task.target);
+			}
+			PruneRotated(task.filename, task.max_files);
+			--m_pending;
+		}
+	}
+private:
+	Mutex m_mutex;
+	std::deque<Task> m_tasks;
+	Semaphore m_sem;
+	/// 未完成的任务数
+	std::atomic<uint64_t> m_pending{0};
+	Thread::ptr m_thread;
+};
+
+static uint64_t NowMs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+	return ts.tv_sec * 1000ul + ts.tv_nsec / 1000000;
+}
+
+/**
+* @brief 后台刷新线程, 定期调用已注册Appender的flushExpired
+* @details 对象不释放, 避免进程退出时静态析构与刷新线程竞争
+*/
+class LogFlusher {
+public:
+	static LogFlusher* GetInstance() {
+		static LogFlusher* s_instance = new LogFlusher;
+		return s_instance;
+	}
+
+	void add(LogAppender* appender, uint32_t interval_ms) {
+		Mutex::Lock lock(m_mutex);
+		m_appenders[appender] = std::max(interval_ms, 1u);
+		if (!m_thread) {
+			m_thread.reset(new Thread(std::bind(&LogFlusher::run, this), "log_flush"));
+		}
+	}
+
+	void del(LogAppender* appender) {
+		Mutex::Lock lock(m_mutex);
+		m_appenders.erase(appender);
+	}
+private:
+	void run() {
+		while (true) {
+			uint32_t sleep_ms = 100;
+			{
+				Mutex::Lock lock(m_mutex);
+				uint64_t now = NowMs();
+				for (auto& i : m_appenders) {
+					i.first->flushExpired(now);
+					sleep_ms = std::min(sleep_ms, std::max(i.second / 2, 1u));
+				}
+			}
+			usleep(sleep_ms * 1000);
+		}
+	}
+private:
+	Mutex m_mutex;
+	std::map<LogAppender*, uint32_t> m_appenders;
+	Thread::ptr m_thread;
+};
+
+void LogAppender::AddFlushTimer(LogAppender* appender, uint32_t interval_ms) {
+	LogFlusher::GetInstance()->add(appender, interval_ms);
+}
+
+void LogAppender::DelFlushTimer(LogAppender* appender) {
+	LogFlusher::GetInstance()->del(appender);
+}
+
+/**
+* @brief 一个线程在一个FileLogAppender中的缓冲区
+*/
+struct FileLogAppender::ThreadBuffer {
+	/// 只在所属线程写日志、其他线程flush时竞争
+	Mutex mutex;
+	/// Appender析构后置为nullptr
+	FileLogAppender* owner = nullptr;
+	/// 已格式化未写出的日志
+	std::string data;
+	/// data中第一条日志的时间(毫秒)
+	uint64_t first_ms = 0;
+	/// 缓存的格式器及其版本
+	LogFormatter::ptr formatter;
+	uint32_t version = 0;
+	/// 所属线程已退出
+	std::atomic<bool> dead{false};
+};
+
+/**
+* @brief 当前线程在各个FileLogAppender中的缓冲区, 线程退出时写出
+*/
+struct FileLogAppender::ThreadBufferCache {
+	std::vector<std::pair<uint64_t, std::shared_ptr<ThreadBuffer> > > buffers;
+
+	void flush() {
+		uint64_t now = NowMs();
+		for (auto& i : buffers) {
+			Mutex::Lock lock(i.second->mutex);
+			if (i.second->owner) {
+				i.second->owner->flushBuffer(i.second.get(), true, now);
+			}
+		}
+	}
+
+	~ThreadBufferCache() {
+		flush();
+		for (auto& i : buffers) {
+			i.second->dead = true;
+		}
+	}
+};
+
+FileLogAppender::ThreadBufferCache* FileLogAppender::GetBufferCache(bool create) {
+	/// 先查普通指针, 避免每次都经过带析构函数的thread_local的初始化检查
+	static thread_local ThreadBufferCache* t_cache = nullptr;
+	if (!t_cache && create) {
+		static thread_local ThreadBufferCache s_cache;
+		t_cache = &s_cache;
+	}
+	return t_cache;
+}
+
+static std::atomic<uint64_t> s_file_appender_id{0};
+
+FileLogAppender::FileLogAppender(const std::string & filename, const RotatePolicy& policy)
+	:m_filename(filename)
+	,m_policy(policy)
+	,m_id(++s_file_appender_id) {
+	reopen();
+}
+
+FileLogAppender::~FileLogAppender() {
+	if (m_bufferSize) {
+		DelFlushTimer(this);
+	}
+	Mutex::Lock lock(m_buffersMutex);
+	uint64_t now = NowMs();
+	for (auto& i : m_buffers) {
+		Mutex::Lock ll(i->mutex);
+		flushBuffer(i.get(), true, now);
+		i->owner = nullptr;
+	}
+	m_buffers.clear();
+	lock.unlock();
+
+	/// 等待历史文件压缩及清理完成
+	if (m_policy.compress || m_policy.max_files) {
+		LogRotateWorker::GetInstance()->wait();
+	}
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+}
+
+void FileLogAppender::setBuffer(size_t size, uint32_t interval_ms) {
+	if (m_bufferSize) {
+		DelFlushTimer(this);
+	}
+	flush();
+	m_flushInterval = interval_ms;
+	m_bufferSize = size;
+	if (m_bufferSize) {
+		AddFlushTimer(this, m_flushInterval);
+	}
+}
+
+FileLogAppender::ThreadBuffer* FileLogAppender::getThreadBuffer() {
+	ThreadBufferCache* cache = GetBufferCache(true);
+	for (auto& i : cache->buffers) {
+		if (i.first == m_id) {
+			return i.second.get();
+		}
+	}
+	/// 新建之前移除所属Appender已析构的缓冲区, 避免重新加载配置后越积越多
+	auto it = std::remove_if(cache->buffers.begin(), cache->buffers.end()
+			,[](const std::pair<uint64_t, std::shared_ptr<ThreadBuffer> >& b) {
+				Mutex::Lock lock(b.second->mutex);
+				return b.second->owner == nullptr;
+			});
+	cache->buffers.erase(it, cache->buffers.end());
+	std::shared_ptr<ThreadBuffer> buf(new ThreadBuffer);
+	buf->owner = this;
+	buf->data.reserve(m_bufferSize + 512);
+	cache->buffers.push_back(std::make_pair(m_id, buf));
+	Mutex::Lock lock(m_buffersMutex);
+	m_buffers.push_back(buf);
+	return buf.get();
+}
+
+void FileLogAppender::flushBuffer(ThreadBuffer* buf, bool all, uint64_t now_ms) {
+	if (buf->data.empty() || (!all && now_ms < buf->first_ms + m_flushInterval)) {
+		return;
+	}
+	MutexType::Lock lock(m_mutex);
+	writeData(buf->data.data(), buf->data.size(), now_ms / 1000);
+	buf->data.clear();
+}
+
+void FileLogAppender::flushBuffers(bool all, uint64_t now_ms) {
+	std::vector<std::shared_ptr<ThreadBuffer> > buffers;
+	{
+		Mutex::Lock lock(m_buffersMutex);
+		/// 顺便移除已退出线程的缓冲区
+		auto it = std::remove_if(m_buffers.begin(), m_buffers.end()
+				,[](const std::shared_ptr<ThreadBuffer>& b) { return b->dead.load(); });
+		m_buffers.erase(it, m_buffers.end());
+		buffers = m_buffers;
+	}
+	for (auto& i : buffers) {
+		Mutex::Lock lock(i->mutex);
+		flushBuffer(i.get(), all, now_ms);
+	}
+}
+
+void FileLogAppender::flush() {
+	flushBuffers(true, NowMs());
+}
+
+void FileLogAppender::flushExpired(uint64_t now_ms) {
+	flushBuffers(false, now_ms);
+}
+
+void FileLogAppender::FlushThreadBuffers() {
+	ThreadBufferCache* cache = GetBufferCache(false);
+	if (cache) {
+		cache->flush();
+	}
+}
+
+void FileLogAppender::append(Logger& logger, LogLevel::Level level, const LogEvent& event)
+{
+	if (level < m_level) {
+		return;
+	}
+	size_t buffer_size = m_bufferSize;
+	if (buffer_size) {
+		/// 格式化到当前线程的缓冲区, 满了才加锁整块写入
+		ThreadBuffer* buf = getThreadBuffer();
+		Mutex::Lock lock(buf->mutex);
+		uint32_t version = m_formatterVersion;
+		if (!buf->formatter || buf->version != version) {
+			MutexType::Lock ll(m_mutex);
+			buf->formatter = m_formatter;
+			buf->version = version;
+		}
+		if (buf->data.empty()) {
+			buf->first_ms = event.getTime() * 1000 + event.getUsec() / 1000;
+		}
+		LogSampleTimer timer;
+		size_t old = buf->data.size();
+		buf->formatter->format(buf->data, level, event);
+		countEvent(buf->data.size() - old, timer.lap());
+		if (buf->data.size() >= buffer_size) {
+			MutexType::Lock ll(m_mutex);
+			writeData(buf->data.data(), buf->data.size(), event.getTime());
+			buf->data.clear();
+		}
+		return;
+	}
+	MutexType::Lock lock(m_mutex);
+	LogSampleTimer timer;
+	m_buf.clear();
+	m_formatter->format(m_buf, level, event);
+	countEvent(m_buf.size(), timer.lap());
+	writeData(m_buf.data(), m_buf.size(), event.getTime());
+}
+
+void FileLogAppender::checkFile(uint64_t now) {
+	if (now == m_lastTime) {
+		return;
+	}
+	/// 每秒检查一次文件是否被删除或被外部移走, 只在inode变化时重新打开
+	m_lastTime = now;
+	struct stat st;
+	if (m_fd < 0 || stat(m_filename.c_str(), &st) != 0
+			|| (uint64_t)st.st_dev != m_dev || (uint64_t)st.st_ino != m_ino) {
+		openFile();
+	}
+	if (m_policy.mode != ROTATE_NONE && periodOf(now) != m_period) {
+		rotateFile(now);
+	}
+}
+
+void FileLogAppender::writeData(const char* data, size_t len, uint64_t now) {
+	checkFile(now);
+	if (m_policy.max_size && m_size > 0 && m_size + len > m_policy.max_size) {
+		rotateFile(now);
+	}
+	LogSampleTimer timer(true);
+	size_t pos = 0;
+	while (m_fd >= 0 && pos < len) {
+		ssize_t rt = write(m_fd, data + pos, len - pos);
+		if (rt < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::cout << "error" << std::endl;
+			break;
+		}
+		pos += rt;
+	}
+	m_size += pos;
+	addCounter(WRITE_NS, timer.lap());
+}
+
+std::string FileLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "FileLogAppender";
+    node["file"] = m_filename;
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if(m_policy.max_size) {
+        node["max_size"] = m_policy.max_size;
+    }
+    if(m_policy.mode != ROTATE_NONE) {
+        node["rotate"] = RotateModeToString(m_policy.mode);
+    }
+    if(m_policy.max_files) {
+        node["max_files"] = m_policy.max_files;
+    }
+    if(m_policy.compress) {
+        node["compress"] = true;
+    }
+    if(m_bufferSize) {
+        node["buffer_size"] = m_bufferSize.load();
+        node["flush_interval"] = m_flushInterval.load();
+    }
+
+    if(m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    // std::cout << "===================" << "FileLogAppender::toYamlString()" << std::endl;
+    ss << node;
+    // std::cout << "=================== finish" << std::endl;
+    return ss.str();
+}
+
+bool FileLogAppender::reopen()
+{
+    MutexType::Lock lock(m_mutex);
+	return openFile();
+}
+
+void FileLogAppender::rotate() {
+    MutexType::Lock lock(m_mutex);
+	rotateFile(time(0));
+}
+
+bool FileLogAppender::openFile() {
+	if (m_fd >= 0) {
+		close(m_fd);
+		addCounter(REOPENS);
+	}
+	m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	struct stat st;
+	if (m_fd < 0 || fstat(m_fd, &st) != 0) {
+		std::cout << "!!!! open error !!!!" << std::endl;
+		return false;
+	}
+	m_dev = st.st_dev;
+	m_ino = st.st_ino;
+	m_size = st.st_size;
+	/// 已有内容的文件按最后修改时间计算所属周期, 重启后跨周期的旧文件会先被切分
+	m_period = periodOf(st.st_size ? st.st_mtime : time(0));
+	return true;
+}
+
+uint64_t FileLogAppender::periodOf(time_t now) const {
+	if (m_policy.mode == ROTATE_NONE) {
+		return 0;
+	}
+	struct tm tm;
+	localtime_r(&now, &tm);
+	uint64_t period = (uint64_t)tm.tm_year * 1000 + tm.tm_yday;
+	return m_policy.mode == ROTATE_HOURLY ? period * 24 + tm.tm_hour : period;
+}
+
+void FileLogAppender::rotateFile(time_t now) {
+	if (m_fd >= 0) {
+		close(m_fd);
+		m_fd = -1;
+	}
+	addCounter(REOPENS);
+	struct tm tm;
+	localtime_r(&now, &tm);
+	char suffix[32];
+	strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &tm);
+	std::string base = m_filename + suffix;
+	std::string target = base;
+	/// 同一秒内再次切分时序号接着上次的, 已被清理掉的较小序号不再使用
+	int i = 0;
+	if (base == m_rotateBase) {
+		i = m_rotateSeq + 1;
+	}
+	while (true) {
+		if (i) {
+			/// 补零, 使同一秒内的多个文件按文件名排序即按时间排序
+			char seq[16];
+			snprintf(seq, sizeof(seq), ".%03d", i);
+			target = base + seq;
+		}
+		if (access(target.c_str(), F_OK) != 0 && access((target + ".gz").c_str(), F_OK) != 0) {
+			break;
+		}
+		++i;
+	}
+	m_rotateBase = base;
+	m_rotateSeq = i;
+	if (rename(m_filename.c_str(), target.c_str())) {
+		std::cout << "FileLogAppender rename error file=" << m_filename
+			<< " errno=" << errno << std::endl;
+	}
+	openFile();
+
+	/// 压缩和清理在后台线程中按顺序进行, 不在持有锁时等待
+	if (m_policy.compress || m_policy.max_files) {
+		LogRotateWorker::GetInstance()->add(m_filename
+				,m_policy.compress ? target : std::string(), m_policy.max_files);
+	}
+}
+
+const char* AsyncLogAppender::PolicyToString(OverflowPolicy policy) {
+	switch(policy) {
+	case DROP_NEWEST:
+		return "drop_newest";
+	case DROP_DEBUG_FIRST:
+		return "drop_debug_first";
+	default:
+		return "block";
+	}
+}
+
+AsyncLogAppender::OverflowPolicy AsyncLogAppender::PolicyFromString(const std::string& str) {
+	if(str == "drop_newest" || str == "DROP_NEWEST") {
+		return DROP_NEWEST;
+	}
+	if(str == "drop_debug_first" || str == "DROP_DEBUG_FIRST") {
+		return DROP_DEBUG_FIRST;
+	}
+	if(str.empty() || str == "block" || str == "BLOCK") {
+		return BLOCK;
+	}
+	/// 写错的策略不能让写日志的线程意外阻塞
+	std::cout << "log config error: asyncfileappender overflow is invalid, " << str
+		<< ", use drop_newest" << std::endl;
+	return DROP_NEWEST;
+}
+
+static std::atomic<uint64_t> s_async_appender_id{0};
+
+AsyncLogAppender::AsyncLogAppender(const std::string& filename, size_t capacity
+		,OverflowPolicy policy)
+	:m_filename(filename)
+	,m_policy(policy)
+	,m_id(++s_async_appender_id) {
+	size_t cap = 2;
+	while(cap < capacity) {
+		cap <<= 1;
+	}
+	m_mask = cap - 1;
+	m_slots = new Slot[cap];
+	for(size_t i = 0; i < cap; ++i) {
+		m_slots[i].seq.store(i, std::memory_order_relaxed);
+	}
+	reopen();
+	m_thread.reset(new Thread(std::bind(&AsyncLogAppender::run, this), "log_async"));
+}
+
+AsyncLogAppender::~AsyncLogAppender() {
+	m_stopping = true;
+	wakeup();
+	m_thread->join();
+	if(m_fd >= 0) {
+		close(m_fd);
+	}
+	delete[] m_slots;
+}
+
+/**
+ *  有界多生产者队列(Dmitry Vyukov), 每个槽位的seq:
+ *      seq == pos          槽位空闲, 可由位置pos的生产者写入
+ *      seq == pos + 1      槽位已写入, 可由消费者读取
+ *      seq == pos + 容量    消费者已取走, 留给下一轮的生产者
+ */
+bool AsyncLogAppender::push(std::string& msg, bool block) {
+	uint64_t pos = m_tail.load(std::memory_order_relaxed);
+	while(true) {
+		Slot& slot = m_slots[pos & m_mask];
+		uint64_t seq = slot.seq.load(std::memory_order_acquire);
+		int64_t diff = (int64_t)seq - (int64_t)pos;
+		if(diff == 0) {
+			if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				slot.data.swap(msg);
+				slot.seq.store(pos + 1, std::memory_order_release);
+				break;
+			}
+		} else if(diff < 0) {
+			/// 队列已满
+			if(!block) {
+				return false;
+			}
+			wakeup();
+			sched_yield();
+			pos = m_tail.load(std::memory_order_relaxed);
+		} else {
+			pos = m_tail.load(std::memory_order_relaxed);
+		}
+	}
+	/// 与run()中的m_waiting/队列检查配对, 避免后台线程错过唤醒
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(m_waiting.load(std::memory_order_relaxed)) {
+		wakeup();
+	}
+	return true;
+}
+
+void AsyncLogAppender::wakeup() {
+	if(m_waiting.exchange(false)) {
+		m_sem.notify();
+	}
+}
+
+void AsyncLogAppender::append(Logger& logger, LogLevel::Level level, const LogEvent& event) {
+	if(level < m_level) {
+		return;
+	}
+	if(m_policy == DROP_DEBUG_FIRST && level <= LogLevel::DEBUG
+			&& size() >= (m_mask + 1) / 4 * 3) {
+		++m_dropped;
+		++m_droppedDebug;
+		addCounter(DROPPED);
+		return;
+	}
+	/// 每个线程缓存最近使用的格式器, 格式器未更换时不需要加锁
+	struct Cache {
+		uint64_t id = 0;
+		uint32_t version = 0;
+		LogFormatter::ptr formatter;
+		std::string buf;
+	};
+	static thread_local Cache t_cache;
+	uint32_t version = m_formatterVersion;
+	if(t_cache.id != m_id || t_cache.version != version || !t_cache.formatter) {
+		MutexType::Lock lock(m_mutex);
+		t_cache.formatter = m_formatter;
+		t_cache.id = m_id;
+		t_cache.version = version;
+	}
+	/// 格式化在调用线程中完成, 不持有appender的锁
+	LogSampleTimer timer;
+	std::string& msg = t_cache.buf;
+	msg.clear();
+	t_cache.formatter->format(msg, level, event);
+	uint64_t format_ns = timer.lap();
+	size_t bytes = msg.size();
+	bool pushed = push(msg, m_policy != DROP_NEWEST);
+	/// 换回的是槽位中已写出的字符串, 容量不够时按本条的长度预留, 稳定后不再分配
+	msg.clear();
+	msg.reserve(bytes);
+	if(pushed) {
+		countEvent(bytes, format_ns);
+	} else {
+		++m_dropped;
+		if(level <= LogLevel::DEBUG) {
+			++m_droppedDebug;
+		}
+		addCounter(DROPPED);
+	}
+}
+
+void AsyncLogAppender::flush() {
+	uint64_t target = m_tail.load();
+	while(m_head.load() < target) {
+		/// 还有生产者未写完的槽位时也需要等待
+		wakeup();
+		sched_yield();
+	}
+}
+
+void AsyncLogAppender::run() {
+	while(true) {
+		if(drain()) {
+			continue;
+		}
+		if(m_stopping) {
+			break;
+		}
+		m_waiting.store(true);
+		Slot& slot = m_slots[m_head.load(std::memory_order_relaxed) & m_mask];
+		if(slot.seq.load() == m_head.load(std::memory_order_relaxed) + 1 || m_stopping) {
+			/// 已有数据, 如果生产者已经清除了等待标记, 需要消耗掉它的notify
+			if(!m_waiting.exchange(false)) {
+				m_sem.wait();
+			}
+			continue;
+		}
+		m_sem.wait();
+	}
+}
+
+size_t AsyncLogAppender::drain() {
+	static const size_t s_batch = 64;
+	struct iovec iov[s_batch];
+	uint64_t head = m_head.load(std::memory_order_relaxed);
+	size_t count = 0;
+	size_t bytes = 0;
+	while(count < s_batch) {
+		Slot& slot = m_slots[(head + count) & m_mask];
+		if(slot.seq.load(std::memory_order_acquire) != head + count + 1) {
+			break;
+		}
+		iov[count].iov_base = (void*)slot.data.data();
+		iov[count].iov_len = slot.data.size();
+		bytes += slot.data.size();
+		++count;
+	}
+	if(count == 0) {
+		return 0;
+	}
+
+	/// 解决文件被删除后还在 输出在已被删除的文件中的问题的解决方案
+	/// 每秒检查一次, 同FileLogAppender::checkFile只在inode变化时重新打开
+	uint64_t now = time(0);
+	if(now != m_lastTime) {
+		m_lastTime = now;
+		struct stat st;
+		if(m_fd < 0 || stat(m_filename.c_str(), &st) != 0
+				|| (uint64_t)st.st_dev != m_dev || (uint64_t)st.st_ino != m_ino) {
+			reopen();
+		}
+	}
+
+	if(m_fd >= 0) {
+		LogSampleTimer timer(true);
+		struct iovec* cur = iov;
+		size_t left = count;
+		while(left) {
+			ssize_t rt = writev(m_fd, cur, left);
+			if(rt < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+				std::cout << "AsyncLogAppender writev error file=" << m_filename
+					<< " errno=" << errno << std::endl;
+				break;
+			}
+			/// 部分写入时跳过已写完的iovec
+			size_t n = rt;
+			while(left && n >= cur->iov_len) {
+				n -= cur->iov_len;
+				++cur;
+				--left;
+			}
+			if(left) {
+				cur->iov_base = (char*)cur->iov_base + n;
+				cur->iov_len -= n;
+			}
+		}
+		addCounter(WRITE_NS, timer.lap());
+	}
+
+	for(size_t i = 0; i < count; ++i) {
+		Slot& slot = m_slots[(head + i) & m_mask];
+		slot.data.clear();
+		slot.seq.store(head + i + m_mask + 1, std::memory_order_release);
+	}
+	m_head.store(head + count, std::memory_order_release);
+	return count;
+}
+
+bool AsyncLogAppender::reopen() {
+	if(m_fd >= 0) {
+		close(m_fd);
+		addCounter(REOPENS);
+	}
+	m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	struct stat st;
+	if(m_fd < 0 || fstat(m_fd, &st) != 0) {
+		std::cout << "!!!! open error !!!! file=" << m_filename << std::endl;
+		return false;
+	}
+	m_dev = st.st_dev;
+	m_ino = st.st_ino;
+	return true;
+}
+
+std::string AsyncLogAppender::toYamlString() {
+	MutexType::Lock lock(m_mutex);
+	YAML::Node node;
+	node["type"] = "AsyncFileLogAppender";
+	node["file"] = m_filename;
+	node["capacity"] = getCapacity();
+	node["overflow"] = PolicyToString(m_policy);
+	if(m_level != LogLevel::UNKNOW) {
+		node["level"] = LogLevel::ToString(m_level);
+	}
+
+	if(m_hasFormatter && m_formatter) {
+		node["formatter"] = m_formatter->getPattern();
+	}
+	std::stringstream ss;
+	ss << node;
+	return ss.str();
+}
+
+void StdoutLogAppender::append(Logger& logger, LogLevel::Level level, const LogEvent& event)
+{
+	// m_level 初始化为 LogLevel::DEBUG
+	if (level >= m_level) {
+		static thread_local std::string t_buf;
+		LogSampleTimer timer;
+		t_buf.clear();
+        MutexType::Lock lock(m_mutex);
+		m_formatter->format(t_buf, level, event);
+		countEvent(t_buf.size(), timer.lap());
+		std::cout.write(t_buf.data(), t_buf.size());
+		/// 保持与NewLineFormatItem(std::endl)相同的刷新行为
+		if (m_formatter->isFlush()) {
+			std::cout.flush();
+		}
+		addCounter(WRITE_NS, timer.lap());
+	}
+}
+
+std::string StdoutLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "StdoutLogAppender";
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+
+    if(m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    // std::cout << "===================" << "StdoutLogAppender::toYamlString()" << std::endl;
+    ss << node;
+    // std::cout << "=================== finish" << std::endl;
+    return ss.str();
+}
+
+/// 二进制日志文件的魔数及版本
+static const char s_binary_magic[] = "IPMSGBIN";
+static const uint8_t s_binary_version = 1;
+/// 缓冲区超过该大小时写入文件
+static const size_t s_binary_flush_size = 64 * 1024;
+/// 日志在缓冲区中的最长停留时间(毫秒), 超过后由后台刷新线程写入文件
+static const uint32_t s_binary_flush_ms = 1000;
+
+static void PutVarint(std::string& buf, uint64_t v) {
+	char tmp[10];
+	size_t n = 0;
+	while (v >= 0x80) {
+		tmp[n++] = (char)(v | 0x80);
+		v >>= 7;
+	}
+	tmp[n++] = (char)v;
+	buf.append(tmp, n);
+}
+
+static void PutFixed(std::string& buf, uint64_t v, size_t bytes) {
+	for (size_t i = 0; i < bytes; ++i) {
+		buf.push_back((char)(v >> (i * 8)));
+	}
+}
+
+BinaryFileLogAppender::BinaryFileLogAppender(const std::string& filename)
+	:m_filename(filename) {
+	m_buf.reserve(s_binary_flush_size * 2);
+	reopen();
+	AddFlushTimer(this, s_binary_flush_ms);
+}
+
+BinaryFileLogAppender::~BinaryFileLogAppender() {
+	DelFlushTimer(this);
+	flush();
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+}
+
+void BinaryFileLogAppender::writeHeader(uint64_t sec, uint32_t usec) {
+	m_buf.append(s_binary_magic, sizeof(s_binary_magic) - 1);
+	m_buf.push_back((char)s_binary_version);
+	PutFixed(m_buf, sec, 8);
+	PutFixed(m_buf, usec, 4);
+	m_lastUs = sec * 1000000 + usec;
+	m_nextId = 0;
+	m_sites.clear();
+	m_loggers.clear();
+	m_threads.clear();
+}
+
+uint32_t BinaryFileLogAppender::intern(std::unordered_map<std::string, uint32_t>& table
+		,StringKind kind, const std::string& str) {
+	auto it = table.find(str);
+	if (it != table.end()) {
+		return it->second;
+	}
+	uint32_t id = m_nextId++;
+	table[str] = id;
+	m_buf.push_back('S');
+	PutVarint(m_buf, id);
+	PutVarint(m_buf, kind);
+	PutVarint(m_buf, str.size());
+	m_buf.append(str);
+	return id;
+}
+
+void BinaryFileLogAppender::append(Logger& logger, LogLevel::Level level, const LogEvent& event) {
+	if (level < m_level) {
+		return;
+	}
+	MutexType::Lock lock(m_mutex);
+	/// 字节数包含本条日志新增的字符串表项
+	LogSampleTimer timer;
+	size_t old = m_buf.size();
+	Site site{event.getFile(), event.getLine()};
+	auto it = m_sites.find(site);
+	uint32_t site_id;
+	if (it == m_sites.end()) {
+		site_id = m_nextId++;
+		m_sites[site] = site_id;
+		size_t len = strlen(site.file);
+		m_buf.push_back('S');
+		PutVarint(m_buf, site_id);
+		PutVarint(m_buf, KIND_SITE);
+		PutVarint(m_buf, ((uint64_t)site.line << 1) ^ (uint64_t)(site.line >> 31));
+		PutVarint(m_buf, len);
+		m_buf.append(site.file, len);
+	} else {
+		site_id = it->second;
+	}
+	uint32_t logger_id = intern(m_loggers, KIND_LOGGER, event.getLoggerName());
+	uint32_t thread_id = intern(m_threads, KIND_THREAD, event.getThreadName());
+
+	uint64_t now = event.getTime() * 1000000 + event.getUsec();
+	int64_t delta = (int64_t)(now - m_lastUs);
+	m_lastUs = now;
+
+	if (!m_firstMs) {
+		m_firstMs = event.getTime() * 1000 + event.getUsec() / 1000;
+	}
+	const std::string& content = event.getContent();
+	m_buf.push_back('R');
+	m_buf.push_back((char)level);
+	PutVarint(m_buf, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+	PutVarint(m_buf, event.getThreadId());
+	PutVarint(m_buf, event.getFiberId());
+	PutVarint(m_buf, site_id);
+	PutVarint(m_buf, logger_id);
+	PutVarint(m_buf, thread_id);
+	PutVarint(m_buf, event.getElapse());
+	PutVarint(m_buf, content.size());
+	m_buf.append(content);
+	countEvent(m_buf.size() - old, timer.lap());
+
+	/// 缓冲区满或进入新的一秒时写入文件
+	if (m_buf.size() >= s_binary_flush_size || event.getTime() != m_lastFlush) {
+		flushBuffer();
+		m_lastFlush = event.getTime();
+	}
+}
+
+void BinaryFileLogAppender::flushBuffer() {
+	LogSampleTimer timer(true);
+	size_t pos = 0;
+	while (m_fd >= 0 && pos < m_buf.size()) {
+		ssize_t rt = write(m_fd, m_buf.data() + pos, m_buf.size() - pos);
+		if (rt < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::cout << "BinaryFileLogAppender write error file=" << m_filename
+				<< " errno=" << errno << std::endl;
+			break;
+		}
+		pos += rt;
+	}
+	if (pos) {
+		addCounter(WRITE_NS, timer.lap());
+	}
+	m_buf.clear();
+	m_firstMs = 0;
+}
+
+void BinaryFileLogAppender::flush() {
+	MutexType::Lock lock(m_mutex);
+	flushBuffer();
+}
+
+void BinaryFileLogAppender::flushExpired(uint64_t now_ms) {
+	MutexType::Lock lock(m_mutex);
+	/// 一段时间内没有新日志时, 缓冲区中最后的日志也要及时写入文件
+	if (!m_firstMs || now_ms < m_firstMs + s_binary_flush_ms) {
+		return;
+	}
+	flushBuffer();
+}
+
+bool BinaryFileLogAppender::reopen() {
+	MutexType::Lock lock(m_mutex);
+	flushBuffer();
+	if (m_fd >= 0) {
+		close(m_fd);
+		addCounter(REOPENS);
+	}
+	m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (m_fd < 0) {
+		std::cout << "!!!! open error !!!! file=" << m_filename << std::endl;
+		return false;
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+	writeHeader(ts.tv_sec, ts.tv_nsec / 1000);
+	return true;
+}
+
+std::string BinaryFileLogAppender::toYamlString() {
+	MutexType::Lock lock(m_mutex);
+	YAML::Node node;
+	node["type"] = "BinaryFileLogAppender";
+	node["file"] = m_filename;
+	if (m_level != LogLevel::UNKNOW) {
+		node["level"] = LogLevel::ToString(m_level);
+	}
+	std::stringstream ss;
+	ss << node;
+	return ss.str();
+}
+
+BinaryLogReader::BinaryLogReader(const std::string& filename)
+	:m_ifs(filename, std::ios::binary) {
+}
+
+bool BinaryLogReader::readVarint(uint64_t& v) {
+	v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = m_ifs.get();
+		if (c == EOF) {
+			return false;
+		}
+		v |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool BinaryLogReader::readString(std::string& str, size_t len) {
+	str.resize(len);
+	return len == 0 || (bool)m_ifs.read(&str[0], len);
+}
+
+bool BinaryLogReader::readHeader() {
+	char magic[sizeof(s_binary_magic) - 1];
+	/// 标记字节'I'已被读取
+	magic[0] = 'I';
+	unsigned char rest[1 + 8 + 4];
+	if (!m_ifs.read(magic + 1, sizeof(magic) - 1)
+			|| memcmp(magic, s_binary_magic, sizeof(magic))
+			|| !m_ifs.read((char*)rest, sizeof(rest))
+			|| rest[0] != s_binary_version) {
+		return false;
+	}
+	uint64_t sec = 0;
+	uint32_t usec = 0;
+	for (int i = 0; i < 8; ++i) {
+		sec |= (uint64_t)rest[1 + i] << (i * 8);
+	}
+	for (int i = 0; i < 4; ++i) {
+		usec |= (uint32_t)rest[9 + i] << (i * 8);
+	}
+	m_lastUs = sec * 1000000 + usec;
+	m_entries.clear();
+	return true;
+}
+
+bool BinaryLogReader::readStringEntry() {
+	uint64_t id, kind, len, line = 0;
+	if (!readVarint(id) || !readVarint(kind)) {
+		return false;
+	}
+	if (kind == BinaryFileLogAppender::KIND_SITE && !readVarint(line)) {
+		return false;
+	}
+	std::string str;
+	if (!readVarint(len) || !readString(str, len)) {
+		return false;
+	}
+	if (id >= m_entries.size()) {
+		m_entries.resize(id + 1);
+	}
+	m_strings.push_back(str);
+	Entry& e = m_entries[id];
+	e.kind = kind;
+	e.line = (int32_t)((line >> 1) ^ (~(line & 1) + 1));
+	e.str = &m_strings.back();
+	return true;
+}
+
+const std::string* BinaryLogReader::lookup(uint64_t id, int kind, int32_t* line) {
+	if (id >= m_entries.size() || m_entries[id].kind != kind) {
+		return nullptr;
+	}
+	if (line) {
+		*line = m_entries[id].line;
+	}
+	return m_entries[id].str;
+}
+
+LogEvent::ptr BinaryLogReader::next() {
+	while (!m_error) {
+		int tag = m_ifs.get();
+		if (tag == EOF) {
+			return nullptr;
+		}
+		if (tag == 'I') {
+			m_error = !readHeader();
+		} else if (tag == 'S') {
+			m_error = !readStringEntry();
+		} else if (tag == 'R') {
+			int level = m_ifs.get();
+			uint64_t delta, thread_id, fiber_id, site_id, logger_id, name_id, elapse, len;
+			if (level == EOF || !readVarint(delta) || !readVarint(thread_id)
+					|| !readVarint(fiber_id) || !readVarint(site_id)
+					|| !readVarint(logger_id) || !readVarint(name_id)
+					|| !readVarint(elapse) || !readVarint(len)) {
+				m_error = true;
+				break;
+			}
+			int32_t line = 0;
+			const std::string* file = lookup(site_id, BinaryFileLogAppender::KIND_SITE, &line);
+			const std::string* logger_name = lookup(logger_id, BinaryFileLogAppender::KIND_LOGGER);
+			const std::string* thread_name = lookup(name_id, BinaryFileLogAppender::KIND_THREAD);
+			if (!file || !logger_name || !thread_name) {
+				m_error = true;
+				break;
+			}
+			m_lastUs += (int64_t)((delta >> 1) ^ (~(delta & 1) + 1));
+
+			auto& logger = m_loggers[*logger_name];
+			if (!logger) {
+				logger.reset(new Logger(*logger_name));
+			}
+			LogEvent::ptr event(new LogEvent(logger, (LogLevel::Level)level, file->c_str(), line
+					,elapse, thread_id, fiber_id, m_lastUs / 1000000, *thread_name));
+			event->setTime(m_lastUs / 1000000, m_lastUs % 1000000);
+			event->m_mdc = nullptr;
+			std::string& content = event->m_buf.buffer();
+			if (!readString(content, len)) {
+				m_error = true;
+				break;
+			}
+			return event;
+		} else {
+			m_error = true;
+		}
+	}
+	return nullptr;
+}
+
+static std::atomic<uint64_t> s_mmap_appender_id{0};
+
+/**
+* @brief 文件末尾最后一个非'\0'字节之后的位置, 跳过异常退出时残留的预分配空间
+*/
+static uint64_t FindDataEnd(int fd, uint64_t size) {
+	char buf[64 * 1024];
+	while (size > 0) {
+		size_t len = std::min(size, (uint64_t)sizeof(buf));
+		ssize_t rt = pread(fd, buf, len, size - len);
+		if (rt != (ssize_t)len) {
+			return size;
+		}
+		for (size_t i = len; i > 0; --i) {
+			if (buf[i - 1]) {
+				return size - len + i;
+			}
+		}
+		size -= len;
+	}
+	return 0;
+}
+
+MmapFileLogAppender::MmapFileLogAppender(const std::string& filename, size_t chunk_size)
+	:m_filename(filename)
+	,m_id(++s_mmap_appender_id) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	m_chunkSize = std::max((chunk_size + page - 1) / page * page, page);
+	m_fd = open(m_filename.c_str(), O_RDWR | O_CREAT, 0644);
+	struct stat st;
+	if (m_fd < 0 || fstat(m_fd, &st) != 0) {
+		std::cout << "!!!! open error !!!! file=" << m_filename << std::endl;
+		return;
+	}
+	m_start = FindDataEnd(m_fd, st.st_size);
+	m_cursor = m_start;
+}
+
+MmapFileLogAppender::~MmapFileLogAppender() {
+	Mutex::Lock lock(m_mapMutex);
+	for (auto& i : m_chunks) {
+		if (i.no) {
+			unmap(i);
+		}
+	}
+	if (m_fd >= 0) {
+		if (ftruncate(m_fd, m_cursor)) {
+			std::cout << "MmapFileLogAppender ftruncate error file=" << m_filename
+				<< " errno=" << errno << std::endl;
+		}
+		close(m_fd);
+	}
+}
+
+char* MmapFileLogAppender::acquire(uint64_t no) {
+	Chunk& chunk = m_chunks[no % s_ring];
+	int failures = 0;
+	while (true) {
+		uint64_t cur = chunk.no.load(std::memory_order_acquire);
+		if (cur == no + 1) {
+			return chunk.addr;
+		}
+		if (cur != 0) {
+			/// 槽位上的旧块还没写完, 说明写入超前太多, 等待
+			sched_yield();
+			continue;
+		}
+		Mutex::Lock lock(m_mapMutex);
+		if (chunk.no.load(std::memory_order_relaxed) != 0) {
+			continue;
+		}
+		off_t offset = no * m_chunkSize;
+		int rt = fallocate(m_fd, 0, offset, m_chunkSize);
+		if (rt && errno == EOPNOTSUPP) {
+			rt = posix_fallocate(m_fd, offset, m_chunkSize);
+		}
+		void* addr = rt ? MAP_FAILED
+			: mmap(nullptr, m_chunkSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, offset);
+		if (addr == MAP_FAILED) {
+			int err = errno;
+			lock.unlock();
+			/// 短暂失败时重试几次, 已经处于失败状态时不再等待
+			if (++failures < 3 && !m_mapError) {
+				usleep(1000);
+				continue;
+			}
+			/// 连续失败只报告一次
+			if (!m_mapError.exchange(true)) {
+				std::cout << "MmapFileLogAppender map error file=" << m_filename
+					<< " errno=" << err << ", logs are dropped until mapping succeeds" << std::endl;
+			}
+			return nullptr;
+		}
+		m_mapError = false;
+		chunk.addr = (char*)addr;
+		/// 打开时所在的块已经有数据, 之前映射失败丢失的部分也算作已写入
+		chunk.written = no == m_start / m_chunkSize ? m_start % m_chunkSize : 0;
+		auto it = m_lost.find(no);
+		if (it != m_lost.end()) {
+			chunk.written += it->second;
+			m_lost.erase(it);
+		}
+		chunk.no.store(no + 1, std::memory_order_release);
+		return chunk.addr;
+	}
+}
+
+void MmapFileLogAppender::commit(uint64_t no, size_t len) {
+	Chunk& chunk = m_chunks[no % s_ring];
+	if (chunk.written.fetch_add(len, std::memory_order_acq_rel) + len == m_chunkSize) {
+		Mutex::Lock lock(m_mapMutex);
+		unmap(chunk);
+	}
+}
+
+void MmapFileLogAppender::lose(uint64_t no, size_t len) {
+	Chunk& chunk = m_chunks[no % s_ring];
+	Mutex::Lock lock(m_mapMutex);
+	if (chunk.no.load(std::memory_order_relaxed) == no + 1) {
+		/// 其他线程已经映射成功
+		lock.unlock();
+		commit(no, len);
+		return;
+	}
+	uint64_t& lost = m_lost[no];
+	lost += len;
+	uint64_t base = no == m_start / m_chunkSize ? m_start % m_chunkSize : 0;
+	if (base + lost == m_chunkSize) {
+		/// 整块都没有写入, 不会再被映射
+		m_lost.erase(no);
+	}
+}
+
+void MmapFileLogAppender::unmap(Chunk& chunk) {
+	msync(chunk.addr, m_chunkSize, MS_ASYNC);
+	madvise(chunk.addr, m_chunkSize, MADV_DONTNEED);
+	munmap(chunk.addr, m_chunkSize);
+	chunk.addr = nullptr;
+	chunk.no.store(0, std::memory_order_release);
+}
+
+void MmapFileLogAppender::append(Logger& logger, LogLevel::Level level, const LogEvent& event) {
+	if (level < m_level || m_fd < 0) {
+		return;
+	}
+	/// 每个线程缓存最近使用的格式器, 格式器未更换时不需要加锁
+	struct Cache {
+		uint64_t id = 0;
+		uint32_t version = 0;
+		LogFormatter::ptr formatter;
+		std::string buf;
+	};
+	static thread_local Cache t_cache;
+	uint32_t version = m_formatterVersion;
+	if (t_cache.id != m_id || t_cache.version != version || !t_cache.formatter) {
+		MutexType::Lock lock(m_mutex);
+		t_cache.formatter = m_formatter;
+		t_cache.id = m_id;
+		t_cache.version = version;
+	}
+	LogSampleTimer timer;
+	t_cache.buf.clear();
+	t_cache.formatter->format(t_cache.buf, level, event);
+	countEvent(t_cache.buf.size(), timer.lap());
+
+	const char* data = t_cache.buf.data();
+	size_t len = t_cache.buf.size();
+	uint64_t pos = m_cursor.fetch_add(len, std::memory_order_relaxed);
+	bool lost = false;
+	while (len > 0) {
+		uint64_t no = pos / m_chunkSize;
+		size_t off = pos % m_chunkSize;
+		size_t n = std::min(len, m_chunkSize - off);
+		char* addr = acquire(no);
+		if (addr) {
+			memcpy(addr + off, data, n);
+			commit(no, n);
+		} else {
+			/// 已预留的位置在文件中留空, 计为丢弃
+			lose(no, n);
+			lost = true;
+		}
+		data += n;
+		pos += n;
+		len -= n;
+	}
+	if (lost) {
+		addCounter(DROPPED);
+	}
+	if (uint64_t ns = timer.lap()) {
+		addCounter(WRITE_NS, ns);
+	}
+}
+
+void MmapFileLogAppender::flush() {
+	Mutex::Lock lock(m_mapMutex);
+	for (auto& i : m_chunks) {
+		if (i.no) {
+			msync(i.addr, m_chunkSize, MS_ASYNC);
+		}
+	}
+}
+
+std::string MmapFileLogAppender::toYamlString() {
+	MutexType::Lock lock(m_mutex);
+	YAML::Node node;
+	node["type"] = "MmapFileLogAppender";
+	node["file"] = m_filename;
+	node["chunk_size"] = m_chunkSize;
+	if (m_level != LogLevel::UNKNOW) {
+		node["level"] = LogLevel::ToString(m_level);
+	}
+	if (m_hasFormatter && m_formatter) {
+		node["formatter"] = m_formatter->getPattern();
+	}
+	std::stringstream ss;
+	ss << node;
+	return ss.str();
+}
+
+/// 飞行记录器每个槽位的大小
+static const size_t s_flight_slot_size = 256;
+
+/**
+* @brief 飞行记录器的一个槽位
+*/
+struct FlightSlot {
+	/// 写入完成后的序号, 0表示空或正在写入
+	std::atomic<uint64_t> seq;
+	uint64_t time;
+	uint32_t usec;
+	uint32_t thread_id;
+	uint32_t fiber_id;
+	int32_t line;
+	const char* file;
+	uint8_t level;
+	uint8_t truncated;
+	uint16_t len;
+	char logger[20];
+	char text[s_flight_slot_size - 64];
+};
+
+/**
+* @brief 一个线程的环形缓冲区, 只增不删, 线程退出后保留内容直到被新线程复用
+*/
+struct FlightRing {
+	FlightRing* next = nullptr;
+	std::atomic<bool> used{true};
+	uint32_t thread_id = 0;
+	char thread_name[16] = {0};
+	size_t capacity = 0;
+	/// 已写入的条数, 只由所属线程修改, 转储时由其他线程读取
+	std::atomic<uint64_t> head{0};
+	FlightSlot* slots = nullptr;
+};
+
+static std::atomic<FlightRing*> s_flight_rings{nullptr};
+static std::atomic<size_t> s_flight_capacity{1024};
+/// 信号处理函数中使用, 不能是std::string
+static char s_flight_file[4096] = {0};
+
+static void CopyName(char* dst, size_t size, const std::string& src) {
+	size_t n = std::min(size - 1, src.size());
+	memcpy(dst, src.data(), n);
+	dst[n] = 0;
+}
+
+static FlightRing* AcquireFlightRing() {
+	size_t capacity = s_flight_capacity;
+	for (FlightRing* r = s_flight_rings.load(); r; r = r->next) {
+		bool expect = false;
+		if (r->capacity == capacity && !r->used.load(std::memory_order_relaxed)
+				&& r->used.compare_exchange_strong(expect, true)) {
+			return r;
+		}
+	}
+	FlightRing* r = new FlightRing;
+	r->capacity = capacity;
+	r->slots = (FlightSlot*)calloc(capacity, sizeof(FlightSlot));
+	r->next = s_flight_rings.load();
+	while (!s_flight_rings.compare_exchange_weak(r->next, r));
+	return r;
+}
+
+/**
+* @brief 线程退出时归还环形缓冲区
+*/
+struct FlightRingHolder {
+	FlightRing* ring = nullptr;
+	~FlightRingHolder() {
+		if (ring) {
+			ring->used.store(false);
+		}
+	}
+};
+
+void FlightRecorder::Record(LogLevel::Level level, const LogEvent& event) {
+	static thread_local FlightRingHolder t_holder;
+	FlightRing* ring = t_holder.ring;
+	if (!ring) {
+		ring = t_holder.ring = AcquireFlightRing();
+		ring->thread_id = event.getThreadId();
+		CopyName(ring->thread_name, sizeof(ring->thread_name), event.getThreadName());
+	}
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	FlightSlot& slot = ring->slots[head % ring->capacity];
+	slot.seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.time = event.getTime();
+	slot.usec = event.getUsec();
+	slot.thread_id = event.getThreadId();
+	slot.fiber_id = event.getFiberId();
+	slot.line = event.getLine();
+	slot.file = event.getFile();
+	slot.level = level;
+	CopyName(slot.logger, sizeof(slot.logger), event.getLoggerName());
+	const std::string& content = event.getContent();
+	size_t len = std::min(content.size(), sizeof(slot.text));
+	memcpy(slot.text, content.data(), len);
+	slot.len = len;
+	slot.truncated = len < content.size();
+	slot.seq.store(head + 1, std::memory_order_release);
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void FlightRecorder::SetCapacity(size_t slots) {
+	s_flight_capacity = std::max(slots, (size_t)1);
+}
+
+/**
+* @brief 信号处理中使用的输出缓冲, 不分配内存
+*/
+class SignalWriter {
+public:
+	SignalWriter(int fd) :m_fd(fd) {}
+	~SignalWriter() { flush(); }
+
+	SignalWriter& str(const char* s, size_t len) {
+		while (len > 0) {
+			if (m_len == sizeof(m_buf)) {
+				flush();
+			}
+			size_t n = std::min(len, sizeof(m_buf) - m_len);
+			memcpy(m_buf + m_len, s, n);
+			m_len += n;
+			s += n;
+			len -= n;
+		}
+		return *this;
+	}
+
+	SignalWriter& str(const char* s) { return str(s, strlen(s)); }
+
+	SignalWriter& num(uint64_t v, int width = 0) {
+		char tmp[24];
+		int n = 0;
+		do {
+			tmp[n++] = '0' + v % 10;
+			v /= 10;
+		} while (v);
+		while (n < width) {
+			tmp[n++] = '0';
+		}
+		char out[24];
+		for (int i = 0; i < n; ++i) {
+			out[i] = tmp[n - 1 - i];
+		}
+		return str(out, n);
+	}
+
+	void flush() {
+		size_t pos = 0;
+		while (pos < m_len) {
+			ssize_t rt = write(m_fd, m_buf + pos, m_len - pos);
+			if (rt <= 0 && errno != EINTR) {
+				break;
+			}
+			pos += rt > 0 ? rt : 0;
+		}
+		m_len = 0;
+	}
+private:
+	int m_fd;
+	size_t m_len = 0;
+	char m_buf[4096];
+};
+
+void FlightRecorder::Dump(int fd) {
+	SignalWriter out(fd);
+	for (FlightRing* r = s_flight_rings.load(); r; r = r->next) {
+		out.str("=== thread ").num(r->thread_id).str(" ").str(r->thread_name)
+			.str(r->used ? "" : " (exited)").str(" ===\n");
+		uint64_t head = r->head.load(std::memory_order_acquire);
+		uint64_t begin = head > r->capacity ? head - r->capacity : 0;
+		for (uint64_t i = begin; i < head; ++i) {
+			const FlightSlot& src = r->slots[i % r->capacity];
+			/// 正在写入或已被覆盖的槽位跳过
+			if (src.seq.load(std::memory_order_acquire) != i + 1) {
+				continue;
+			}
+			/// 所属线程可能仍在写日志, 先复制到局部变量, 复制后序号不变才说明内容完整
+			FlightSlot slot;
+			slot.time = src.time;
+			slot.usec = src.usec;
+			slot.thread_id = src.thread_id;
+			slot.fiber_id = src.fiber_id;
+			slot.line = src.line;
+			slot.file = src.file;
+			slot.level = src.level;
+			slot.truncated = src.truncated;
+			slot.len = std::min((size_t)src.len, sizeof(slot.text));
+			memcpy(slot.logger, src.logger, sizeof(slot.logger));
+			slot.logger[sizeof(slot.logger) - 1] = 0;
+			memcpy(slot.text, src.text, slot.len);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (src.seq.load(std::memory_order_relaxed) != i + 1) {
+				continue;
+			}
+			out.num(slot.time).str(".").num(slot.usec, 6).str("\t")
+				.num(slot.thread_id).str("\t").num(slot.fiber_id).str("\t[")
+				.str(LogLevel::ToString((LogLevel::Level)slot.level)).str("]\t[")
+				.str(slot.logger).str("]\t").str(slot.file ? slot.file : "")
+				.str(":").num(slot.line).str("\t").str(slot.text, slot.len)
+				.str(slot.truncated ? "...\n" : "\n");
+		}
+	}
+}
+
+static void FlightSignalHandler(int sig) {
+	int fd = open(s_flight_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd >= 0) {
+		{
+			SignalWriter out(fd);
+			out.str("signal ").num(sig).str("\nbacktrace:\n");
+		}
+		void* array[64];
+		int n = backtrace(array, 64);
+		backtrace_symbols_fd(array, n, fd);
+		{
+			SignalWriter out(fd);
+			out.str("flight recorder:\n");
+		}
+		FlightRecorder::Dump(fd);
+		close(fd);
+	}
+	/// SA_RESETHAND已恢复默认处理, 重新发送信号以默认方式退出
+	raise(sig);
+}
+
+void FlightRecorder::Install(const std::string& dump_file) {
+	CopyName(s_flight_file, sizeof(s_flight_file), dump_file);
+	static bool s_installed = false;
+	if (s_installed) {
+		return;
+	}
+	s_installed = true;
+	/// backtrace第一次调用时会加载libgcc并分配内存, 提前调用一次, 信号处理中不再分配
+	void* array[1];
+	backtrace(array, 1);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = FlightSignalHandler;
+	sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+	sigemptyset(&sa.sa_mask);
+	int sigs[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+	for (int sig : sigs) {
+		sigaction(sig, &sa, nullptr);
+	}
+}
+
+FlightRecorderAppender::FlightRecorderAppender(const std::string& dump_file, size_t slots
+		,LogLevel::Level capture_level)
+	:m_file(dump_file)
+	,m_slots(slots)
+	,m_captureLevel(capture_level) {
+	FlightRecorder::SetCapacity(slots);
+	FlightRecorder::Install(dump_file);
+	Logger::AddCaptureLevel(capture_level);
+}
+
+FlightRecorderAppender::~FlightRecorderAppender() {
+	Logger::DelCaptureLevel(m_captureLevel);
+}
+
+void FlightRecorderAppender::append(Logger& logger, LogLevel::Level level, const LogEvent& event) {
+	/// 开启后Logger::log已记录了所有不低于记录级别的日志, 这里不重复记录
+}
+
+std::string FlightRecorderAppender::toYamlString() {
+	MutexType::Lock lock(m_mutex);
+	YAML::Node node;
+	node["type"] = "FlightRecorderAppender";
+	node["file"] = m_file;
+	node["slots"] = m_slots;
+	node["capture_level"] = LogLevel::ToString(m_captureLevel);
+	std::stringstream ss;
+	ss << node;
+	return ss.str();
+}
+
+/**
+ * @brief 解析UDP地址"host:port"或"[v6]:port", 失败返回false
+ */
+static bool ResolveUdpAddress(const std::string& address, sockaddr_storage& addr, socklen_t& len) {
+	size_t pos = address.rfind(':');
+	if (pos == std::string::npos || pos == 0) {
+		return false;
+	}
+	std::string host = address.substr(0, pos);
+	std::string port = address.substr(pos + 1);
+	if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+		host = host.substr(1, host.size() - 2);
+	}
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_flags = AI_NUMERICSERV;
+	struct addrinfo* res = nullptr;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) || !res) {
+		return false;
+	}
+	memcpy(&addr, res->ai_addr, res->ai_addrlen);
+	len = res->ai_addrlen;
+	freeaddrinfo(res);
+	return true;
+}
+
+DatagramLogAppender::DatagramLogAppender(int family, const std::string& address
+		,size_t batch_bytes, uint32_t flush_ms)
+	:m_address(address)
+	,m_batchBytes(std::max(batch_bytes, (size_t)1))
+	,m_flushMs(flush_ms) {
+	memset(&m_addr, 0, sizeof(m_addr));
+	if (family == AF_UNIX) {
+		struct sockaddr_un* un = (struct sockaddr_un*)&m_addr;
+		un->sun_family = AF_UNIX;
+		if (address.size() < sizeof(un->sun_path)) {
+			memcpy(un->sun_path, address.c_str(), address.size() + 1);
+			m_addrLen = offsetof(struct sockaddr_un, sun_path) + address.size() + 1;
+		}
+	} else if (!ResolveUdpAddress(address, m_addr, m_addrLen)) {
+		m_addrLen = 0;
+	}
+	if (!m_addrLen) {
+		std::cout << "DatagramLogAppender invalid address=" << address << std::endl;
+	}
+	m_packets.resize(s_maxPackets);
+	AddFlushTimer(this, m_flushMs);
+}
+
+DatagramLogAppender::~DatagramLogAppender() {
+	DelFlushTimer(this);
+	flush();
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+}
+
+bool DatagramLogAppender::connect() {
+	if (m_fd >= 0) {
+		return true;
+	}
+	uint64_t now = NowMs();
+	if (!m_addrLen || (m_retryMs && now < m_retryMs + 1000)) {
+		return false;
+	}
+	int fd = socket(m_addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd >= 0 && ::connect(fd, (struct sockaddr*)&m_addr, m_addrLen) == 0) {
+		m_fd = fd;
+		m_retryMs = 0;
+		return true;
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	m_retryMs = now;
+	return false;
+}
+
+void DatagramLogAppender::append(Logger& logger, LogLevel::Level level, const LogEvent& event) {
+	if (level < m_level) {
+		return;
+	}
+	MutexType::Lock lock(m_mutex);
+	LogSampleTimer timer;
+	m_record.clear();
+	m_formatter->format(m_record, level, event);
+	countEvent(m_record.size(), timer.lap());
+	if (!m_cur.empty() && m_cur.size() + m_record.size() > m_batchBytes) {
+		seal();
+	}
+	if (m_cur.empty() && !m_count) {
+		m_firstMs = event.getTime() * 1000 + event.getUsec() / 1000;
+	}
+	m_cur.append(m_record);
+	++m_curRecords;
+	if (m_cur.size() >= m_batchBytes) {
+		seal();
+	}
+	if (m_count == s_maxPackets) {
+		send();
+	}
+}
+
+void DatagramLogAppender::seal() {
+	if (m_count == s_maxPackets) {
+		send();
+	}
+	Packet& p = m_packets[m_count++];
+	p.data.swap(m_cur);
+	p.records = m_curRecords;
+	m_cur.clear();
+	m_curRecords = 0;
+}
+
+void DatagramLogAppender::send() {
+	size_t begin = 0;
+	while (begin < m_count) {
+		if (!connect()) {
+			break;
+		}
+		struct mmsghdr msgs[s_maxPackets];
+		struct iovec iovs[s_maxPackets];
+		size_t n = m_count - begin;
+		for (size_t i = 0; i < n; ++i) {
+			iovs[i].iov_base = &m_packets[begin + i].data[0];
+			iovs[i].iov_len = m_packets[begin + i].data.size();
+			memset(&msgs[i], 0, sizeof(msgs[i]));
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		LogSampleTimer timer(true);
+		int rt = sendmmsg(m_fd, msgs, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+		addCounter(WRITE_NS, timer.lap());
+		if (rt > 0) {
+			for (int i = 0; i < rt; ++i) {
+				m_sent += m_packets[begin + i].records;
+			}
+			begin += rt;
+			continue;
+		}
+		if (rt < 0 && errno == EINTR) {
+			continue;
+		}
+		if (rt < 0 && errno == EMSGSIZE) {
+			/// 单条日志超过数据报上限, 只丢弃这一个包
+			m_dropped += m_packets[begin].records;
+			addCounter(DROPPED, m_packets[begin++].records);
+			continue;
+		}
+		if (rt < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+			/// 接收方已关闭或不可达, 之后重新连接
+			close(m_fd);
+			m_fd = -1;
+			addCounter(REOPENS);
+			m_retryMs = NowMs();
+		}
+		break;
+	}
+	for (size_t i = begin; i < m_count; ++i) {
+		m_dropped += m_packets[i].records;
+		addCounter(DROPPED, m_packets[i].records);
+	}
+	for (size_t i = 0; i < m_count; ++i) {
+		m_packets[i].data.clear();
+		m_packets[i].records = 0;
+	}
+	m_count = 0;
 }
 
-void Logger::warn(LogEvent::ptr event) {
-	log(LogLevel::WARN, event);
-}
-
-void Logger::error(LogEvent::ptr event) {
-	log(LogLevel::ERROR, event);
-}
-
-void Logger::fatal(LogEvent::ptr event) {
-	log(LogLevel::FATAL, event);
-}
-
-FileLogAppender::FileLogAppender(const std::string & filename)
-	:m_filename(filename) {
-	reopen();
+void DatagramLogAppender::flush() {
+	MutexType::Lock lock(m_mutex);
+	if (!m_cur.empty()) {
+		seal();
+	}
+	if (m_count) {
+		send();
+	}
 }
-
-// void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event)
-void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event)
-{
-	if (level >= m_level) {
-        /// 解决文件被删除后还在 输出在已被删除的文件中的问题的解决方案
-        uint64_t now = time(0);
-        if(now != m_lastTime) {
-            reopen();
-            m_lastTime = now;
-            // std::cout << m_filename << std::endl;
-        }
-        MutexType::Lock lock(m_mutex);
-		if (!(m_formatter->format(m_filestream, logger, level, event))) {   /// 写入
-			std::cout << "error" << std::endl;
-		}
-	}
-}
-
-std::string FileLogAppender::toYamlString() {
-    MutexType::Lock lock(m_mutex);
-    YAML::Node node;
-    node["type"] = "FileLogAppender";
-    node["file"] = m_filename;
-    if(m_level != LogLevel::UNKNOW) {
-        node["level"] = LogLevel::ToString(m_level);
-    }
 
-    if(m_hasFormatter && m_formatter) {
-        node["formatter"] = m_formatter->getPattern();
-    }
-    std::stringstream ss;
-    // std::cout << "===================" << "FileLogAppender::toYamlString()" << std::endl;
-    ss << node;
-    // std::cout << "=================== finish" << std::endl;
-    return ss.str();
+void DatagramLogAppender::flushExpired(uint64_t now_ms) {
+	MutexType::Lock lock(m_mutex);
+	if ((m_cur.empty() && !m_count) || now_ms < m_firstMs + m_flushMs) {
+		return;
+	}
+	if (!m_cur.empty()) {
+		seal();
+	}
+	send();
 }
-
-bool FileLogAppender::reopen()
-{
-    MutexType::Lock lock(m_mutex);
-	/**
-	*	m_filestream -- 文件流
-	*	ofstream -- 写文件 / 不能读
-	*   ifstream -- 读文件 / 不能写
-	*   ostream 是 ofstream 的基类, ofstream专门处理文件流
-	*/
-	if (m_filestream) {	// 文件流
-		m_filestream.close();
-	}
-
-	m_filestream.open(m_filename, std::ios::app);
-	if (!m_filestream)
-		std::cout << "!!!! open error !!!!" << std::endl;
-
-	return !!m_filestream;
-}
 
-// void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event)
-void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event)
-{
-	// m_level 初始化为 LogLevel::DEBUG
-	if (level >= m_level) {
-        MutexType::Lock lock(m_mutex);
-		m_formatter->format(std::cout, logger, level, event);
-	}
+std::string DatagramLogAppender::buildYaml(const char* type) {
+	MutexType::Lock lock(m_mutex);
+	YAML::Node node;
+	node["type"] = type;
+	node["address"] = m_address;
+	node["batch_bytes"] = m_batchBytes;
+	node["flush_ms"] = m_flushMs;
+	if (m_level != LogLevel::UNKNOW) {
+		node["level"] = LogLevel::ToString(m_level);
+	}
+	if (m_hasFormatter && m_formatter) {
+		node["formatter"] = m_formatter->getPattern();
+	}
+	std::stringstream ss;
+	ss << node;
+	return ss.str();
 }
 
-std::string StdoutLogAppender::toYamlString() {
-    MutexType::Lock lock(m_mutex);
-    YAML::Node node;
-    node["type"] = "StdoutLogAppender";
-    if(m_level != LogLevel::UNKNOW) {
-        node["level"] = LogLevel::ToString(m_level);
-    }
+UdpLogAppender::UdpLogAppender(const std::string& address, size_t batch_bytes, uint32_t flush_ms)
+	:DatagramLogAppender(AF_UNSPEC, address, batch_bytes, flush_ms) {
+}
 
-    if(m_hasFormatter && m_formatter) {
-        node["formatter"] = m_formatter->getPattern();
-    }
-    std::stringstream ss;
-    // std::cout << "===================" << "StdoutLogAppender::toYamlString()" << std::endl;
-    ss << node;
-    // std::cout << "=================== finish" << std::endl;
-    return ss.str();
+std::string UdpLogAppender::toYamlString() {
+	return buildYaml("UdpLogAppender");
 }
-
+
+UnixSocketLogAppender::UnixSocketLogAppender(const std::string& path, size_t batch_bytes, uint32_t flush_ms)
+	:DatagramLogAppender(AF_UNIX, path, batch_bytes, flush_ms) {
+}
+
+std::string UnixSocketLogAppender::toYamlString() {
+	return buildYaml("UnixSocketLogAppender");
+}
+
 LogFormatter::LogFormatter(const std::string& pattern)
 	:m_pattern(pattern) {
 	init();
 }
 
-std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level,
-	LogEvent::ptr event) {
-	std::stringstream ss;
-	for (auto& i : m_items) {
-		i->format(ss, logger, level, event);
-	}
-	return ss.str();
+std::string LogFormatter::format(const std::shared_ptr<Logger>& logger, LogLevel::Level level,
+	const LogEvent::ptr& event) {
+	std::string str;
+	format(str, level, *event);
+	return str;
 }
 
-std::ostream& LogFormatter::format(std::ostream & ofs, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event)
+std::ostream& LogFormatter::format(std::ostream & ofs, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event)
+{
+	return format(ofs, level, *event);
+}
+
+std::ostream& LogFormatter::format(std::ostream& ofs, LogLevel::Level level, const LogEvent& event)
+{
+	static thread_local char t_buf[4096];
+	size_t len = format(t_buf, sizeof(t_buf), level, event);
+	if (len <= sizeof(t_buf)) {
+		ofs.write(t_buf, len);
+	} else {
+		std::string str;
+		format(str, level, event);
+		ofs.write(str.data(), str.size());
+	}
+	/// 保持与NewLineFormatItem(std::endl)相同的刷新行为
+	if (len && m_flush) {
+		ofs.flush();
+	}
+	return ofs;
+}
+
+std::ostream& LogFormatter::formatItems(std::ostream & ofs, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event)
 {
 	for (auto& i : m_items) {
 		i->format(ofs, logger, level, event); // 调用子类的format 方法
@@ -536,11 +3674,132 @@ std::ostream& LogFormatter::format(std::ostream & ofs, std::shared_ptr<Logger> l
 	return ofs;
 }
 
+void LogFormatter::format(std::string& out, LogLevel::Level level, const LogEvent& event) {
+	size_t old = out.size();
+	/// resize会填充新增的部分, 大缓冲区中只预留一段, 不够时按实际长度再格式化一次
+	size_t avail = std::min(std::max(out.capacity() - old, (size_t)256), (size_t)1024);
+	out.resize(old + avail);
+	size_t len = format(&out[old], avail, level, event);
+	if (len > avail) {
+		out.resize(old + len);
+		format(&out[old], len, level, event);
+	}
+	out.resize(old + len);
+}
+
+/**
+ * @brief 无符号整数转十进制文本, 写到buf的末尾
+ * @return 文本的起始位置
+ */
+static char* UIntToText(uint64_t v, char* end) {
+	static const char s_digits[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+	char* p = end;
+	while (v >= 100) {
+		unsigned idx = (v % 100) * 2;
+		v /= 100;
+		*--p = s_digits[idx + 1];
+		*--p = s_digits[idx];
+	}
+	if (v >= 10) {
+		unsigned idx = v * 2;
+		*--p = s_digits[idx + 1];
+		*--p = s_digits[idx];
+	} else {
+		*--p = '0' + v;
+	}
+	return p;
+}
+
+size_t LogFormatter::format(char* buf, size_t size, LogLevel::Level level, const LogEvent& event) {
+	size_t pos = 0;
+	/// 写入时按剩余空间截断, pos始终累加完整长度
+	auto put = [buf, size, &pos](const char* str, size_t len) {
+		if (pos < size) {
+			memcpy(buf + pos, str, std::min(len, size - pos));
+		}
+		pos += len;
+	};
+
+	for (auto& op : m_program) {
+		switch (op.code) {
+		case OP_LITERAL:
+			put(m_literals.data() + op.arg, op.len);
+			break;
+		case OP_MESSAGE:
+			PutMessage(put, event);
+			break;
+		case OP_JSON:
+			PutJson(put, *m_dateFormats[op.arg], level, event);
+			break;
+		case OP_MDC:
+			PutMDC(put, event, m_literals.data() + op.arg, op.len);
+			break;
+		case OP_LEVEL: {
+			const char* str = LogLevel::ToString(level);
+			put(str, strlen(str));
+			break;
+		}
+		case OP_ELAPSE:
+			PutInt(put, event.getElapse());
+			break;
+		case OP_NAME: {
+			const std::string& name = event.getLoggerName();
+			put(name.data(), name.size());
+			break;
+		}
+		case OP_THREAD_ID:
+			PutInt(put, event.getThreadId());
+			break;
+		case OP_FIBER_ID:
+			PutInt(put, event.getFiberId());
+			break;
+		case OP_THREAD_NAME: {
+			const std::string& name = event.getThreadName();
+			put(name.data(), name.size());
+			break;
+		}
+		case OP_DATETIME: {
+			char tmp[LogDateFormat::s_max_size];
+			put(tmp, m_dateFormats[op.arg]->format(tmp, event.getTime(), event.getUsec()));
+			break;
+		}
+		case OP_FILENAME: {
+			const char* file = event.getFile();
+			put(file, strlen(file));
+			break;
+		}
+		case OP_LINE:
+			PutInt(put, event.getLine());
+			break;
+		default:
+			break;
+		}
+	}
+	return pos;
+}
+
 /**
 * @brief 初始化,解析日志模板
 * %d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n
 */
 void LogFormatter::init() {
+	m_items.clear();
+	m_program.clear();
+	m_literals.clear();
+	m_dateFormats.clear();
+	m_flush = false;
+	m_error = false;
+
 	/// 格式 %xxx %xxx{xxx} %%
 	/// string, format, type
 	std::vector<std::tuple<std::string, std::string, int> > vec;
@@ -625,44 +3884,100 @@ void LogFormatter::init() {
 	}
 
 
-	static std::map<std::string, std::function<FormatItem::ptr(const std::string& str)> > s_format_items = {
-#define XX(str, c) \
-		{ #str, [](const std::string& fmt) { return FormatItem::ptr(new c(fmt)); }}
-
-		XX(m, MessageFormatItem),           //m:消息
-		XX(p, LevelFormatItem),             //p:日志级别
-		XX(r, ElapseFormatItem),            //r:累计毫秒数
-		XX(c, NameFormatItem),              //c:日志名称
-		XX(t, ThreadIdFormatItem),          //t:线程id
-		XX(n, NewLineFormatItem),           //n:换行
-		XX(d, DateTimeFormatItem),          //d:时间
-		XX(f, FilenameFormatItem),          //f:文件名
-		XX(l, LineFormatItem),              //l:行号
-		XX(T, TabFormatItem),               //T:Tab
-		XX(F, FiberIdFormatItem),           //F:协程id
-		XX(N, ThreadNameFormatItem),        //N:线程名称
+	/// 格式项及对应的指令
+	static std::map<std::string, std::pair<std::function<FormatItem::ptr(const std::string& str)>, int> > s_format_items = {
+#define XX(str, c, op) \
+		{ #str, std::make_pair([](const std::string& fmt) { return FormatItem::ptr(new c(fmt)); }, (int)op)}
 
+		XX(m, MessageFormatItem, OP_MESSAGE),           //m:消息
+		XX(p, LevelFormatItem, OP_LEVEL),               //p:日志级别
+		XX(r, ElapseFormatItem, OP_ELAPSE),             //r:累计毫秒数
+		XX(c, NameFormatItem, OP_NAME),                 //c:日志名称
+		XX(t, ThreadIdFormatItem, OP_THREAD_ID),        //t:线程id
+		XX(n, NewLineFormatItem, OP_NEWLINE),           //n:换行
+		XX(d, DateTimeFormatItem, OP_DATETIME),         //d:时间
+		XX(f, FilenameFormatItem, OP_FILENAME),         //f:文件名
+		XX(l, LineFormatItem, OP_LINE),                 //l:行号
+		XX(T, TabFormatItem, OP_TAB),                   //T:Tab
+		XX(F, FiberIdFormatItem, OP_FIBER_ID),          //F:协程id
+		XX(N, ThreadNameFormatItem, OP_THREAD_NAME),    //N:线程名称
+		XX(J, JsonFormatItem, OP_JSON),                 //J:JSON对象
+		XX(X, MDCFormatItem, OP_MDC),                   //X:日志上下文
+#undef XX
 };
 
+	/// 追加一条字面量指令, 与前一条字面量指令合并
+	auto add_literal = [this](const std::string& str) {
+		if (!m_program.empty() && m_program.back().code == OP_LITERAL) {
+			m_program.back().len += str.size();
+		} else {
+			m_program.push_back(Op{OP_LITERAL, (uint32_t)m_literals.size(), (uint32_t)str.size()});
+		}
+		m_literals.append(str);
+	};
+
 	/**
-	*	将解析放入 m_items
+	*	将解析放入 m_items, 同时编译到 m_program
 	*/
 	for (auto& i : vec) {
 		if (std::get<2>(i) == 0) {
 			m_items.push_back(FormatItem::ptr(new StringFormatItem(std::get<0>(i))));
+			add_literal(std::get<0>(i));
 		}
 		else {
 			auto it = s_format_items.find(std::get<0>(i));
 			if (it == s_format_items.end()) {
-				m_items.push_back(FormatItem::ptr(new StringFormatItem("<<error_format %" + std::get<0>(i) + ">>")));
+				std::string err = "<<error_format %" + std::get<0>(i) + ">>";
+				m_items.push_back(FormatItem::ptr(new StringFormatItem(err)));
+				add_literal(err);
 				m_error = true;
 			}
 			else {
-				m_items.push_back(it->second(std::get<1>(i)));
+				m_items.push_back(it->second.first(std::get<1>(i)));
+				switch (it->second.second) {
+				case OP_NEWLINE:
+					add_literal("\n");
+					m_flush = true;
+					break;
+				case OP_TAB:
+					add_literal("\t");
+					break;
+				case OP_DATETIME:
+					m_program.push_back(Op{OP_DATETIME, (uint32_t)m_dateFormats.size(), 0});
+					m_dateFormats.push_back(std::make_shared<LogDateFormat>(
+								std::get<1>(i).empty() ? "%Y-%m-%d %H:%M:%S" : std::get<1>(i)));
+					break;
+				case OP_MDC:
+					/// 键保存在字面量之后, 不参与字面量指令的合并
+					m_program.push_back(Op{OP_MDC, (uint32_t)m_literals.size(), (uint32_t)std::get<1>(i).size()});
+					m_literals.append(std::get<1>(i));
+					break;
+				case OP_JSON:
+					m_program.push_back(Op{OP_JSON, (uint32_t)m_dateFormats.size(), 0});
+					m_dateFormats.push_back(std::make_shared<LogDateFormat>(
+								std::get<1>(i).empty() ? s_json_date_format : std::get<1>(i)));
+					break;
+				default:
+					m_program.push_back(Op{(uint32_t)it->second.second, 0, 0});
+					break;
+				}
 			}
 		}
 		 // std::cout << "(" << std::get<0>(i) << ") - (" << std::get<1>(i) << ") - (" << std::get<2>(i) << ")" << std::endl;
 	}
+}
+
+/**
+ * @brief 由日志器容器生成只读的查找表, 值指向容器中的元素
+ */
+typedef std::unordered_map<std::string, const Logger::ptr*> LoggerIndex;
+
+static LoggerIndex* BuildLoggerIndex(const std::map<std::string, Logger::ptr>& loggers) {
+	LoggerIndex* index = new LoggerIndex(loggers.size());
+	for (auto& i : loggers) {
+		(*index)[i.first] = &i.second;
+	}
+	return index;
 }
 
 LoggerManager::LoggerManager() {
@@ -677,13 +3992,26 @@ LoggerManager::LoggerManager() {
 	 *    Logger的友元类 -> LoggerManager
 	 */
 	m_loggers[m_root->m_name] = m_root;
+	m_snapshot = BuildLoggerIndex(m_loggers);
 	// std::cout << "m_root->name :" << m_root->m_name << std::endl;
 
 	init();
 }
 
-Logger::ptr LoggerManager::getLogger(const std::string& name)
+const Logger::ptr& LoggerManager::getLogger(const std::string& name)
 {
+	{
+		/// 已存在的日志器在只读快照中无锁查找
+		RcuReadLock rcu;
+		const LoggerIndex* loggers = m_snapshot.load(std::memory_order_acquire);
+		if (loggers) {
+			auto it = loggers->find(name);
+			if (it != loggers->end()) {
+				return *it->second;
+			}
+		}
+	}
+
     MutexType::Lock lock(m_mutex);
     /// m_loggers : std::map<std::string, Logger::ptr> m_loggers; // 日志器容器
 	auto it = m_loggers.find(name);
@@ -691,37 +4019,140 @@ Logger::ptr LoggerManager::getLogger(const std::string& name)
 		return it->second;  /* return logger;*/
 	}
 
-	/// 如果m_loggers不存在， 那么我们创建一个新的Logger
+	/// 如果m_loggers不存在， 那么我们创建一个新的Logger, 级别继承上级日志器
 	Logger::ptr logger(new Logger(name));
-	logger->m_root = m_root;
-	m_loggers[name] = logger;
-	return logger;
+	logger->m_level = LogLevel::UNKNOW;
+
+	/// 上级日志器为最近的已存在的点分前缀, 如 a.b.c 依次查找 a.b, a; 都不存在时为 root
+	Logger::ptr parent = m_root;
+	for (size_t pos = name.rfind('.'); pos != std::string::npos && pos > 0;
+			pos = name.rfind('.', pos - 1)) {
+		auto pit = m_loggers.find(name.substr(0, pos));
+		if (pit != m_loggers.end()) {
+			parent = pit->second;
+			break;
+		}
+	}
+
+	{
+		Mutex::Lock rlock(GetLoggerRegistry().mutex);
+		logger->m_parent = parent;
+		/// 原来挂在更上层的下级日志器改为挂在新日志器下
+		std::string prefix = name + ".";
+		for (auto i = m_loggers.lower_bound(prefix);
+				i != m_loggers.end() && i->first.compare(0, prefix.size(), prefix) == 0; ++i) {
+			Logger::ptr& p = i->second->m_parent;
+			if (p == m_root || p->m_name.size() < name.size()) {
+				p = logger;
+			}
+		}
+		Logger::RefreshAll(true);
+	}
+
+	/// std::map的元素地址在插入后保持不变, 且日志器不会被删除
+	Logger::ptr& ref = m_loggers[name];
+	ref = logger;
+	const LoggerIndex* old = m_snapshot.exchange(BuildLoggerIndex(m_loggers));
+	lock.unlock();
+	Rcu::Retire(const_cast<LoggerIndex*>(old));
+	return ref;
+}
+
+std::vector<Logger::ptr> LoggerManager::getLoggers()
+{
+    std::vector<Logger::ptr> loggers;
+    MutexType::Lock lock(m_mutex);
+    for(auto& i : m_loggers) {
+        loggers.push_back(i.second);
+    }
+    return loggers;
+}
+
+void LoggerManager::flush()
+{
+    for(auto& i : getLoggers()) {
+        i->flush();
+    }
 }
 
 struct LogAppenderDefine {
-    int type = 0; /// 1 - FileLogAppender  2 - StdoutLogAppender
+    int type = 0; /// 1 - FileLogAppender  2 - StdoutLogAppender  3 - AsyncFileLogAppender  4 - BinaryFileLogAppender  5 - MmapFileLogAppender  6 - FlightRecorderAppender  7 - UdpLogAppender  8 - UnixSocketLogAppender
     LogLevel::Level level = LogLevel::UNKNOW;
     std::string formatter;
     std::string file;
+    /// AsyncFileLogAppender 队列容量
+    uint32_t capacity = 8192;
+    /// AsyncFileLogAppender 队列满时的处理策略
+    std::string overflow;
+    /// FileLogAppender 切分策略
+    uint64_t max_size = 0;
+    std::string rotate;
+    uint32_t max_files = 0;
+    bool compress = false;
+    /// FileLogAppender 线程缓冲大小及最长停留时间(毫秒)
+    uint64_t buffer_size = 0;
+    uint32_t flush_interval = 100;
+    /// MmapFileLogAppender 每次映射的大小
+    uint64_t chunk_size = 64 * 1024 * 1024;
+    /// FlightRecorderAppender 每个线程保存的条数及记录的最低级别
+    uint32_t slots = 1024;
+    LogLevel::Level capture_level = LogLevel::DEBUG;
+    /// UdpLogAppender/UnixSocketLogAppender 地址, 数据报大小(0为默认)及最长停留时间(毫秒)
+    std::string address;
+    uint64_t batch_bytes = 0;
+    uint32_t flush_ms = 100;
 
     bool operator==(const LogAppenderDefine& oth) const {
         return type == oth.type
             && level == oth.level
             && formatter == oth.formatter
-            && file == oth.file;
+            && file == oth.file
+            && capacity == oth.capacity
+            && overflow == oth.overflow
+            && max_size == oth.max_size
+            && rotate == oth.rotate
+            && max_files == oth.max_files
+            && compress == oth.compress
+            && buffer_size == oth.buffer_size
+            && flush_interval == oth.flush_interval
+            && chunk_size == oth.chunk_size
+            && slots == oth.slots
+            && capture_level == oth.capture_level
+            && address == oth.address
+            && batch_bytes == oth.batch_bytes
+            && flush_ms == oth.flush_ms;
     }
 };
 
+/**
+* @brief 解析文件大小, 支持K/M/G后缀, 如 "100M"
+*/
+static uint64_t ParseSize(const std::string& str) {
+    char* end = nullptr;
+    uint64_t v = strtoull(str.c_str(), &end, 10);
+    switch(*end) {
+        case 'k': case 'K': return v << 10;
+        case 'm': case 'M': return v << 20;
+        case 'g': case 'G': return v << 30;
+        default: return v;
+    }
+}
+
 struct LogDefine {
 	std::string name;
 	LogLevel::Level level = LogLevel::UNKNOW;
     std::string formatter;
+    /// 每秒最多输出的条数及允许突发的条数, 0表示不限流
+    uint32_t rate_limit = 0;
+    uint32_t burst = 0;
     std::vector<LogAppenderDefine> appenders;
 
     bool operator==(const LogDefine& oth) const {
         return name == oth.name
             && level == oth.level
             && formatter == oth.formatter
+            && rate_limit == oth.rate_limit
+            && burst == oth.burst
             && appenders == oth.appenders;
     }
 
@@ -732,11 +4163,9 @@ struct LogDefine {
 
 
 template<> /// 模板特化
-class LexicalCast<std::string, std::set<LogDefine> > {
+class NodeCast<std::set<LogDefine> > {
 public:
-    std::set<LogDefine> operator() (const std::string& v) {
-        // std::cout << "LexicalCast partical template<>: String To Vector" << __FILE__ << " - " << __LINE__ << " - " << v << std::endl;
-        YAML::Node node = YAML::Load(v);
+    std::set<LogDefine> operator() (const YAML::Node& node) {
         std::set<LogDefine> set;
         // std::cout << "node =" << node << std::endl << "finish" << std::endl;
         /// 进入"logs" IsSequence()
@@ -754,6 +4183,11 @@ public:
             if(n["formatter"].IsDefined()) {
                 ld.formatter = n["formatter"].as<std::string>();
             }
+            if(n["rate_limit"].IsDefined()) {
+                ld.rate_limit = n["rate_limit"].as<uint32_t>();
+                /// 默认允许1秒的突发量
+                ld.burst = n["burst"].IsDefined() ? n["burst"].as<uint32_t>() : ld.rate_limit;
+            }
             /// n["appenders"] = node["log"][i]["appenders"]
             if(n["appenders"].IsDefined()) {
                 for(size_t x = 0; x < n["appenders"].size(); ++x) {
@@ -774,9 +4208,92 @@ public:
                             continue;
                         }
                         lad.file = a["file"].as<std::string>();
+                        if(a["max_size"].IsDefined()) {
+                            lad.max_size = ParseSize(a["max_size"].as<std::string>());
+                        }
+                        if(a["rotate"].IsDefined()) {
+                            lad.rotate = a["rotate"].as<std::string>();
+                        }
+                        if(a["max_files"].IsDefined()) {
+                            lad.max_files = a["max_files"].as<uint32_t>();
+                        }
+                        if(a["compress"].IsDefined()) {
+                            lad.compress = a["compress"].as<bool>();
+                        }
+                        if(a["buffer_size"].IsDefined()) {
+                            lad.buffer_size = ParseSize(a["buffer_size"].as<std::string>());
+                        }
+                        if(a["flush_interval"].IsDefined()) {
+                            lad.flush_interval = a["flush_interval"].as<uint32_t>();
+                        }
+                        if(a["formatter"].IsDefined()) {
+                            lad.formatter = a["formatter"].as<std::string>();
+                        }
+                    }else if(type == "AsyncFileLogAppender") {
+                        lad.type = 3;
+                        if(!a["file"].IsDefined()) {
+                            std::cout << "log config error: asyncfileappender file is null, " << a << std::endl;
+                            continue;
+                        }
+                        lad.file = a["file"].as<std::string>();
+                        if(a["capacity"].IsDefined()) {
+                            lad.capacity = a["capacity"].as<uint32_t>();
+                        }
+                        if(a["overflow"].IsDefined()) {
+                            lad.overflow = a["overflow"].as<std::string>();
+                        }
+                        if(a["formatter"].IsDefined()) {
+                            lad.formatter = a["formatter"].as<std::string>();
+                        }
+                    }else if(type == "MmapFileLogAppender") {
+                        lad.type = 5;
+                        if(!a["file"].IsDefined()) {
+                            std::cout << "log config error: mmapfileappender file is null, " << a << std::endl;
+                            continue;
+                        }
+                        lad.file = a["file"].as<std::string>();
+                        if(a["chunk_size"].IsDefined()) {
+                            lad.chunk_size = ParseSize(a["chunk_size"].as<std::string>());
+                        }
+                        if(a["formatter"].IsDefined()) {
+                            lad.formatter = a["formatter"].as<std::string>();
+                        }
+                    }else if(type == "UdpLogAppender" || type == "UnixSocketLogAppender") {
+                        lad.type = type == "UdpLogAppender" ? 7 : 8;
+                        if(!a["address"].IsDefined()) {
+                            std::cout << "log config error: " << type << " address is null, " << a << std::endl;
+                            continue;
+                        }
+                        lad.address = a["address"].as<std::string>();
+                        if(a["batch_bytes"].IsDefined()) {
+                            lad.batch_bytes = ParseSize(a["batch_bytes"].as<std::string>());
+                        }
+                        if(a["flush_ms"].IsDefined()) {
+                            lad.flush_ms = a["flush_ms"].as<uint32_t>();
+                        }
                         if(a["formatter"].IsDefined()) {
                             lad.formatter = a["formatter"].as<std::string>();
                         }
+                    }else if(type == "FlightRecorderAppender") {
+                        lad.type = 6;
+                        if(!a["file"].IsDefined()) {
+                            std::cout << "log config error: flightrecorderappender file is null, " << a << std::endl;
+                            continue;
+                        }
+                        lad.file = a["file"].as<std::string>();
+                        if(a["slots"].IsDefined()) {
+                            lad.slots = a["slots"].as<uint32_t>();
+                        }
+                        if(a["capture_level"].IsDefined()) {
+                            lad.capture_level = LogLevel::FromString(a["capture_level"].as<std::string>());
+                        }
+                    }else if(type == "BinaryFileLogAppender") {
+                        lad.type = 4;
+                        if(!a["file"].IsDefined()) {
+                            std::cout << "log config error: binaryfileappender file is null, " << a << std::endl;
+                            continue;
+                        }
+                        lad.file = a["file"].as<std::string>();
                     }else if(type == "StdoutLogAppender") {
                         lad.type = 2;
                         if(a["formatter"].IsDefined()) {
@@ -798,6 +4315,14 @@ public:
     }
 };
 
+template<> /// 模板特化
+class LexicalCast<std::string, std::set<LogDefine> > {
+public:
+    std::set<LogDefine> operator() (const std::string& v) {
+        return NodeCast<std::set<LogDefine> >()(YAML::Load(v));
+    }
+};
+
 /**
  *  @brief 对vector容器的偏特化，vector类型转换成string类型
  */
@@ -816,16 +4341,67 @@ public:
             if(i.formatter.empty()) {
                 n["formatter"] = i.formatter;
             }
+            if(i.rate_limit) {
+                n["rate_limit"] = i.rate_limit;
+                n["burst"] = i.burst;
+            }
 
             for(auto& a : i.appenders) {
                 YAML::Node na;
                 if(a.type == 1) {
                    na["type"] = "FileLogAppender";
                    na["file"] = a.file;
+                   if(a.max_size) {
+                       na["max_size"] = a.max_size;
+                   }
+                   if(!a.rotate.empty()) {
+                       na["rotate"] = a.rotate;
+                   }
+                   if(a.max_files) {
+                       na["max_files"] = a.max_files;
+                   }
+                   if(a.compress) {
+                       na["compress"] = true;
+                   }
+                   if(a.buffer_size) {
+                       na["buffer_size"] = a.buffer_size;
+                       na["flush_interval"] = a.flush_interval;
+                   }
                 }
                 else if(a.type == 2) {
                     na["type"] = "StdoutLogAppender";
                 }
+                else if(a.type == 3) {
+                    na["type"] = "AsyncFileLogAppender";
+                    na["file"] = a.file;
+                    na["capacity"] = a.capacity;
+                    if(!a.overflow.empty()) {
+                        na["overflow"] = a.overflow;
+                    }
+                }
+                else if(a.type == 4) {
+                    na["type"] = "BinaryFileLogAppender";
+                    na["file"] = a.file;
+                }
+                else if(a.type == 5) {
+                    na["type"] = "MmapFileLogAppender";
+                    na["file"] = a.file;
+                    na["chunk_size"] = a.chunk_size;
+                }
+                else if(a.type == 6) {
+                    na["type"] = "FlightRecorderAppender";
+                    na["file"] = a.file;
+                    na["slots"] = a.slots;
+                    na["capture_level"] = LogLevel::ToString(a.capture_level);
+                }
+                else if(a.type == 7 || a.type == 8) {
+                    na["type"] = a.type == 7 ? "UdpLogAppender" : "UnixSocketLogAppender";
+                    na["address"] = a.address;
+                    if(a.batch_bytes) {
+                        na["batch_bytes"] = a.batch_bytes;
+                    }
+                    na["flush_ms"] = a.flush_ms;
+                }
 
                 if(a.level != LogLevel::UNKNOW) {
                     na["level"] = LogLevel::ToString(a.level);
@@ -873,27 +4449,53 @@ public:
                         logger = LOG_NAME(i.name);
                     }
                     else {
-                        if(!(i == *it)) {
-                            /// 修改的logger
-                           logger = LOG_NAME(i.name);
-                           // logger->setFormatter(i.formatter);
+                        if(i == *it) {
+                            /// 没有变化的logger
+                            continue;
                         }
+                        /// 修改的logger
+                        logger = LOG_NAME(i.name);
+                        // logger->setFormatter(i.formatter);
                     }
 
                     logger->setLevel(i.level);
+                    logger->setRateLimit(i.rate_limit, i.burst);
                     if(!i.formatter.empty()){
                         logger->setFormatter(i.formatter);
                     }
 
-                        /// 清除appenders
-                    logger->clearAppenders();
-                        /// 添加新的appenders
+                        /// 构造新的appenders, 最后一次性替换, 写日志的线程不会看到空列表
+                    std::list<LogAppender::ptr> appenders;
                     for(auto& a : i.appenders){
                         ipmsg::LogAppender::ptr ap;
                         if(a.type == 1) {
-                            ap.reset(new FileLogAppender(a.file));
+                            FileLogAppender::RotatePolicy policy;
+                            policy.max_size = a.max_size;
+                            policy.mode = FileLogAppender::RotateModeFromString(a.rotate);
+                            policy.max_files = a.max_files;
+                            policy.compress = a.compress;
+                            FileLogAppender::ptr fap(new FileLogAppender(a.file, policy));
+                            if(a.buffer_size) {
+                                fap->setBuffer(a.buffer_size, a.flush_interval);
+                            }
+                            ap = fap;
                         }else if(a.type == 2) {
                             ap.reset(new StdoutLogAppender);
+                        }else if(a.type == 3) {
+                            ap.reset(new AsyncLogAppender(a.file, a.capacity
+                                        ,AsyncLogAppender::PolicyFromString(a.overflow)));
+                        }else if(a.type == 4) {
+                            ap.reset(new BinaryFileLogAppender(a.file));
+                        }else if(a.type == 5) {
+                            ap.reset(new MmapFileLogAppender(a.file, a.chunk_size));
+                        }else if(a.type == 6) {
+                            ap.reset(new FlightRecorderAppender(a.file, a.slots, a.capture_level));
+                        }else if(a.type == 7) {
+                            ap.reset(new UdpLogAppender(a.address, a.batch_bytes ? a.batch_bytes
+                                        : UdpLogAppender::DEFAULT_BATCH_BYTES, a.flush_ms));
+                        }else if(a.type == 8) {
+                            ap.reset(new UnixSocketLogAppender(a.address, a.batch_bytes ? a.batch_bytes
+                                        : UnixSocketLogAppender::DEFAULT_BATCH_BYTES, a.flush_ms));
                         }
 
                         ap->setLevel(a.level);
@@ -905,15 +4507,16 @@ public:
                                 std::cout << std::endl << __FILE__ << __LINE__ << std::endl << "log.name" << i.name << " appender type = " << a.type << " formatter = " << a.formatter << "is invaild" << std::endl;
                             }
                         }
-                        logger->addAppender(ap);
+                        appenders.push_back(ap);
                     }
+                    logger->setAppenders(appenders);
 
                 }
 
                 /// 删除 -- new value 里有, old_value里也有
                 for(auto &i : old_value) {
                     auto it = new_value.find(i);
-                    if(it == old_value.end()) {
+                    if(it == new_value.end()) {
                         /// 删除logger
                         auto logger = LOG_NAME(i.name);
                         logger->setLevel((LogLevel::Level)100);
@@ -942,5 +4545,184 @@ std::string LoggerManager::toYamlString() {
     return ss.str();
 }
 
+/**
+ * @brief 一个日志器的统计数据
+ */
+struct LoggerMetrics {
+    std::string name;
+    Logger::Metrics metrics;
+    /// 日志目标的类型名及统计数据
+    std::vector<std::pair<std::string, LogAppender::Metrics> > appenders;
+};
+
+/**
+ * @brief 返回日志目标的类名(不含命名空间), 自定义的日志目标同样适用
+ */
+static std::string AppenderTypeName(const LogAppender& appender) {
+    const char* name = typeid(appender).name();
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    std::string str = status == 0 && demangled ? demangled : name;
+    free(demangled);
+    size_t pos = str.rfind("::");
+    return pos == std::string::npos ? str : str.substr(pos + 2);
+}
+
+static std::vector<LoggerMetrics> CollectMetrics(const std::vector<Logger::ptr>& loggers) {
+    std::vector<LoggerMetrics> result;
+    for(auto& i : loggers) {
+        LoggerMetrics m;
+        m.name = i->getName();
+        m.metrics = i->getMetrics();
+        for(auto& ap : i->getAppenders()) {
+            m.appenders.push_back(std::make_pair(AppenderTypeName(*ap), ap->getMetrics()));
+        }
+        result.push_back(std::move(m));
+    }
+    return result;
+}
+
+std::string LoggerManager::toMetricsYamlString() {
+    YAML::Node node;
+    for(auto& i : CollectMetrics(getLoggers())) {
+        YAML::Node n;
+        n["name"] = i.name;
+        for(int l = LogLevel::DEBUG; l <= LogLevel::FATAL; ++l) {
+            n["events"][LogLevel::ToString((LogLevel::Level)l)] = i.metrics.events[l];
+        }
+        n["throttled"] = i.metrics.throttled;
+        for(auto& ap : i.appenders) {
+            YAML::Node a;
+            a["type"] = ap.first;
+            a["events"] = ap.second.events;
+            a["bytes"] = ap.second.bytes;
+            a["format_ns"] = ap.second.format_ns;
+            a["write_ns"] = ap.second.write_ns;
+            a["dropped"] = ap.second.dropped;
+            a["reopens"] = ap.second.reopens;
+            n["appenders"].push_back(a);
+        }
+        node.push_back(n);
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+/**
+ * @brief 输出带引号的字符串, 转义JSON字符串或Prometheus标签值中的特殊字符
+ */
+static void WriteQuoted(std::ostream& os, const std::string& str) {
+    os << '"';
+    for(char c : str) {
+        switch(c) {
+            case '"': os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            default:
+                if((unsigned char)c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    os << buf;
+                } else {
+                    os << c;
+                }
+        }
+    }
+    os << '"';
+}
+
+std::string LoggerManager::toMetricsJson() {
+    std::stringstream ss;
+    ss << "{\"loggers\":[";
+    bool first = true;
+    for(auto& i : CollectMetrics(getLoggers())) {
+        ss << (first ? "" : ",") << "{\"name\":";
+        first = false;
+        WriteQuoted(ss, i.name);
+        ss << ",\"events\":{";
+        for(int l = LogLevel::DEBUG; l <= LogLevel::FATAL; ++l) {
+            ss << (l == LogLevel::DEBUG ? "" : ",") << '"' << LogLevel::ToString((LogLevel::Level)l)
+               << "\":" << i.metrics.events[l];
+        }
+        ss << "},\"throttled\":" << i.metrics.throttled << ",\"appenders\":[";
+        for(size_t j = 0; j < i.appenders.size(); ++j) {
+            const LogAppender::Metrics& m = i.appenders[j].second;
+            ss << (j ? "," : "") << "{\"type\":";
+            WriteQuoted(ss, i.appenders[j].first);
+            ss << ",\"events\":" << m.events
+               << ",\"bytes\":" << m.bytes
+               << ",\"format_ns\":" << m.format_ns
+               << ",\"write_ns\":" << m.write_ns
+               << ",\"dropped\":" << m.dropped
+               << ",\"reopens\":" << m.reopens << "}";
+        }
+        ss << "]}";
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+std::string LoggerManager::toPrometheus() {
+    std::vector<LoggerMetrics> metrics = CollectMetrics(getLoggers());
+    std::stringstream ss;
+    ss << "# HELP ipmsg_log_events_total Log events dispatched by a logger.\n"
+       << "# TYPE ipmsg_log_events_total counter\n";
+    for(auto& i : metrics) {
+        for(int l = LogLevel::DEBUG; l <= LogLevel::FATAL; ++l) {
+            ss << "ipmsg_log_events_total{logger=";
+            WriteQuoted(ss, i.name);
+            ss << ",level=\"" << LogLevel::ToString((LogLevel::Level)l) << "\"} "
+               << i.metrics.events[l] << "\n";
+        }
+    }
+    ss << "# HELP ipmsg_log_throttled_total Log events dropped by a logger's rate limit.\n"
+       << "# TYPE ipmsg_log_throttled_total counter\n";
+    for(auto& i : metrics) {
+        ss << "ipmsg_log_throttled_total{logger=";
+        WriteQuoted(ss, i.name);
+        ss << "} " << i.metrics.throttled << "\n";
+    }
+
+    /// 同一指标的样本须连续输出
+    struct Family {
+        const char* name;
+        const char* help;
+        uint64_t LogAppender::Metrics::* field;
+        /// 纳秒转换为秒
+        bool seconds;
+    };
+    static const Family s_families[] = {
+        {"ipmsg_log_appender_events_total", "Log events written by an appender.", &LogAppender::Metrics::events, false},
+        {"ipmsg_log_appender_bytes_total", "Formatted bytes written by an appender.", &LogAppender::Metrics::bytes, false},
+        {"ipmsg_log_appender_format_seconds_total", "Estimated time spent formatting (sampled).", &LogAppender::Metrics::format_ns, true},
+        {"ipmsg_log_appender_write_seconds_total", "Time spent writing.", &LogAppender::Metrics::write_ns, true},
+        {"ipmsg_log_appender_dropped_total", "Log events dropped by an appender.", &LogAppender::Metrics::dropped, false},
+        {"ipmsg_log_appender_reopens_total", "Times an appender reopened its file or connection.", &LogAppender::Metrics::reopens, false},
+    };
+    for(auto& f : s_families) {
+        ss << "# HELP " << f.name << " " << f.help << "\n"
+           << "# TYPE " << f.name << " counter\n";
+        for(auto& i : metrics) {
+            for(size_t j = 0; j < i.appenders.size(); ++j) {
+                uint64_t v = i.appenders[j].second.*f.field;
+                ss << f.name << "{logger=";
+                WriteQuoted(ss, i.name);
+                ss << ",appender=\"" << j << "\",type=";
+                WriteQuoted(ss, i.appenders[j].first);
+                ss << "} ";
+                if(f.seconds) {
+                    ss << v / 1000000000 << '.' << std::setw(9) << std::setfill('0') << v % 1000000000
+                       << std::setfill(' ');
+                } else {
+                    ss << v;
+                }
+                ss << "\n";
+            }
+        }
+    }
+    return ss.str();
+}
+
 void LoggerManager::init() {}
 }
@@ -6,8 +6,12 @@
 #include <fstream>
 #include <vector>
 #include <tuple>
+#include <type_traits>
 #include <stdarg.h>
+#include <string.h>
+#include <sys/socket.h>
 #include <map>
+#include <unordered_map>
 #include <stdint.h> // uint_64
 #include "util.h"
 #include "singleton.h"
@@ -24,14 +28,32 @@
 #ifndef __ipmsg_LOG_H__
 #define __ipmsg_LOG_H__
 
+/**
+ * @brief 编译期的最低日志级别, 低于该级别的日志语句在编译时被移除
+ * @details 取值同LogLevel::Level, 例如 -DIPMSG_LOG_MIN_LEVEL=2 移除所有DEBUG日志
+ */
+#ifndef IPMSG_LOG_MIN_LEVEL
+#define IPMSG_LOG_MIN_LEVEL 0
+#endif
+
+/**
+ * @brief 日志语句是否需要执行
+ * @details 先比较编译期常量, 低于IPMSG_LOG_MIN_LEVEL时整条语句被编译器移除;
+ *          否则只读取日志器的级别及飞行记录器的记录级别, 都未开启时不会构造日志事件,
+ *          也不会计算参数
+ */
+#define LOG_LEVEL_ENABLED(logger, level) \
+	((level) >= IPMSG_LOG_MIN_LEVEL && logger->getMinLevel() <= (level))
+
 /**
  * @brief 使用流式方式将日志级别level的日志写入到logger
+ * @details 展开为if-else, 用在不带花括号的if中时后面的else不会被吞掉
  */
 #define LOG_LEVEL(logger, level) \
-	if(logger->getLevel() <= level) \
-		 ipmsg::LogEventWrap(ipmsg::LogEvent::ptr(new ipmsg::LogEvent(logger, level,__FILE__, __LINE__, \
+	if(!LOG_LEVEL_ENABLED(logger, level)) {} else \
+		 ipmsg::LogEventWrap(ipmsg::LogEvent::Create(logger, level,__FILE__, __LINE__, \
                          0, ipmsg::GetThreadId(),	\
-                ipmsg::GetFiberId(), time(0), ipmsg::Thread::GetName()))).getSS()
+                ipmsg::GetFiberId(), time(0), ipmsg::Thread::GetName())).getSS()
 
 /**
  * @brief 使用流式方式将日志级别debug的日志写入到logger
@@ -62,9 +84,10 @@
  * @brief 使用格式化方式将日志级别level的日志写入到logger
  */
 #define LOG_FMT_LEVEL(logger, level, fmt, ...) \
-	ipmsg::LogEventWrap(ipmsg::LogEvent::ptr(new ipmsg::LogEvent( \
+	if(!LOG_LEVEL_ENABLED(logger, level)) {} else \
+	ipmsg::LogEventWrap(ipmsg::LogEvent::Create( \
 		logger, level,__FILE__, __LINE__, 0, ipmsg::GetThreadId(), \
-	ipmsg::GetFiberId(), time(0), ipmsg::Thread::GetName()))).getEvent()->format(fmt, __VA_ARGS__)
+	ipmsg::GetFiberId(), time(0), ipmsg::Thread::GetName())).getEvent()->format(fmt, __VA_ARGS__)
 
 /**
  * @brief 使用格式化方式将日志级别debug的日志写入到logger
@@ -91,6 +114,76 @@
  */
 #define LOG_FMT_FATAL(logger, fmt, ...) LOG_FMT_LEVEL(logger, ipmsg::LogLevel::FATAL, fmt, __VA_ARGS__)
 
+/**
+ * @brief 使用编译期检查的格式化方式将日志级别level的日志写入到logger
+ * @details fmt必须是字符串字面量, 转换说明的个数和类型与参数不匹配时编译失败;
+ *          参数直接格式化到日志事件的内容缓冲区, 不经过printf, 详见LogFmt
+ */
+#define LOG_FMT2_LEVEL(logger, level, fmt, ...) \
+	if(!(ipmsg::LogFmtAssert<decltype(ipmsg::LogFmt::ArgTypes(__VA_ARGS__))::Check(fmt, 0)>::value \
+			&& LOG_LEVEL_ENABLED(logger, level))) {} else \
+	ipmsg::LogEventWrap(ipmsg::LogEvent::Create( \
+		logger, level,__FILE__, __LINE__, 0, ipmsg::GetThreadId(), \
+	ipmsg::GetFiberId(), time(0), ipmsg::Thread::GetName())).getEvent()->format2(fmt, __VA_ARGS__)
+
+#define LOG_FMT2_DEBUG(logger, fmt, ...) LOG_FMT2_LEVEL(logger, ipmsg::LogLevel::DEBUG, fmt, __VA_ARGS__)
+#define LOG_FMT2_INFO(logger, fmt, ...)  LOG_FMT2_LEVEL(logger, ipmsg::LogLevel::INFO, fmt, __VA_ARGS__)
+#define LOG_FMT2_WARN(logger, fmt, ...)  LOG_FMT2_LEVEL(logger, ipmsg::LogLevel::WARN, fmt, __VA_ARGS__)
+#define LOG_FMT2_ERROR(logger, fmt, ...) LOG_FMT2_LEVEL(logger, ipmsg::LogLevel::ERROR, fmt, __VA_ARGS__)
+#define LOG_FMT2_FATAL(logger, fmt, ...) LOG_FMT2_LEVEL(logger, ipmsg::LogLevel::FATAL, fmt, __VA_ARGS__)
+
+/**
+ * @brief 当前调用位置的限流状态
+ * @details 每个lambda表达式的类型不同, 其中的静态变量即每个调用位置独有的状态;
+ *          LogSite可常量初始化, 不需要线程安全的静态初始化检查
+ */
+#define LOG_SITE() \
+	([]() -> ipmsg::LogSite& { static ipmsg::LogSite s_site; return s_site; }())
+
+/**
+ * @brief 按调用位置限流的日志, allow为LogSite的判断表达式
+ * @details allow返回0时丢弃本条日志, 否则返回值减1为上次输出后被丢弃的条数,
+ *          会以" [suppressed N]"的形式追加到本条日志的末尾
+ *          限流判断用只执行一次的for代替if, 后面的else属于调用方的if
+ */
+#define LOG_LEVEL_SITE(logger, level, allow) \
+	if(!LOG_LEVEL_ENABLED(logger, level)) {} else \
+		for(uint64_t __ipmsg_log_allow = LOG_SITE().allow; __ipmsg_log_allow; __ipmsg_log_allow = 0) \
+			ipmsg::LogEventWrap(ipmsg::LogEvent::Create(logger, level,__FILE__, __LINE__, \
+					0, ipmsg::GetThreadId(), ipmsg::GetFiberId(), time(0), \
+					ipmsg::Thread::GetName()), __ipmsg_log_allow - 1).getSS()
+
+/**
+ * @brief 每n次只输出第1次
+ */
+#define LOG_LEVEL_EVERY_N(logger, level, n) LOG_LEVEL_SITE(logger, level, everyN(n))
+
+/**
+ * @brief 每ms毫秒最多输出1次
+ */
+#define LOG_LEVEL_EVERY_MS(logger, level, ms) LOG_LEVEL_SITE(logger, level, everyMs(ms))
+
+/**
+ * @brief 令牌桶限流, 平均每秒最多rate条, 允许突发burst条
+ */
+#define LOG_LEVEL_RATE(logger, level, rate, burst) \
+	LOG_LEVEL_SITE(logger, level, tokenBucket(1000000 / (rate), burst))
+
+#define LOG_DEBUG_EVERY_N(logger, n) LOG_LEVEL_EVERY_N(logger, ipmsg::LogLevel::DEBUG, n)
+#define LOG_INFO_EVERY_N(logger, n)  LOG_LEVEL_EVERY_N(logger, ipmsg::LogLevel::INFO, n)
+#define LOG_WARN_EVERY_N(logger, n)  LOG_LEVEL_EVERY_N(logger, ipmsg::LogLevel::WARN, n)
+#define LOG_ERROR_EVERY_N(logger, n) LOG_LEVEL_EVERY_N(logger, ipmsg::LogLevel::ERROR, n)
+
+#define LOG_DEBUG_EVERY_MS(logger, ms) LOG_LEVEL_EVERY_MS(logger, ipmsg::LogLevel::DEBUG, ms)
+#define LOG_INFO_EVERY_MS(logger, ms)  LOG_LEVEL_EVERY_MS(logger, ipmsg::LogLevel::INFO, ms)
+#define LOG_WARN_EVERY_MS(logger, ms)  LOG_LEVEL_EVERY_MS(logger, ipmsg::LogLevel::WARN, ms)
+#define LOG_ERROR_EVERY_MS(logger, ms) LOG_LEVEL_EVERY_MS(logger, ipmsg::LogLevel::ERROR, ms)
+
+#define LOG_DEBUG_RATE(logger, rate, burst) LOG_LEVEL_RATE(logger, ipmsg::LogLevel::DEBUG, rate, burst)
+#define LOG_INFO_RATE(logger, rate, burst)  LOG_LEVEL_RATE(logger, ipmsg::LogLevel::INFO, rate, burst)
+#define LOG_WARN_RATE(logger, rate, burst)  LOG_LEVEL_RATE(logger, ipmsg::LogLevel::WARN, rate, burst)
+#define LOG_ERROR_RATE(logger, rate, burst) LOG_LEVEL_RATE(logger, ipmsg::LogLevel::ERROR, rate, burst)
+
 /**
  * @date  2020-12-25 20:45
  * @brief 获取主日志器
@@ -106,6 +199,7 @@ namespace ipmsg {
 
 class Logger;
 class LoggerManager;
+class LogDateFormat;
 /**
  * @brief 日志级别
  */
@@ -138,12 +232,466 @@ public:
 	static LogLevel::Level FromString(const std::string& str);
 };
 
+/**
+* @brief 日志内容缓冲区
+* @details 直接追加到内部的std::string, 清空时保留容量, 便于日志事件复用
+*/
+class LogStreamBuf : public std::streambuf {
+public:
+	/**
+	* @brief 返回已写入的内容
+	*/
+	const std::string& str() const { return m_buf; }
+
+	/**
+	* @brief 返回内部缓冲区, 用于直接格式化写入
+	*/
+	std::string& buffer() { return m_buf; }
+protected:
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char* s, std::streamsize n) override;
+private:
+	std::string m_buf;
+};
+
+/**
+* @brief LOG_FMT2使用的类型安全的格式化
+* @details 支持printf的子集: %d %i %u %x %X %o %c 对应整数, %f %F %e %E %g %G 对应浮点数,
+*          %s 对应const char* 或 std::string, %p 对应指针, %% 输出%;
+*          可带标志[-0+ #]、宽度和.精度, 长度修饰符[hlLqjzt]被忽略(类型已由参数确定);
+*          不支持*宽度. 格式串在编译期用constexpr函数检查, 运行时按参数类型直接转换
+*/
+class LogFmt {
+public:
+	/**
+	* @brief 参数的类别
+	*/
+	enum Kind {
+		INT = 0,
+		FLOAT = 1,
+		STR = 2,
+		PTR = 3,
+		OTHER = 4
+	};
+
+	/**
+	* @brief 参数类型T对应的类别
+	*/
+	template<class T, class D = typename std::decay<T>::type>
+	struct KindOf : std::integral_constant<int,
+			std::is_integral<D>::value ? INT
+			: std::is_floating_point<D>::value ? FLOAT
+			: (std::is_same<D, const char*>::value || std::is_same<D, char*>::value
+				|| std::is_same<D, std::string>::value) ? STR
+			: std::is_pointer<D>::value ? PTR
+			: OTHER> {};
+
+	/**
+	* @brief 转换说明
+	*/
+	struct Spec {
+		char conv;
+		bool left;
+		bool zero;
+		bool plus;
+		bool space;
+		bool alt;
+		int width;
+		int precision;
+	};
+
+	/**
+	* @brief 是否为转换说明中的标志、宽度、精度或长度修饰符
+	*/
+	static constexpr bool IsModifier(char c) {
+		return c == '-' || c == '0' || c == '+' || c == ' ' || c == '#' || c == '.'
+			|| (c >= '1' && c <= '9') || c == 'h' || c == 'l' || c == 'L'
+			|| c == 'q' || c == 'j' || c == 'z' || c == 't';
+	}
+
+	/**
+	* @brief 返回从i开始的转换字符的位置
+	*/
+	static constexpr int SpecEnd(const char* s, int i) {
+		return IsModifier(s[i]) ? SpecEnd(s, i + 1) : i;
+	}
+
+	/**
+	* @brief 返回从i开始的下一个转换说明的转换字符的位置, 没有时返回-1
+	*/
+	static constexpr int NextSpec(const char* s, int i) {
+		return s[i] == '\0' ? -1
+			: s[i] != '%' ? NextSpec(s, i + 1)
+			: s[i + 1] == '%' ? NextSpec(s, i + 2)
+			: SpecEnd(s, i + 1);
+	}
+
+	/**
+	* @brief 转换字符conv是否接受类别为kind的参数
+	*/
+	static constexpr bool Match(char conv, int kind) {
+		return (conv == 'd' || conv == 'i' || conv == 'u' || conv == 'x'
+				|| conv == 'X' || conv == 'o' || conv == 'c') ? kind == INT
+			: (conv == 'f' || conv == 'F' || conv == 'e' || conv == 'E'
+				|| conv == 'g' || conv == 'G') ? kind == FLOAT
+			: conv == 's' ? kind == STR
+			: conv == 'p' ? kind == PTR
+			: false;
+	}
+
+	/**
+	* @brief 按参数类型列表检查格式串
+	*/
+	template<class... Args>
+	struct Checker;
+
+	/**
+	* @brief 推导参数类型列表, 只用于decltype, 不会被调用
+	*/
+	template<class... Args>
+	static Checker<Args...> ArgTypes(const Args&... args);
+
+	/**
+	* @brief 按参数类型依次格式化到out
+	*/
+	static void Format(std::string& out, const char* fmt) {
+		Next(out, fmt, nullptr);
+	}
+
+	template<class T, class... Rest>
+	static void Format(std::string& out, const char* fmt, const T& v, const Rest&... rest) {
+		Spec spec;
+		fmt = Next(out, fmt, &spec);
+		Write(out, spec, v, std::integral_constant<int, KindOf<T>::value>());
+		Format(out, fmt, rest...);
+	}
+private:
+	/**
+	* @brief 将下一个转换说明之前的文本写入out, 并解析该转换说明
+	* @param[out] spec 为空时写出全部剩余文本
+	* @return 转换说明之后的位置
+	*/
+	static const char* Next(std::string& out, const char* fmt, Spec* spec);
+
+	static void WriteInt(std::string& out, const Spec& spec, uint64_t v, bool negative);
+	static void WriteFloat(std::string& out, const Spec& spec, double v);
+	static void WriteStr(std::string& out, const Spec& spec, const char* s, size_t len);
+	static void WriteStr(std::string& out, const Spec& spec, const char* s);
+
+	template<class T>
+	static void Write(std::string& out, const Spec& spec, const T& v, std::integral_constant<int, INT>) {
+		bool negative = std::is_signed<T>::value && v < 0;
+		WriteInt(out, spec, negative ? 0 - (uint64_t)v : (uint64_t)v, negative);
+	}
+
+	template<class T>
+	static void Write(std::string& out, const Spec& spec, const T& v, std::integral_constant<int, FLOAT>) {
+		WriteFloat(out, spec, v);
+	}
+
+	static void Write(std::string& out, const Spec& spec, const std::string& v, std::integral_constant<int, STR>) {
+		WriteStr(out, spec, v.data(), v.size());
+	}
+
+	static void Write(std::string& out, const Spec& spec, const char* v, std::integral_constant<int, STR>) {
+		WriteStr(out, spec, v);
+	}
+
+	template<class T>
+	static void Write(std::string& out, const Spec& spec, const T& v, std::integral_constant<int, PTR>) {
+		Spec hex = spec;
+		hex.conv = 'x';
+		hex.alt = true;
+		WriteInt(out, hex, (uintptr_t)v, false);
+	}
+};
+
+template<>
+struct LogFmt::Checker<> {
+	static constexpr bool Check(const char* s, int i) {
+		return NextSpec(s, i) == -1;
+	}
+};
+
+template<class T, class... Rest>
+struct LogFmt::Checker<T, Rest...> {
+	static constexpr bool Check(const char* s, int i) {
+		return CheckAt(s, NextSpec(s, i));
+	}
+
+	static constexpr bool CheckAt(const char* s, int c) {
+		return c >= 0 && Match(s[c], KindOf<T>::value) && Checker<Rest...>::Check(s, c + 1);
+	}
+};
+
+/**
+* @brief 格式串检查失败时在编译期报错
+*/
+template<bool Ok>
+struct LogFmtAssert {
+	static_assert(Ok, "LOG_FMT2: format string does not match the argument count or types");
+	static const bool value = true;
+};
+
+/**
+* @brief 日志事件的结构化字段(键值对)
+* @details 按添加顺序保存, 前s_inline个字段存放在对象内部, 超出后才使用堆上的vector;
+*          键和字符串值拼接保存在同一个缓冲区中, 日志事件回收后保留容量, 稳定运行时不分配内存
+*/
+class LogFields {
+public:
+	/**
+	* @brief 值的类型
+	*/
+	enum Type {
+		INT = 0,
+		UINT = 1,
+		DOUBLE = 2,
+		BOOL = 3,
+		STRING = 4
+	};
+
+	/// 对象内部保存的字段数
+	static const size_t s_inline = 8;
+
+	/**
+	* @brief 字段, 键和字符串值保存为缓冲区中的偏移和长度
+	*/
+	struct Field {
+		uint32_t key;
+		uint32_t keyLen;
+		Type type;
+		union {
+			int64_t i;
+			uint64_t u;
+			double d;
+			bool b;
+			struct {
+				uint32_t off;
+				uint32_t len;
+			} s;
+		};
+	};
+
+	/**
+	* @brief 添加字段, 整数/浮点数/布尔值/字符串按类型保存, 其他类型用operator<<转成字符串
+	*/
+	template<class T>
+	void add(const char* key, size_t len, const T& v) {
+		set(push(key, len), v, std::integral_constant<int, LogFmt::KindOf<T>::value>());
+	}
+
+	/**
+	* @brief 返回字段数
+	*/
+	size_t size() const { return m_count; }
+
+	bool empty() const { return m_count == 0; }
+
+	/**
+	* @brief 返回第i个字段
+	*/
+	const Field& at(size_t i) const {
+		return i < s_inline ? m_inline[i] : m_more[i - s_inline];
+	}
+
+	/**
+	* @brief 返回缓冲区中off处的字符串, 用于读取键和字符串值
+	*/
+	const char* str(uint32_t off) const { return m_data.data() + off; }
+
+	/**
+	* @brief 清空字段, 保留容量
+	*/
+	void clear();
+private:
+	Field& push(const char* key, size_t len) {
+		Field* f;
+		if (m_count < s_inline) {
+			f = &m_inline[m_count];
+		} else {
+			m_more.resize(m_count - s_inline + 1);
+			f = &m_more.back();
+		}
+		++m_count;
+		f->key = m_data.size();
+		f->keyLen = len;
+		m_data.append(key, len);
+		return *f;
+	}
+
+	void setString(Field& f, const char* s, size_t len);
+
+	template<class T>
+	void set(Field& f, const T& v, std::integral_constant<int, LogFmt::INT>) {
+		if (std::is_signed<T>::value) {
+			f.type = INT;
+			f.i = (int64_t)v;
+		} else {
+			f.type = UINT;
+			f.u = (uint64_t)v;
+		}
+	}
+
+	void set(Field& f, const bool& v, std::integral_constant<int, LogFmt::INT>) {
+		f.type = BOOL;
+		f.b = v;
+	}
+
+	/// 与流式输出一致, char按字符输出
+	void set(Field& f, const char& v, std::integral_constant<int, LogFmt::INT>) {
+		setString(f, &v, 1);
+	}
+
+	template<class T>
+	void set(Field& f, const T& v, std::integral_constant<int, LogFmt::FLOAT>) {
+		f.type = DOUBLE;
+		f.d = v;
+	}
+
+	void set(Field& f, const std::string& v, std::integral_constant<int, LogFmt::STR>) {
+		setString(f, v.data(), v.size());
+	}
+
+	void set(Field& f, const char* v, std::integral_constant<int, LogFmt::STR>) {
+		setString(f, v, strlen(v));
+	}
+
+	template<class T, int Kind>
+	void set(Field& f, const T& v, std::integral_constant<int, Kind>) {
+		std::ostringstream ss;
+		ss << v;
+		const std::string& str = ss.str();
+		setString(f, str.data(), str.size());
+	}
+private:
+	Field m_inline[s_inline];
+	std::vector<Field> m_more;
+	/// 键和字符串值
+	std::string m_data;
+	size_t m_count = 0;
+};
+
+/**
+* @brief 日志内容流, 在流式输出之外可以附加结构化字段
+* @details LOG_INFO(logger).kv("user", id).kv("bytes", n) << "msg";
+*          字段由%J输出为JSON的属性, %m在内容之后以" key=value"的形式输出
+*/
+class LogStream : public std::ostream {
+public:
+	LogStream(std::streambuf* buf, LogFields* fields)
+		:std::ostream(buf)
+		,m_fields(fields) {
+	}
+
+	/**
+	* @brief 添加结构化字段
+	* @param[in] key 字段名, 应为标识符形式, 不做转义
+	* @param[in] value 字段值
+	*/
+	template<class T>
+	LogStream& kv(const char* key, const T& value) {
+		m_fields->add(key, strlen(key), value);
+		return *this;
+	}
+
+	template<class T>
+	LogStream& kv(const std::string& key, const T& value) {
+		m_fields->add(key.data(), key.size(), value);
+		return *this;
+	}
+private:
+	LogFields* m_fields;
+};
+
+/**
+* @brief 日志上下文(MDC, Mapped Diagnostic Context)
+* @details 每个线程有自己的上下文; 协程有各自的上下文, 创建时复制创建者的内容,
+*          Fiber::SetThis切换当前上下文, 协程在线程间迁移或在同一线程上交替运行时内容保持正确.
+*          日志事件只保存当前上下文的指针, 由%X{key}和%J在格式化时读取, 不逐条复制
+*/
+class LogMDC {
+public:
+	typedef std::vector<std::pair<std::string, std::string> > Entries;
+
+	/**
+	* @brief 查找key对应的值, 不存在时返回nullptr
+	*/
+	const std::string* find(const char* key, size_t len) const;
+
+	/**
+	* @brief 返回所有键值对, 按添加顺序
+	*/
+	const Entries& getEntries() const { return m_entries; }
+
+	/**
+	* @brief 在当前上下文中设置key的值
+	*/
+	static void Put(const std::string& key, const std::string& value);
+
+	/**
+	* @brief 返回当前上下文中key的值, 不存在时返回空字符串
+	*/
+	static std::string Get(const std::string& key);
+
+	/**
+	* @brief 从当前上下文中删除key
+	*/
+	static void Remove(const std::string& key);
+
+	/**
+	* @brief 清空当前上下文
+	*/
+	static void Clear();
+
+	/**
+	* @brief 返回当前上下文: 当前协程的, 或当前线程的; 线程退出阶段返回nullptr
+	*/
+	static LogMDC* GetCurrent();
+
+	/**
+	* @brief 切换当前上下文, nullptr表示使用线程自己的上下文, 由Fiber::SetThis调用
+	*/
+	static void SetCurrent(LogMDC* mdc);
+
+	/**
+	* @brief 作用域内设置key, 析构时恢复原来的值
+	*/
+	class Scope {
+	public:
+		Scope(const std::string& key, const std::string& value);
+		~Scope();
+	private:
+		std::string m_key;
+		std::string m_old;
+		bool m_had;
+	};
+private:
+	Entries m_entries;
+};
+
 /**
 * @brief 日志事件
+* @details 只保存日志器的裸指针, 日志器须在事件使用期间保持存活(日志语句中总是如此),
+*          避免每条日志都在日志器共享的引用计数上做原子操作
 */
-class LogEvent {
+class LogEvent : public std::enable_shared_from_this<LogEvent> {
+friend class BinaryLogReader;
+friend class LogEventWrap;
 public:
 	typedef std::shared_ptr<LogEvent> ptr;
+
+	/**
+	* @brief 从线程局部的事件池中获取日志事件
+	* @details 事件释放时回收到当前线程的事件池, 内容缓冲区的容量被保留,
+	*          shared_ptr的控制块也从线程局部的内存块中分配, 稳定运行时不再分配内存
+	*          参数同构造函数
+	*/
+	static LogEvent::ptr Create(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+			,const char* file, int32_t line, uint32_t elapse
+			,uint32_t thread_id, uint32_t fiber_id, uint64_t time
+			,const std::string& thread_name);
+
 	/**
 	* @brief 构造函数
 	* @param[in] logger 日志器
@@ -154,7 +702,7 @@ public:
 	* @param[in] thread_id 线程id
 	* @param[in] fiber_id 协程id
 	* @param[in] time 日志事件(秒)
-	* @param[in] thread_name 线程名称
+	* @param[in] thread_name 线程名称, 只保存引用, 生命周期需长于日志事件(如Thread::GetName())
 	*/
 	LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level
 			,const char* file, int32_t line, uint32_t elapse
@@ -190,20 +738,42 @@ public:
 	*/
 	uint64_t getTime() const { return m_time; }
 
+	/**
+	* @brief 返回秒内的微秒数(CLOCK_REALTIME_COARSE精度)
+	*/
+	uint32_t getUsec() const { return m_usec; }
+
+	/**
+	* @brief 设置时间, 用于还原已记录的日志
+	* @param[in] time 秒
+	* @param[in] usec 秒内的微秒数
+	*/
+	void setTime(uint64_t time, uint32_t usec) { m_time = time; m_usec = usec; }
+
+	/**
+	* @brief 在内容末尾追加被限流丢弃的条数
+	*/
+	void addSuppressed(uint64_t count);
+
 	/**
 	* @brief 返回线程名称
 	*/
-	const std::string& getThreadName() const { return m_threadName; }
+	const std::string& getThreadName() const { return *m_threadName; }
 
 	/**
 	* @brief 返回日志内容
 	*/
-	std::string getContent() const { return m_ss.str(); }
+	const std::string& getContent() const { return m_buf.str(); }
 
 	/**
 	* @brief 返回日志器
 	*/
-	std::shared_ptr<Logger> getLogger() const { return m_logger; }
+	std::shared_ptr<Logger> getLogger() const;
+
+	/**
+	* @brief 返回日志器名称, 不复制智能指针
+	*/
+	const std::string& getLoggerName() const;
 
 	/**
 	* @brief 返回日志级别
@@ -213,7 +783,17 @@ public:
 	/**
 	* @brief 返回日志内容字符串流
 	*/
-	std::stringstream& getSS() { return m_ss; }
+	LogStream& getSS() { return m_ss; }
+
+	/**
+	* @brief 返回结构化字段
+	*/
+	const LogFields& getFields() const { return m_fields; }
+
+	/**
+	* @brief 返回创建事件时的日志上下文, 只在日志分发期间有效, 可能为nullptr
+	*/
+	const LogMDC* getMDC() const { return m_mdc; }
 
 	/**
 	* @brief 格式化写入日志内容
@@ -224,6 +804,29 @@ public:
 	 * @brief 格式化写入日志内容
 	 */
 	void format(const char* fmt, va_list al);
+
+	/**
+	* @brief 按参数类型格式化写入日志内容, 格式见LogFmt, 由LOG_FMT2_*在编译期检查
+	*/
+	template<class... Args>
+	void format2(const char* fmt, const Args&... args) {
+		LogFmt::Format(m_buf.buffer(), fmt, args...);
+	}
+private:
+	/**
+	* @brief 重新初始化被回收的日志事件
+	*/
+	void reset(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+			,const char* file, int32_t line, uint32_t elapse
+			,uint32_t thread_id, uint32_t fiber_id, uint64_t time
+			,const std::string& thread_name);
+
+	/**
+	* @brief 回收日志事件的删除器
+	*/
+	struct Recycler {
+		void operator()(LogEvent* event) const;
+	};
 private:
 	// 文件名
 	const char* m_file = nullptr;
@@ -237,12 +840,20 @@ private:
 	uint32_t m_fiberId = 0;
 	// 时间戳
 	uint64_t m_time = 0;
+	// 秒内的微秒数
+	uint32_t m_usec = 0;
 	// 线程名称
-	std::string m_threadName;
+	const std::string* m_threadName;
+	// 日志内容缓冲区
+	LogStreamBuf m_buf;
+	// 结构化字段
+	LogFields m_fields;
+	// 日志上下文
+	const LogMDC* m_mdc = nullptr;
 	// 日志内容流
-	std::stringstream m_ss;
+	LogStream m_ss{&m_buf, &m_fields};
 	// 日志器,用于LogEventWrap
-	std::shared_ptr<Logger> m_logger;
+	Logger* m_logger = nullptr;
 	// 日志等级
 	LogLevel::Level m_level;
 };
@@ -250,20 +861,79 @@ private:
 
 class LogEventWrap {
 public:
-	LogEventWrap(LogEvent::ptr e);
+	/**
+	* @param[in] e 日志事件
+	* @param[in] suppressed 同一调用位置上次输出后被限流丢弃的条数
+	*/
+	LogEventWrap(LogEvent::ptr e, uint64_t suppressed = 0);
 	~LogEventWrap();
 
 	/**
-	* @brief 返回日志内容字符串流
+	* @brief 返回日志内容字符串流, 可先用kv()添加结构化字段
 	*/
-	std::stringstream& getSS();
+	LogStream& getSS();
 
 	/**
 	 * @brief 获取日志事件
 	 */
-	LogEvent::ptr getEvent() const { return m_event; }
+	const LogEvent::ptr& getEvent() const { return m_event; }
 private:
 	LogEvent::ptr m_event;
+	uint64_t m_suppressed;
+};
+
+/**
+* @brief 日志限流状态, 用于单个调用位置或单个日志器
+* @details 只用原子变量, 未触发限流时每条日志只有一两次无竞争的原子操作;
+*          三种判断方式的返回值相同: 0表示丢弃, 否则减1为之前被丢弃的条数
+*/
+class LogSite {
+public:
+	constexpr LogSite()
+		:m_state(0)
+		,m_suppressed(0) {
+	}
+
+	/**
+	* @brief 每n次只放行第1次
+	*/
+	uint64_t everyN(uint64_t n);
+
+	/**
+	* @brief 每ms毫秒最多放行1次
+	*/
+	uint64_t everyMs(uint64_t ms);
+
+	/**
+	* @brief 令牌桶(GCRA算法), 每interval_us微秒产生一个令牌, 最多积累burst个
+	*/
+	uint64_t tokenBucket(uint64_t interval_us, uint32_t burst);
+
+	/**
+	* @brief 返回单调时钟的微秒数(低精度, 开销小)
+	*/
+	static uint64_t NowUs();
+private:
+	/**
+	* @brief 放行一条, 返回被丢弃的条数加1
+	*/
+	uint64_t pass() {
+		uint64_t n = m_suppressed.load(std::memory_order_relaxed);
+		return (n ? m_suppressed.exchange(0, std::memory_order_relaxed) : 0) + 1;
+	}
+
+	/**
+	* @brief 丢弃一条
+	*/
+	uint64_t drop() {
+		m_suppressed.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+private:
+	/// everyN时为计数, everyMs时为上次放行的时间, tokenBucket时为理论到达时间
+	std::atomic<uint64_t> m_state;
+	/// 上次放行后被丢弃的条数
+	std::atomic<uint64_t> m_suppressed;
 };
 
 /**
@@ -286,7 +956,7 @@ public:
 	*  %c 日志名称
 	*  %t 线程id
 	*  %n 换行
-	*  %d 时间
+	*  %d 时间, %d{...}中支持strftime的格式, 以及 %L 毫秒 / %f 微秒
 	*  %f 文件名
 	*  %l 行号
 	*  %T 制表符
@@ -303,18 +973,51 @@ public:
 	* @param[in] level 日志级别
 	* @param[in] event 日志事件
 	*/
-	std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level,
-		LogEvent::ptr event);
-	std::ostream& format(std::ostream& ofs, std::shared_ptr<Logger> logger, LogLevel::Level level,
-		LogEvent::ptr event);
+	std::string format(const std::shared_ptr<Logger>& logger, LogLevel::Level level,
+		const LogEvent::ptr& event);
+	std::ostream& format(std::ostream& ofs, const std::shared_ptr<Logger>& logger, LogLevel::Level level,
+		const LogEvent::ptr& event);
+
+	/**
+	* @brief 将日志格式化后写入流
+	*/
+	std::ostream& format(std::ostream& ofs, LogLevel::Level level, const LogEvent& event);
+
+	/**
+	* @brief 将日志格式化到调用方提供的缓冲区
+	* @param[out] buf 输出缓冲区
+	* @param[in] size 缓冲区大小
+	* @param[in] level 日志级别
+	* @param[in] event 日志事件
+	* @return 完整日志的长度, 大于size时buf中只有前size个字节
+	*/
+	size_t format(char* buf, size_t size, LogLevel::Level level, const LogEvent& event);
+
+	/**
+	* @brief 将日志格式化后追加到out
+	*/
+	void format(std::string& out, LogLevel::Level level, const LogEvent& event);
+
+	/**
+	* @brief 逐个调用FormatItem格式化日志
+	* @details 编译前的实现, 输出与format()逐字节相同, 用于对比验证
+	*/
+	std::ostream& formatItems(std::ostream& ofs, const std::shared_ptr<Logger>& logger, LogLevel::Level level,
+		const LogEvent::ptr& event);
 
 	/**
 	* @brief 初始化,解析日志模板
+	* @details 解析出FormatItem列表, 同时编译成指令序列, 相邻的字符串/制表符/换行合并成一条指令
 	*/
 	void init();
 
 	bool isError() const { return m_error; }
 
+	/**
+	* @brief 模板中是否有换行(%n), 有则输出到流后需要刷新
+	*/
+	bool isFlush() const { return m_flush; }
+
 	const std::string getPattern() const { return m_pattern; }
 public:
 	class FormatItem {
@@ -333,27 +1036,143 @@ public:
 		* @param[in] level 日志等级
 		* @param[in] event 日志事件
 		*/
-		virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;
+		virtual void format(std::ostream& os, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event) = 0;
 	};
 
 private:
+	/**
+	* @brief 编译后的格式化指令
+	*/
+	struct Op {
+		// 指令类型
+		uint32_t code;
+		// 字面量在m_literals中的偏移, 或时间格式在m_dateFormats中的下标
+		uint32_t arg;
+		// 字面量长度
+		uint32_t len;
+	};
+
 	// 日志格式模板
 	std::string m_pattern;
 	// 日志格式解析后格式
 	std::vector<FormatItem::ptr> m_items;
+	// 编译后的指令序列
+	std::vector<Op> m_program;
+	// 所有字面量
+	std::string m_literals;
+	// 时间格式
+	std::vector<std::shared_ptr<LogDateFormat> > m_dateFormats;
+	// 模板中有换行(%n)时, 输出到流后刷新
+	bool m_flush = false;
 	// 是否有错误
 	bool m_error = false;
 
-};
-
+};
+
 /**
-* @brief 日志输出目标
-*/
-class LogAppender {
-friend class Logger; // logger 调用 成员变量
-public:
-    typedef Spinlock MutexType;
-	/**
+* @brief 返回当前线程使用的计数器分片, 线程首次调用时轮流分配
+*/
+uint32_t LogCounterShard();
+
+/**
+* @brief 按线程分片的一组计数器
+* @details 每个线程只累加自己分片(独占缓存行)中的计数, 读取时对所有分片求和,
+*          写日志的线程之间不竞争同一缓存行
+* @tparam N 计数器个数
+*/
+template<size_t N>
+class LogCounters {
+public:
+	/// 分片数, 超过该数量的线程共用分片
+	static const uint32_t s_shards = 16;
+
+	LogCounters() {
+		for (auto& s : m_shards) {
+			for (auto& v : s.values) {
+				v.store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	* @brief 累加第idx个计数器
+	*/
+	void add(size_t idx, uint64_t v = 1) {
+		m_shards[LogCounterShard()].values[idx].fetch_add(v, std::memory_order_relaxed);
+	}
+
+	/**
+	* @brief 返回第idx个计数器在所有分片上的和
+	*/
+	uint64_t get(size_t idx) const {
+		uint64_t v = 0;
+		for (auto& s : m_shards) {
+			v += s.values[idx].load(std::memory_order_relaxed);
+		}
+		return v;
+	}
+private:
+	struct Shard {
+		std::atomic<uint64_t> values[N];
+		/// 补齐到缓存行的整数倍
+		char pad[64 - N * sizeof(uint64_t) % 64];
+	};
+	Shard m_shards[s_shards];
+};
+
+/**
+* @brief 采样计时器, 统计格式化/写入耗时用
+* @details 默认每个线程每s_rate次构造只有一次真正读取时钟, lap()返回的耗时已乘以s_rate,
+*          累加结果是总耗时的估计值; 未采样时lap()返回0
+*/
+class LogSampleTimer {
+public:
+	/// 采样间隔
+	static const uint32_t s_rate = 16;
+
+	/**
+	* @brief 构造函数
+	* @param[in] always 为true时每次都计时, 用于本身开销远大于读取时钟的系统调用
+	*/
+	explicit LogSampleTimer(bool always = false);
+
+	/**
+	* @brief 返回距构造或上次lap()的耗时(纳秒, 已按采样间隔放大)
+	*/
+	uint64_t lap();
+private:
+	/// 上次读取的时钟, 0表示本次不计时
+	uint64_t m_last;
+	/// 耗时的放大倍数
+	uint32_t m_scale;
+};
+
+/**
+* @brief 日志输出目标
+*/
+class LogAppender {
+friend class Logger; // logger 调用 成员变量
+public:
+	/**
+	* @brief 统计数据的快照
+	*/
+	struct Metrics {
+		/// 写入的条数
+		uint64_t events = 0;
+		/// 写入的字节数
+		uint64_t bytes = 0;
+		/// 格式化耗时(纳秒, 采样估计)
+		uint64_t format_ns = 0;
+		/// 写入耗时(纳秒)
+		uint64_t write_ns = 0;
+		/// 丢弃的条数
+		uint64_t dropped = 0;
+		/// 重新打开文件/连接的次数
+		uint64_t reopens = 0;
+	};
+
+    typedef Spinlock MutexType;
+	/**
 	*	@brief 被共享指针管理
 	*/
 	typedef std::shared_ptr<LogAppender> ptr;
@@ -368,12 +1187,24 @@ public:
 	virtual ~LogAppender() {}
 
 	/**
-	* @brief 写入日志
+	* @brief 写入日志, 日志器分发时调用, 不复制智能指针
+	* @details 默认实现转调log(), 兼容只重写了log()的自定义日志目标;
+	*          日志器或日志事件不由shared_ptr管理时, 传给log()的指针不拥有对象,
+	*          只在调用期间有效
+	* @param[in] logger 日志器
+	* @param[in] level 日志级别
+	* @param[in] event 日志事件, 只在调用期间有效
+	*/
+	virtual void append(Logger& logger, LogLevel::Level level, const LogEvent& event);
+
+	/**
+	* @brief 写入日志(兼容接口)
+	* @details 默认实现丢弃日志并计入DROPPED, 派生类须至少重写append()和log()中的一个
 	* @param[in] logger 日志器
 	* @param[in] level 日志级别
 	* @param[in] event 日志事件
 	*/
-	virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;
+	virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event);
 
 	/**
 	* @brief 更改日志格式器
@@ -396,11 +1227,72 @@ public:
 	LogLevel::Level getLevel() const { return m_level; }
 
 	virtual std::string toYamlString() = 0;
+
+	/**
+	* @brief 将缓冲中的日志写出, 默认没有缓冲
+	*/
+	virtual void flush() {}
+
+	/**
+	* @brief 由后台刷新线程定期调用, 写出停留时间超过上限的日志
+	* @param[in] now_ms 当前时间(毫秒)
+	*/
+	virtual void flushExpired(uint64_t now_ms) {}
+
+	/**
+	* @brief 返回统计数据
+	*/
+	Metrics getMetrics() const;
+protected:
+	/**
+	* @brief 统计项, 对应Metrics的各个字段
+	*/
+	enum Counter {
+		EVENTS = 0,
+		BYTES,
+		FORMAT_NS,
+		WRITE_NS,
+		DROPPED,
+		REOPENS,
+		COUNTER_MAX
+	};
+
+	/**
+	* @brief 累加统计项, 派生类在写入路径中调用
+	*/
+	void addCounter(Counter c, uint64_t v = 1) { m_counters.add(c, v); }
+
+	/**
+	* @brief 记录一条写入的日志
+	* @param[in] bytes 格式化后的字节数
+	* @param[in] format_ns 格式化耗时, 来自LogSampleTimer::lap()
+	*/
+	void countEvent(size_t bytes, uint64_t format_ns) {
+		m_counters.add(EVENTS);
+		m_counters.add(BYTES, bytes);
+		if (format_ns) {
+			m_counters.add(FORMAT_NS, format_ns);
+		}
+	}
+
+	/**
+	* @brief 注册到后台刷新线程, 每隔约interval_ms调用一次flushExpired
+	*/
+	static void AddFlushTimer(LogAppender* appender, uint32_t interval_ms);
+
+	/**
+	* @brief 从后台刷新线程注销, 返回后不会再调用flushExpired, 派生类析构时须先调用
+	*/
+	static void DelFlushTimer(LogAppender* appender);
 protected:
 	LogLevel::Level m_level = LogLevel::DEBUG;
 	bool m_hasFormatter = false;
 	// 定义输出的格式
 	LogFormatter::ptr m_formatter;
+	// 格式器版本, 每次更换格式器时加1, 使线程缓存的格式器失效
+	std::atomic<uint32_t> m_formatterVersion{0};
+	/// 统计计数
+	LogCounters<COUNTER_MAX> m_counters;
 
 	MutexType m_mutex;
 };
@@ -417,11 +1309,24 @@ public:
 	*	@brief 被共享指针管理
 	*/
 	typedef std::shared_ptr<Logger> ptr;
+
+	/**
+	* @brief 统计数据的快照
+	*/
+	struct Metrics {
+		/// 按级别统计的输出条数, 下标为LogLevel::Level
+		uint64_t events[LogLevel::FATAL + 1] = {0};
+		/// 被限流丢弃的条数
+		uint64_t throttled = 0;
+	};
+
 	/**
 	* @brief 构造函数
 	* @param[in] name 日志器名称
 	*/
 	Logger(const std::string& name = "root");
+
+	~Logger();
 
 	/**
 	* @brief 写日志
@@ -429,6 +1334,11 @@ public:
 	* @param[in] event 日志事件
 	*/
 	void log(LogLevel::Level level, LogEvent::ptr event);
+
+	/**
+	* @brief 写日志, 日志语句使用, 整个分发过程不复制智能指针
+	*/
+	void log(LogLevel::Level level, LogEvent& event);
 
 	/**
 	* @brief 写debug级别日志
@@ -478,14 +1388,82 @@ public:
 	void clearAppenders();
 
 	/**
-	* @brief 返回日志级别
+	* @brief 一次性替换全部日志目标, 写日志的线程不会看到中间状态
+	*/
+	void setAppenders(const std::list<LogAppender::ptr>& appenders);
+
+	/**
+	* @brief 返回自身的日志目标(不包含上级日志器的)
+	*/
+	std::list<LogAppender::ptr> getAppenders();
+
+	/**
+	* @brief 写出所有日志目标中缓冲的日志
+	*/
+	void flush();
+
+	/**
+	* @brief 返回统计数据, 只统计经过本日志器输出的日志
+	*/
+	Metrics getMetrics() const;
+
+	/**
+	* @brief 设置整个日志器的限流
+	* @param[in] rate 平均每秒最多输出的条数, 0表示不限流
+	* @param[in] burst 允许突发的条数
+	*/
+	void setRateLimit(uint32_t rate, uint32_t burst);
+
+	uint32_t getRateLimit() const { return m_rateLimit; }
+	uint32_t getBurst() const { return m_burst; }
+
+	/**
+	* @brief 返回日志级别, UNKNOW表示继承上级日志器的级别
 	*/
 	LogLevel::Level getLevel() const { return m_level; }
 
 	/**
-	* @brief 设置日志级别
+	* @brief 设置日志级别, 同时更新所有日志器缓存的有效级别
+	*/
+	void setLevel(LogLevel::Level val);
+
+	/**
+	* @brief 返回有效级别, 即自身或最近的设置了级别的上级日志器的级别
+	*/
+	LogLevel::Level getEffectiveLevel() const {
+		return (LogLevel::Level)m_effectiveLevel.load(std::memory_order_relaxed);
+	}
+
+	/**
+	* @brief 返回需要构造日志事件的最低级别, 只有一次原子读
+	* @details 开启飞行记录器后, 低于有效级别但不低于记录级别的日志也会被记录
+	*/
+	LogLevel::Level getMinLevel() const {
+		return (LogLevel::Level)m_minLevel.load(std::memory_order_relaxed);
+	}
+
+	/**
+	* @brief 返回上级日志器, 如 net.tcp 的上级为 net, 不存在时为 root
+	*/
+	Logger::ptr getParent() const;
+
+	/**
+	* @brief 设置飞行记录器的记录级别, 对所有日志器生效
+	* @details 实际生效的是它与所有FlightRecorderAppender的记录级别中最低的一个
+	*/
+	static void SetCaptureLevel(LogLevel::Level level);
+
+	/**
+	* @brief 登记/注销一个FlightRecorderAppender的记录级别
+	*/
+	static void AddCaptureLevel(LogLevel::Level level);
+	static void DelCaptureLevel(LogLevel::Level level);
+
+	/**
+	* @brief 返回配置版本, 级别/日志目标/层级关系每变化一次加1,
+	*        变化时立即重新计算所有日志器的缓存
 	*/
-	inline void setLevel(LogLevel::Level val) { m_level = val; }
+	static uint64_t GetEpoch();
 
 	/**
 	* @brief 获取日志格式器
@@ -503,17 +1481,72 @@ public:
 	*	@brief 返回日志名称
 	*/
 	const std::string& getName() const { return m_name; }
+private:
+	/**
+	* @brief 按日志器级别和限流输出到日志目标, 没有日志目标时使用最近的有日志目标的上级日志器
+	*/
+	void dispatch(LogLevel::Level level, LogEvent& event);
+
+	/**
+	* @brief 发布m_appenders的新快照并释放旧快照, 返回前会释放lock
+	*/
+	void publishAppenders(MutexType::Lock& lock);
+
+	/**
+	* @brief 日志目标的只读快照
+	* @details 发布者持有一个引用, 旧快照的宽限期结束后释放; 写日志时在读临界区内
+	*          取得引用后即离开临界区, 输出期间(可能阻塞)不会拖住Synchronize
+	*/
+	struct AppenderSnapshot {
+		std::atomic<int> refs{1};
+		std::vector<LogAppender::ptr> appenders;
+
+		void release() {
+			if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				delete this;
+			}
+		}
+	};
+
+	/**
+	* @brief 重新计算缓存的有效级别和日志目标, 调用方持有注册表的锁
+	*/
+	void refresh();
+
+	/**
+	* @brief 配置版本加1并重新计算所有日志器的缓存
+	* @param[in] locked 调用方是否已持有注册表的锁
+	*/
+	static void RefreshAll(bool locked = false);
 private:
 	/// 日志名称
 	std::string m_name;
 	/// 日志级别
 	LogLevel::Level m_level;
-	/// 日志目标集合
+	/// 缓存的有效级别
+	std::atomic<int> m_effectiveLevel;
+	/// 缓存的有效级别与飞行记录器记录级别中较低的一个
+	std::atomic<int> m_minLevel;
+	/// 缓存的实际输出的日志器: 自身或最近的有日志目标的上级日志器
+	std::atomic<Logger*> m_appenderOwner{nullptr};
+	/// 日志目标集合, 只在持有m_mutex时修改
 	std::list<LogAppender::ptr> m_appenders;
+	/// 日志目标的只读快照, 写日志时在RCU读临界区内取得引用
+	std::atomic<AppenderSnapshot*> m_snapshot;
+	/// 每秒最多输出的条数, 0表示不限流
+	std::atomic<uint32_t> m_rateLimit{0};
+	/// 允许突发的条数
+	std::atomic<uint32_t> m_burst{0};
+	/// 限流状态
+	LogSite m_throttle;
+	/// 统计计数, 下标0为被限流的条数, 其余为对应级别的输出条数
+	LogCounters<LogLevel::FATAL + 1> m_counters;
+	/// 飞行记录器的记录级别, 默认大于所有级别即不记录
+	static std::atomic<int> s_captureLevel;
 	/// 日志格式器
 	LogFormatter::ptr m_formatter;
-	/// 主日志器
-	Logger::ptr m_root;
+	/// 上级日志器, 只在持有注册表的锁时修改
+	Logger::ptr m_parent;
     MutexType m_mutex;
 };
 
@@ -526,34 +1559,778 @@ public:
         // std::cout << "StdoutLogAppender construct()" << std::endl;
 	}
 	typedef std::shared_ptr<StdoutLogAppender> ptr;
-    // void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
-	void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+	void append(Logger& logger, LogLevel::Level level, const LogEvent& event) override;
     std::string toYamlString() override;
 };
 
 /**
 * @brief 输出到文件的Appender
+* @details 按大小或按小时/天切分日志文件, 切分后的文件名为 "文件名.年月日-时分秒",
+*          可保留指定数量的历史文件并在后台线程中压缩为gzip.
+*          每秒最多检查一次文件的inode, 文件被外部logrotate移走或删除后才重新打开.
+*          开启线程缓冲后, 每个线程格式化到自己的缓冲区, 缓冲区满、超过停留时间上限、
+*          显式flush或线程退出时整块写入文件, 同一线程的日志保持顺序
 */
 class FileLogAppender : public LogAppender {
 public:
 	typedef std::shared_ptr<FileLogAppender> ptr;
-	FileLogAppender(const std::string& filename);
-	// void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
-	void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+
+	/**
+	* @brief 按时间切分的方式
+	*/
+	enum RotateMode {
+		/// 不按时间切分
+		ROTATE_NONE = 0,
+		/// 每小时切分
+		ROTATE_HOURLY = 1,
+		/// 每天切分
+		ROTATE_DAILY = 2
+	};
+
+	/**
+	* @brief 切分策略
+	*/
+	struct RotatePolicy {
+		RotatePolicy()
+			:max_size(0)
+			,mode(ROTATE_NONE)
+			,max_files(0)
+			,compress(false) {
+		}
+
+		/// 单个文件的最大字节数, 0表示不限制
+		uint64_t max_size;
+		/// 按时间切分的方式
+		RotateMode mode;
+		/// 保留的历史文件数量, 0表示全部保留
+		uint32_t max_files;
+		/// 是否压缩历史文件
+		bool compress;
+	};
+
+	static const char* RotateModeToString(RotateMode mode);
+	static RotateMode RotateModeFromString(const std::string& str);
+
+	FileLogAppender(const std::string& filename, const RotatePolicy& policy = RotatePolicy());
+	~FileLogAppender();
+	void append(Logger& logger, LogLevel::Level level, const LogEvent& event) override;
     std::string toYamlString() override;
 	/**
 	* @brief 重新打开日志文件
 	* @return 成功返回true
 	*/
 	bool reopen();
+
+	/**
+	* @brief 立即切分当前文件
+	*/
+	void rotate();
+
+	const RotatePolicy& getPolicy() const { return m_policy; }
+
+	/**
+	* @brief 设置线程缓冲
+	* @param[in] size 每个线程缓冲区的大小(字节), 0表示不缓冲, 每条日志直接写入文件
+	* @param[in] interval_ms 日志在缓冲区中的最长停留时间(毫秒)
+	*/
+	void setBuffer(size_t size, uint32_t interval_ms = 100);
+
+	/**
+	* @brief 写出所有线程缓冲区中的日志
+	*/
+	void flush() override;
+
+	void flushExpired(uint64_t now_ms) override;
+
+	/**
+	* @brief 写出当前线程在所有FileLogAppender中缓冲的日志, 线程退出前调用
+	*/
+	static void FlushThreadBuffers();
+private:
+	struct ThreadBuffer;
+	struct ThreadBufferCache;
+
+	/**
+	* @brief 返回当前线程的缓冲区集合
+	* @param[in] create 不存在时是否创建
+	*/
+	static ThreadBufferCache* GetBufferCache(bool create);
+
+	/**
+	* @brief 返回当前线程的缓冲区, 第一次调用时创建并注册
+	*/
+	ThreadBuffer* getThreadBuffer();
+
+	/**
+	* @brief 写出buf中的日志, 调用方持有buf的锁
+	* @param[in] all 为false时只写出停留时间超过上限的日志
+	*/
+	void flushBuffer(ThreadBuffer* buf, bool all, uint64_t now_ms);
+
+	/**
+	* @brief 写出所有线程缓冲区
+	*/
+	void flushBuffers(bool all, uint64_t now_ms);
+
+	/**
+	* @brief 检查文件是否需要重新打开或按时间切分, 调用方持有锁
+	*/
+	void checkFile(uint64_t now);
+
+	/**
+	* @brief 写入一批日志, 需要时先按大小切分, 调用方持有锁
+	*/
+	void writeData(const char* data, size_t len, uint64_t now);
+
+	/**
+	* @brief 打开日志文件, 调用方持有锁
+	*/
+	bool openFile();
+
+	/**
+	* @brief 切分当前文件, 调用方持有锁
+	*/
+	void rotateFile(time_t now);
+
+	/**
+	* @brief 返回now所在切分周期的编号, 不按时间切分时返回0
+	*/
+	uint64_t periodOf(time_t now) const;
 private:
 	// 文件路径
 	std::string m_filename;
-	// 文件流
-	std::ofstream m_filestream;
-    /// 上次重新打开时间
+	// 切分策略
+	RotatePolicy m_policy;
+	// 文件描述符
+	int m_fd = -1;
+	// 打开时文件的设备号及inode
+	uint64_t m_dev = 0;
+	uint64_t m_ino = 0;
+	// 当前文件大小
+	uint64_t m_size = 0;
+	// 当前文件所属的切分周期
+	uint64_t m_period = 0;
+	// 格式化缓冲区
+	std::string m_buf;
+    /// 上次检查文件的时间
     uint64_t m_lastTime = 0;
+	/// 上次切分的历史文件名(不含序号)及序号
+	std::string m_rotateBase;
+	int m_rotateSeq = 0;
+	// 唯一id, 线程缓存按id查找缓冲区
+	uint64_t m_id;
+	// 线程缓冲区大小, 0表示不缓冲, 写日志时无锁读取
+	std::atomic<size_t> m_bufferSize{0};
+	// 日志在缓冲区中的最长停留时间(毫秒)
+	std::atomic<uint32_t> m_flushInterval{100};
+	// 保护m_buffers
+	Mutex m_buffersMutex;
+	// 所有线程的缓冲区
+	std::vector<std::shared_ptr<ThreadBuffer> > m_buffers;
 };
+
+/**
+* @brief 异步输出到文件的Appender
+* @details 调用线程只负责格式化, 格式化后的日志放入有界无锁的多生产者环形队列,
+*          由后台线程批量取出并通过writev写入文件
+*/
+class AsyncLogAppender : public LogAppender {
+public:
+	typedef std::shared_ptr<AsyncLogAppender> ptr;
+
+	/**
+	* @brief 队列满时的处理策略
+	*/
+	enum OverflowPolicy {
+		/// 阻塞等待后台线程腾出空间
+		BLOCK = 0,
+		/// 丢弃最新的日志
+		DROP_NEWEST = 1,
+		/// 队列超过3/4水位时丢弃DEBUG日志, 其余级别阻塞等待
+		DROP_DEBUG_FIRST = 2
+	};
+
+	/**
+	* @brief 将策略转成文本
+	*/
+	static const char* PolicyToString(OverflowPolicy policy);
+
+	/**
+	* @brief 将文本转换成策略, 空串返回BLOCK, 无法识别时报错并返回DROP_NEWEST
+	*/
+	static OverflowPolicy PolicyFromString(const std::string& str);
+
+	/**
+	* @brief 构造函数
+	* @param[in] filename 文件路径
+	* @param[in] capacity 队列容量(条), 向上取整为2的幂
+	* @param[in] policy 队列满时的处理策略
+	*/
+	AsyncLogAppender(const std::string& filename, size_t capacity = 8192
+			,OverflowPolicy policy = BLOCK);
+
+	/**
+	* @brief 析构函数, 写完队列中剩余日志后停止后台线程
+	*/
+	~AsyncLogAppender();
+
+	void append(Logger& logger, LogLevel::Level level, const LogEvent& event) override;
+	std::string toYamlString() override;
+
+	/**
+	* @brief 阻塞直到调用前入队的日志全部写入文件
+	*/
+	void flush() override;
+
+	/**
+	* @brief 返回被丢弃的日志条数
+	*/
+	uint64_t getDropped() const { return m_dropped; }
+
+	/**
+	* @brief 返回被丢弃的DEBUG日志条数(包含在getDropped中)
+	*/
+	uint64_t getDroppedDebug() const { return m_droppedDebug; }
+
+	OverflowPolicy getPolicy() const { return m_policy; }
+	size_t getCapacity() const { return m_mask + 1; }
+private:
+	/**
+	* @brief 队列槽位, seq 用于生产者与消费者之间的同步
+	*/
+	struct Slot {
+		std::atomic<uint64_t> seq;
+		std::string data;
+	};
+
+	/**
+	* @brief 入队, 队列满且block为false时返回false
+	*/
+	bool push(std::string& msg, bool block);
+
+	/**
+	* @brief 队列中大致的日志条数
+	*/
+	size_t size() const { return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_relaxed); }
+
+	/**
+	* @brief 唤醒等待中的后台线程
+	*/
+	void wakeup();
+
+	/**
+	* @brief 后台线程执行函数
+	*/
+	void run();
+
+	/**
+	* @brief 取出一批日志写入文件
+	* @return 本次写入的条数
+	*/
+	size_t drain();
+
+	/**
+	* @brief 后台线程重新打开日志文件
+	*/
+	bool reopen();
+private:
+	// 文件路径
+	std::string m_filename;
+	// 文件描述符, 只在后台线程中使用
+	int m_fd = -1;
+	// 打开时文件的设备号及inode
+	uint64_t m_dev = 0;
+	uint64_t m_ino = 0;
+	// 上次检查文件的时间
+	uint64_t m_lastTime = 0;
+	// 处理策略
+	OverflowPolicy m_policy;
+	// 容量 - 1
+	size_t m_mask;
+	// 队列槽位
+	Slot* m_slots;
+	// 生产者写入位置
+	std::atomic<uint64_t> m_tail{0};
+	// 消费者读取位置
+	std::atomic<uint64_t> m_head{0};
+	// 后台线程是否在等待
+	std::atomic<bool> m_waiting{false};
+	// 是否停止
+	std::atomic<bool> m_stopping{false};
+	// 被丢弃的日志条数
+	std::atomic<uint64_t> m_dropped{0};
+	// 被丢弃的DEBUG日志条数
+	std::atomic<uint64_t> m_droppedDebug{0};
+	// 唤醒后台线程
+	Semaphore m_sem;
+	// 后台线程
+	Thread::ptr m_thread;
+	// 唯一id, 用于线程缓存格式器
+	uint64_t m_id;
+};
+
+/**
+* @brief 以二进制格式输出到文件的Appender
+* @details 调用线程中不渲染文本, 每条日志只记录级别/时间差/线程id/协程id/调用位置id
+*          及原始消息. 文件名+行号、日志器名称、线程名称放在字符串表中, 每个文件只写一次.
+*          使用 ipmsg_logcat 按任意LogFormatter模板还原成文本
+*
+*  文件格式(整数为varint, 时间差为zigzag编码的varint):
+*      文件头  "IPMSGBIN" u8版本 u64秒 u32微秒 (小端)
+*      字符串  'S' id 类型(1文件位置 2日志器 3线程名) [行号] 长度 内容
+*      日志    'R' u8级别 时间差(微秒) 线程id 协程id 位置id 日志器id 线程名id 耗时 长度 消息
+*/
+class BinaryFileLogAppender : public LogAppender {
+public:
+	typedef std::shared_ptr<BinaryFileLogAppender> ptr;
+
+	/// 字符串表的类型
+	enum StringKind {
+		/// 文件名及行号
+		KIND_SITE = 1,
+		/// 日志器名称
+		KIND_LOGGER = 2,
+		/// 线程名称
+		KIND_THREAD = 3
+	};
+
+	BinaryFileLogAppender(const std::string& filename);
+
+	/**
+	* @brief 析构函数, 写出缓冲区中剩余的日志
+	*/
+	~BinaryFileLogAppender();
+
+	void append(Logger& logger, LogLevel::Level level, const LogEvent& event) override;
+	std::string toYamlString() override;
+
+	/**
+	* @brief 重新打开日志文件, 写入新的文件头并清空字符串表
+	* @return 成功返回true
+	*/
+	bool reopen();
+
+	/**
+	* @brief 将缓冲区中的日志写入文件
+	*/
+	void flush() override;
+
+	/**
+	* @brief 写入在缓冲区中停留超过1秒的日志, 由后台刷新线程调用
+	*/
+	void flushExpired(uint64_t now_ms) override;
+private:
+	/**
+	* @brief 写入文件头, 调用方持有锁
+	*/
+	void writeHeader(uint64_t sec, uint32_t usec);
+
+	/**
+	* @brief 返回字符串的id, 第一次出现时写入字符串表, 调用方持有锁
+	*/
+	uint32_t intern(std::unordered_map<std::string, uint32_t>& table
+			,StringKind kind, const std::string& str);
+
+	/**
+	* @brief 将缓冲区写入文件, 调用方持有锁
+	*/
+	void flushBuffer();
+private:
+	/**
+	* @brief 调用位置, 文件名为__FILE__的地址
+	*/
+	struct Site {
+		const char* file;
+		int32_t line;
+		bool operator==(const Site& o) const { return file == o.file && line == o.line; }
+	};
+	struct SiteHash {
+		size_t operator()(const Site& s) const {
+			return std::hash<const void*>()(s.file) ^ ((size_t)s.line << 1);
+		}
+	};
+
+	// 文件路径
+	std::string m_filename;
+	// 文件描述符
+	int m_fd = -1;
+	// 待写入的数据
+	std::string m_buf;
+	// 下一个字符串id
+	uint32_t m_nextId = 0;
+	// 上一条日志的时间(微秒)
+	uint64_t m_lastUs = 0;
+	// 上次写入文件的时间(秒)
+	uint64_t m_lastFlush = 0;
+	// 缓冲区中第一条日志的时间(毫秒), 0表示没有日志
+	uint64_t m_firstMs = 0;
+	// 调用位置表
+	std::unordered_map<Site, uint32_t, SiteHash> m_sites;
+	// 日志器名称表
+	std::unordered_map<std::string, uint32_t> m_loggers;
+	// 线程名称表
+	std::unordered_map<std::string, uint32_t> m_threads;
+};
+
+/**
+* @brief 读取BinaryFileLogAppender输出的文件
+*/
+class BinaryLogReader {
+public:
+	BinaryLogReader(const std::string& filename);
+
+	/**
+	* @brief 文件是否打开成功
+	*/
+	bool isOpen() const { return m_ifs.is_open(); }
+
+	/**
+	* @brief 文件格式是否有错误
+	*/
+	bool isError() const { return m_error; }
+
+	/**
+	* @brief 读取下一条日志
+	* @return 文件结束或格式错误时返回nullptr
+	*/
+	LogEvent::ptr next();
+private:
+	bool readVarint(uint64_t& v);
+	bool readString(std::string& str, size_t len);
+	bool readHeader();
+	bool readStringEntry();
+	const std::string* lookup(uint64_t id, int kind, int32_t* line = nullptr);
+private:
+	/**
+	* @brief 字符串表中的一项
+	*/
+	struct Entry {
+		int kind = 0;
+		int32_t line = 0;
+		const std::string* str = nullptr;
+	};
+
+	std::ifstream m_ifs;
+	bool m_error = false;
+	// 当前文件头之后的字符串表
+	std::vector<Entry> m_entries;
+	// 字符串的存储, 地址在读取期间保持不变
+	std::list<std::string> m_strings;
+	// 按名称创建的日志器
+	std::map<std::string, std::shared_ptr<Logger> > m_loggers;
+	// 上一条日志的时间(微秒)
+	uint64_t m_lastUs = 0;
+};
+
+
+/**
+* @brief 通过内存映射写文件的Appender
+* @details 文件按chunk_size分块用fallocate预分配并映射, 写日志的线程用原子游标
+*          预留互不重叠的区间后直接memcpy到映射区, 不加锁也没有系统调用.
+*          写满的块msync后解除映射. 文件末尾预分配但未写入的部分在析构时截掉,
+*          进程异常退出时文件末尾可能残留'\0', 下次打开时会跳过
+*/
+class MmapFileLogAppender : public LogAppender {
+public:
+	typedef std::shared_ptr<MmapFileLogAppender> ptr;
+
+	/**
+	* @brief 构造函数
+	* @param[in] filename 文件路径
+	* @param[in] chunk_size 每次预分配和映射的大小, 向上取整为页大小的整数倍
+	*/
+	MmapFileLogAppender(const std::string& filename, size_t chunk_size = 64 * 1024 * 1024);
+
+	/**
+	* @brief 析构函数, 解除映射并将文件截断到实际写入的长度
+	*/
+	~MmapFileLogAppender();
+
+	void append(Logger& logger, LogLevel::Level level, const LogEvent& event) override;
+	std::string toYamlString() override;
+
+	/**
+	* @brief 异步写回当前映射的块
+	*/
+	void flush() override;
+
+	/**
+	* @brief 返回已写入的字节数(文件的逻辑长度)
+	*/
+	uint64_t getSize() const { return m_cursor; }
+
+	size_t getChunkSize() const { return m_chunkSize; }
+private:
+	/**
+	* @brief 同时映射的块数, 写入超前这么多块时等待最旧的块写完
+	*/
+	static const size_t s_ring = 4;
+
+	/**
+	* @brief 一个映射的块
+	*/
+	struct Chunk {
+		/// 块编号加1, 0表示空闲
+		std::atomic<uint64_t> no{0};
+		/// 已写入的字节数, 等于块大小时解除映射
+		std::atomic<uint64_t> written{0};
+		char* addr = nullptr;
+	};
+
+	/**
+	* @brief 返回编号为no的块的映射地址, 需要时映射
+	* @return 重试后仍映射失败(如磁盘已满)时返回nullptr
+	*/
+	char* acquire(uint64_t no);
+
+	/**
+	* @brief 记录在块中写入了len字节, 写满时解除映射
+	*/
+	void commit(uint64_t no, size_t len);
+
+	/**
+	* @brief 记录块中有len字节因映射失败没有写入, 这部分计入块的写入量, 保证块最终能解除映射
+	*/
+	void lose(uint64_t no, size_t len);
+
+	/**
+	* @brief 解除映射, 调用方持有m_mapMutex
+	*/
+	void unmap(Chunk& chunk);
+private:
+	// 文件路径
+	std::string m_filename;
+	// 块大小
+	size_t m_chunkSize;
+	// 文件描述符
+	int m_fd = -1;
+	// 打开时文件的逻辑长度
+	uint64_t m_start = 0;
+	// 下一次写入的位置
+	std::atomic<uint64_t> m_cursor{0};
+	// 映射中的块
+	Chunk m_chunks[s_ring];
+	// 映射及解除映射时加锁
+	Mutex m_mapMutex;
+	// 尚未映射的块中因映射失败丢失的字节数, 映射时计入已写入
+	std::map<uint64_t, uint64_t> m_lost;
+	// 最近一次映射是否失败
+	std::atomic<bool> m_mapError{false};
+	// 唯一id, 用于线程缓存格式器
+	uint64_t m_id;
+};
+
+
+/**
+* @brief 飞行记录器, 在内存中保存每个线程最近的日志, 进程崩溃时写入文件
+* @details 每个线程一个定长槽位组成的环形缓冲区, 只由所属线程无锁写入, 正常运行时没有IO.
+*          每个槽位固定大小, 消息超长时截断. 收到SIGSEGV/SIGABRT/SIGBUS/SIGFPE/SIGILL时,
+*          信号处理函数只使用异步信号安全的调用, 写出调用栈和所有线程的记录后按默认方式退出
+*/
+class FlightRecorder {
+public:
+	/**
+	* @brief 记录一条日志
+	*/
+	static void Record(LogLevel::Level level, const LogEvent& event);
+
+	/**
+	* @brief 设置之后新建的线程缓冲区的槽位数
+	*/
+	static void SetCapacity(size_t slots);
+
+	/**
+	* @brief 设置崩溃时写入的文件, 并安装信号处理函数
+	*/
+	static void Install(const std::string& dump_file);
+
+	/**
+	* @brief 将所有线程的记录写到fd, 只使用异步信号安全的调用
+	*/
+	static void Dump(int fd);
+};
+
+/**
+* @brief 写入飞行记录器的Appender
+* @details 创建后所有日志器中不低于capture_level的日志都会被记录, 包括低于日志器级别的日志
+*/
+class FlightRecorderAppender : public LogAppender {
+public:
+	typedef std::shared_ptr<FlightRecorderAppender> ptr;
+
+	/**
+	* @brief 构造函数
+	* @param[in] dump_file 崩溃时写入的文件
+	* @param[in] slots 每个线程保存的日志条数
+	* @param[in] capture_level 记录的最低级别
+	*/
+	FlightRecorderAppender(const std::string& dump_file, size_t slots = 1024
+			,LogLevel::Level capture_level = LogLevel::DEBUG);
+
+	/**
+	* @brief 析构函数, 注销记录级别
+	*/
+	~FlightRecorderAppender();
+
+	void append(Logger& logger, LogLevel::Level level, const LogEvent& event) override;
+	std::string toYamlString() override;
+private:
+	// 崩溃时写入的文件
+	std::string m_file;
+	// 每个线程保存的日志条数
+	size_t m_slots;
+	// 记录的最低级别
+	LogLevel::Level m_captureLevel;
+};
+
+/**
+* @brief 通过数据报套接字发送日志的Appender, UdpLogAppender和UnixSocketLogAppender的公共部分
+* @details 多条格式化后的日志拼接成一个数据报, 加入下一条会超过batch_bytes时封包;
+*          封好的包攒满一批, 或最早的日志停留超过flush_ms(由后台刷新线程检查)时,
+*          用一次sendmmsg全部发出. 套接字是非阻塞的, 接收方来不及处理(EAGAIN)
+*          或不可达时丢弃并计数, 写日志的线程不会被阻塞. 地址在构造时解析,
+*          连接失败或连接被拒绝后每秒最多重连一次
+*/
+class DatagramLogAppender : public LogAppender {
+public:
+	typedef std::shared_ptr<DatagramLogAppender> ptr;
+
+	/**
+	* @brief 析构函数, 发出剩余的日志
+	*/
+	~DatagramLogAppender();
+
+	void append(Logger& logger, LogLevel::Level level, const LogEvent& event) override;
+
+	/**
+	* @brief 立即发出已缓冲的日志
+	*/
+	void flush() override;
+
+	void flushExpired(uint64_t now_ms) override;
+
+	/**
+	* @brief 返回已发出的日志条数
+	*/
+	uint64_t getSent() const { return m_sent; }
+
+	/**
+	* @brief 返回因发送失败被丢弃的日志条数
+	*/
+	uint64_t getDropped() const { return m_dropped; }
+
+	const std::string& getAddress() const { return m_address; }
+	size_t getBatchBytes() const { return m_batchBytes; }
+	uint32_t getFlushMs() const { return m_flushMs; }
+protected:
+	/**
+	* @brief 构造函数
+	* @param[in] family AF_INET/AF_INET6(由address解析得到时传AF_UNSPEC)或AF_UNIX
+	* @param[in] address UDP为"host:port", Unix域套接字为路径
+	* @param[in] batch_bytes 单个数据报的目标大小
+	* @param[in] flush_ms 日志最长停留时间(毫秒)
+	*/
+	DatagramLogAppender(int family, const std::string& address
+			,size_t batch_bytes, uint32_t flush_ms);
+
+	/**
+	* @brief 输出共同的YAML配置
+	*/
+	std::string buildYaml(const char* type);
+private:
+	/**
+	* @brief 一个封好的数据报
+	*/
+	struct Packet {
+		std::string data;
+		uint32_t records = 0;
+	};
+
+	/**
+	* @brief 将当前正在拼接的数据报封包, 调用方持有m_mutex
+	*/
+	void seal();
+
+	/**
+	* @brief 发出所有封好的数据报, 调用方持有m_mutex
+	*/
+	void send();
+
+	/**
+	* @brief 创建套接字并连接, 调用方持有m_mutex
+	*/
+	bool connect();
+private:
+	/// 一次sendmmsg最多发送的数据报数
+	static const size_t s_maxPackets = 32;
+
+	// 地址
+	std::string m_address;
+	// 解析后的地址
+	struct sockaddr_storage m_addr;
+	socklen_t m_addrLen = 0;
+	// 套接字, 未连接时为-1
+	int m_fd = -1;
+	// 上次连接失败的时间(毫秒)
+	uint64_t m_retryMs = 0;
+	size_t m_batchBytes;
+	uint32_t m_flushMs;
+	// 正在拼接的数据报
+	std::string m_cur;
+	uint32_t m_curRecords = 0;
+	// 单条日志的格式化缓冲
+	std::string m_record;
+	// 封好的数据报, 前m_count个有效, 其余的保留容量以便复用
+	std::vector<Packet> m_packets;
+	size_t m_count = 0;
+	// 缓冲中最早的日志的时间(毫秒)
+	uint64_t m_firstMs = 0;
+	std::atomic<uint64_t> m_sent{0};
+	std::atomic<uint64_t> m_dropped{0};
+};
+
+/**
+* @brief 发送到UDP地址的Appender, 例如本机的日志收集器
+*/
+class UdpLogAppender : public DatagramLogAppender {
+public:
+	typedef std::shared_ptr<UdpLogAppender> ptr;
+
+	/// 默认的数据报大小, 不超过以太网MTU
+	static const size_t DEFAULT_BATCH_BYTES = 1400;
+
+	/**
+	* @brief 构造函数
+	* @param[in] address "host:port", IPv6地址写作"[::1]:514"
+	* @param[in] batch_bytes 单个数据报的目标大小
+	* @param[in] flush_ms 日志最长停留时间(毫秒)
+	*/
+	UdpLogAppender(const std::string& address, size_t batch_bytes = DEFAULT_BATCH_BYTES, uint32_t flush_ms = 100);
+
+	std::string toYamlString() override;
+};
+
+/**
+* @brief 发送到Unix域数据报套接字的Appender
+*/
+class UnixSocketLogAppender : public DatagramLogAppender {
+public:
+	typedef std::shared_ptr<UnixSocketLogAppender> ptr;
+
+	/// 默认的数据报大小
+	static const size_t DEFAULT_BATCH_BYTES = 16 * 1024;
+
+	/**
+	* @brief 构造函数
+	* @param[in] path 接收方绑定的套接字路径
+	* @param[in] batch_bytes 单个数据报的目标大小
+	* @param[in] flush_ms 日志最长停留时间(毫秒)
+	*/
+	UnixSocketLogAppender(const std::string& path, size_t batch_bytes = DEFAULT_BATCH_BYTES, uint32_t flush_ms = 100);
+
+	std::string toYamlString() override;
+};
+
 
 /**
  * @brief  日志器管理类
@@ -566,9 +2343,10 @@ public:
 
 	/**
 	* @brief 获取日志器
+	* @details 日志器创建后不会被删除, 返回的引用一直有效, 直接使用时不复制智能指针
 	* @param[in] name 日志器名称
 	*/
-	Logger::ptr getLogger(const std::string& name);
+	const Logger::ptr& getLogger(const std::string& name);
 
 	/**
 	 * @brief 初始化
@@ -579,16 +2357,43 @@ public:
 	 * @date  2020-12-25 20:50
 	 * @brief 返回主日志器
 	 */
-	Logger::ptr getRoot() const { return m_root; }
+	const Logger::ptr& getRoot() const { return m_root; }
 
     /**
      * @brief 将所有的日志器配置转成YAML String
      */
 	std::string toYamlString();
+
+	/**
+	 * @brief 将所有日志器及其日志目标的统计数据转成YAML String
+	 */
+	std::string toMetricsYamlString();
+
+	/**
+	 * @brief 将所有日志器及其日志目标的统计数据转成JSON
+	 */
+	std::string toMetricsJson();
+
+	/**
+	 * @brief 将统计数据转成Prometheus文本格式, 指标名以ipmsg_log_开头
+	 */
+	std::string toPrometheus();
+
+	/**
+	 * @brief 写出所有日志器中缓冲的日志
+	 */
+	void flush();
 private:
+	/**
+	 * @brief 返回所有日志器的副本
+	 */
+	std::vector<Logger::ptr> getLoggers();
+
     MutexType m_mutex;
-	/// 日志器容器
+	/// 日志器容器, 只在持有m_mutex时修改
 	std::map<std::string, Logger::ptr> m_loggers;
+	/// 日志器容器的只读快照, 值指向m_loggers中的元素, getLogger在RCU读临界区内无锁查找
+	std::atomic<const std::unordered_map<std::string, const Logger::ptr*>*> m_snapshot{nullptr};
 	/// 主日志器
 	Logger::ptr m_root;
 };
@@ -0,0 +1,140 @@
+#include "rcu.h"
+#include "thread.h"
+#include <vector>
+#include <sched.h>
+
+namespace ipmsg {
+
+/**
+ * @brief 每个线程的读者记录
+ * @details 记录只增不删, 线程退出后标记为空闲, 由新线程复用;
+ *          记录归还后所属线程不再访问
+ */
+struct RcuReader {
+    /// 读者进入时的纪元, 0表示不在临界区
+    std::atomic<uint64_t> epoch{0};
+    /// 是否被线程占用
+    std::atomic<bool> used{true};
+    /// 嵌套层数, 只由所属线程访问
+    uint32_t nesting = 0;
+    RcuReader* next = nullptr;
+};
+
+/// 全局纪元, 从1开始
+static std::atomic<uint64_t> s_epoch{1};
+/// 所有读者记录组成的单链表
+static std::atomic<RcuReader*> s_readers{nullptr};
+
+static RcuReader* AcquireReader() {
+    for(RcuReader* r = s_readers.load(); r; r = r->next) {
+        bool expect = false;
+        if(!r->used.load(std::memory_order_relaxed)
+                && r->used.compare_exchange_strong(expect, true)) {
+            return r;
+        }
+    }
+    RcuReader* r = new RcuReader;
+    r->next = s_readers.load();
+    while(!s_readers.compare_exchange_weak(r->next, r));
+    return r;
+}
+
+/// 当前线程的读者记录, 用普通指针避免每次都经过thread_local对象的初始化检查
+static thread_local RcuReader* t_reader = nullptr;
+/// 当前线程的RcuReaderHolder已析构, 之后(如其他thread_local的析构函数中)
+/// 进入临界区时临时取得记录, 离开时立即归还
+static thread_local bool t_destroyed = false;
+
+/**
+ * @brief 线程退出时释放读者记录
+ */
+struct RcuReaderHolder {
+    ~RcuReaderHolder() {
+        t_destroyed = true;
+        /// 仍在临界区内时由最外层的ReadUnlock归还
+        if(t_reader && t_reader->nesting == 0) {
+            t_reader->used.store(false);
+            t_reader = nullptr;
+        }
+    }
+};
+
+static RcuReader* GetReader() {
+    if(!t_reader) {
+        t_reader = AcquireReader();
+        if(!t_destroyed) {
+            static thread_local RcuReaderHolder s_holder;
+            (void)s_holder;
+        }
+    }
+    return t_reader;
+}
+
+void Rcu::ReadLock() {
+    RcuReader* r = GetReader();
+    if(r->nesting++ == 0) {
+        /// seq_cst: 保证写者能看到本线程的纪元, 或本线程能看到写者替换后的指针
+        r->epoch.store(s_epoch.load());
+    }
+}
+
+void Rcu::ReadUnlock() {
+    RcuReader* r = t_reader;
+    if(--r->nesting == 0) {
+        r->epoch.store(0, std::memory_order_release);
+        if(t_destroyed) {
+            r->used.store(false);
+            t_reader = nullptr;
+        }
+    }
+}
+
+void Rcu::Synchronize() {
+    uint64_t target = s_epoch.fetch_add(1) + 1;
+    for(RcuReader* r = s_readers.load(); r; r = r->next) {
+        while(true) {
+            uint64_t e = r->epoch.load();
+            if(e == 0 || e >= target) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+bool Rcu::InReadSection() {
+    return t_reader && t_reader->nesting > 0;
+}
+
+/**
+ * @brief 等待释放的对象, 静态初始化期间也可能使用, 故不用全局变量
+ */
+struct RcuRetired {
+    Mutex mutex;
+    std::vector<std::pair<void*, void (*)(void*)> > list;
+};
+
+static RcuRetired& GetRetired() {
+    static RcuRetired* s_retired = new RcuRetired;
+    return *s_retired;
+}
+
+void Rcu::Retire(void* ptr, void (*deleter)(void*)) {
+    RcuRetired& retired = GetRetired();
+    std::vector<std::pair<void*, void (*)(void*)> > list;
+    {
+        Mutex::Lock lock(retired.mutex);
+        retired.list.push_back(std::make_pair(ptr, deleter));
+        if(InReadSection()) {
+            return;
+        }
+        list.swap(retired.list);
+    }
+    /// 列表中的对象在此之前都已不可见, 等待宽限期后释放
+    Synchronize();
+    for(auto& i : list) {
+        i.second(i.first);
+    }
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef __RCU_H__
+#define __RCU_H__
+
+#include <atomic>
+#include <stdint.h>
+
+namespace ipmsg {
+
+/**
+ * @brief 基于纪元(epoch)的RCU
+ * @details 读者进入临界区时记录当前纪元, 不加锁也不写共享的缓存行;
+ *          写者原子地替换指针后调用Synchronize, 等待替换前进入的读者全部离开,
+ *          之后即可安全释放旧数据. 读临界区可以嵌套, 但不能在读临界区内调用Synchronize
+ */
+class Rcu {
+public:
+    /**
+     * @brief 进入读临界区
+     */
+    static void ReadLock();
+
+    /**
+     * @brief 离开读临界区
+     */
+    static void ReadUnlock();
+
+    /**
+     * @brief 等待调用前进入读临界区的线程全部离开
+     */
+    static void Synchronize();
+
+    /**
+     * @brief 当前线程是否在读临界区内
+     */
+    static bool InReadSection();
+
+    /**
+     * @brief 延迟释放已经不再可见的对象
+     * @details 在读临界区外调用时等待宽限期结束, 并释放包括之前积累的所有对象;
+     *          在读临界区内调用时(此时不能等待自己)只加入待释放列表, 由之后的调用释放
+     */
+    static void Retire(void* ptr, void (*deleter)(void*));
+
+    template<class T>
+    static void Retire(T* ptr) {
+        Retire(ptr, [](void* p) { delete (T*)p; });
+    }
+};
+
+/**
+ * @brief 读临界区的RAII封装
+ */
+class RcuReadLock {
+public:
+    RcuReadLock() {
+        Rcu::ReadLock();
+    }
+    ~RcuReadLock() {
+        Rcu::ReadUnlock();
+    }
+private:
+    RcuReadLock(const RcuReadLock&) = delete;
+    RcuReadLock& operator=(const RcuReadLock&) = delete;
+};
+
+}
+
+#endif
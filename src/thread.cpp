@@ -1,6 +1,7 @@
 #include "thread.h"
 #include "log.h"
 #include "util.h"
+#include <errno.h>
 namespace ipmsg {
 
 /// thread_local关键字修饰的变量具有线程周期，在线程开始的时候被生成，在线程结束的时候被销毁
@@ -25,9 +26,11 @@ Semaphore::~Semaphore() {
 void Semaphore::wait() {
 
     // std::cout << "Enter wait" << std::endl;
-    /* return 0 on success */
-    if(sem_wait(&m_semaphore)) {
-        throw std::logic_error("sem_wait error");
+    /* return 0 on success, sem_wait is never restarted after a signal handler */
+    while(sem_wait(&m_semaphore)) {
+        if(errno != EINTR) {
+            throw std::logic_error("sem_wait error");
+        }
     }
     // std::cout << "Finish wait" << std::endl;
 
@@ -109,6 +112,7 @@ void* Thread::run(void* arg) {
     // std::cout << "run start" << std::endl;
     Thread* thread = (Thread*)arg;
     t_thread = thread;
+    t_thread_name = thread->m_name;
     thread->m_id = ipmsg::GetThreadId();
     pthread_setname_np(pthread_self(), thread->m_name.substr(0, 15).c_str()); /// 为线程设置名称, pthread_setname_np 只支持16位字符
 
@@ -118,6 +122,8 @@ void* Thread::run(void* arg) {
     thread->m_semaphore.notify(); /// static 方法里面，用类实例来访问
     /* In order to prevent M_ CB is empty , we must be assigned to M_CB in the constructor*/
     cb();
+    /// 线程退出前写出本线程缓冲的日志
+    FileLogAppender::FlushThreadBuffers();
     // std::cout << "run finish" << std::endl;
     return 0;
 }
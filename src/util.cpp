@@ -3,13 +3,27 @@
 #include <sys/types.h> // pid_t
 #include <unistd.h> // syscall
 #include <execinfo.h>
+#include <pthread.h>
 #include "ipmsg.h"
 namespace ipmsg {
 
 ipmsg::Logger::ptr g_logger = LOG_NAME("system");
 
+/// 缓存的线程id, 避免每条日志都进行一次系统调用
+static thread_local pid_t t_thread_id = 0;
+
+static void ResetThreadId() {
+	/// fork出的子进程中线程id改变
+	t_thread_id = 0;
+}
+
 pid_t GetThreadId() {
-	return syscall(static_cast<long>(SYS_gettid));
+	if (!t_thread_id) {
+		static int s_atfork = pthread_atfork(nullptr, nullptr, ResetThreadId);
+		(void)s_atfork;
+		t_thread_id = syscall(static_cast<long>(SYS_gettid));
+	}
+	return t_thread_id;
 }
 
 uint32_t GetFiberId() {
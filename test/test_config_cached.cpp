@@ -0,0 +1,87 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <time.h>
+#include <sched.h>
+
+static ipmsg::ConfigVar<int>::ptr g_int =
+    ipmsg::Config::Lookup("cached.int", (int)1, "cached int");
+
+static ipmsg::ConfigVar<std::vector<int> >::ptr g_vec =
+    ipmsg::Config::Lookup("cached.vec", std::vector<int>(16, 1), "cached vec");
+
+static ipmsg::ConfigVar<std::string>::ptr g_str =
+    ipmsg::Config::Lookup("cached.str", std::string("a"), "cached str");
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/// 修改任意配置后缓存刷新, 其他线程的修改可见
+void test_refresh() {
+    ipmsg::ConfigVar<int>::Cached c_int(g_int);
+    ipmsg::ConfigVar<std::vector<int> >::Cached c_vec(g_vec);
+    assert(*c_int == 1);
+    assert(c_vec->size() == 16);
+
+    uint64_t epoch = ipmsg::ConfigVarBase::GetEpoch();
+    g_int->setValue(1);
+    /// 值没有变化时不更新纪元
+    assert(ipmsg::ConfigVarBase::GetEpoch() == epoch);
+    g_int->setValue(2);
+    assert(ipmsg::ConfigVarBase::GetEpoch() > epoch);
+    assert(*c_int == 2);
+    g_str->setValue("b");
+    assert(*c_int == 2 && c_vec->front() == 1);
+
+    YAML::Node root = YAML::Load("cached:\n  int: 3\n  vec: [7, 8]\n");
+    ipmsg::Config::LoadFromYaml(root);
+    assert(*c_int == 3);
+    assert(c_vec->size() == 2 && c_vec->back() == 8);
+
+    std::atomic<int> seen{0};
+    ipmsg::Thread::ptr t(new ipmsg::Thread([&seen]() {
+        static thread_local ipmsg::ConfigVar<int>::Cached s_int(g_int);
+        while(*s_int != 4) {
+            sched_yield();
+        }
+        seen = *s_int;
+    }, "cached_reader"));
+    g_int->setValue(4);
+    t->join();
+    assert(seen == 4);
+    std::cout << "refresh ok" << std::endl;
+}
+
+template<class F>
+static double bench(F read) {
+    const int n = 50 * 1000 * 1000;
+    int64_t sum = 0;
+    uint64_t start = now_ns();
+    for(int i = 0; i < n; ++i) {
+        sum += read();
+        asm volatile("" : "+r"(sum));
+    }
+    return (now_ns() - start) / (double)n;
+}
+
+void test_bench() {
+    int local = g_int->getValue();
+    ipmsg::ConfigVar<int>::Cached c_int(g_int);
+    ipmsg::ConfigVar<std::vector<int> >::Cached c_vec(g_vec);
+    ipmsg::ConfigVar<std::string>::Cached c_str(g_str);
+    std::cout << "local int:        " << bench([&local]() { return local; }) << " ns/read" << std::endl;
+    std::cout << "Cached int:       " << bench([&c_int]() { return *c_int; }) << " ns/read" << std::endl;
+    std::cout << "getValue int:     " << bench([]() { return g_int->getValue(); }) << " ns/read" << std::endl;
+    std::cout << "Cached vector:    " << bench([&c_vec]() { return c_vec->back(); }) << " ns/read" << std::endl;
+    std::cout << "getSnapshot vector: " << bench([]() { return g_vec->getSnapshot()->back(); }) << " ns/read" << std::endl;
+    std::cout << "Cached string:    " << bench([&c_str]() { return c_str->size(); }) << " ns/read" << std::endl;
+    std::cout << "getValue string:  " << bench([]() { return g_str->getValue().size(); }) << " ns/read" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_refresh();
+    test_bench();
+    return 0;
+}
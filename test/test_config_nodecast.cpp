@@ -0,0 +1,88 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <time.h>
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief 节点直接转换与经过字符串的转换结果相同
+ */
+template<class T>
+static T check_same(const std::string& yaml) {
+    YAML::Node node = YAML::Load(yaml);
+    T a = ipmsg::NodeCast<T>()(node);
+    std::stringstream ss;
+    ss << node;
+    T b = ipmsg::LexicalCast<std::string, T>()(ss.str());
+    assert(a == b);
+    return a;
+}
+
+void test_cast() {
+    assert(check_same<int>("42") == 42);
+    assert(check_same<std::string>("hello world") == "hello world");
+    assert(check_same<std::vector<int> >("[1, 2, 3]").size() == 3);
+    assert(check_same<std::list<float> >("[1.5, 2.5]").back() == 2.5f);
+    assert(check_same<std::set<int> >("[3, 1, 3]").size() == 2);
+    assert(check_same<std::unordered_set<std::string> >("[a, b, a]").count("b") == 1);
+    assert(check_same<std::vector<std::vector<int> > >("[[1], [2, 3], []]")[1][1] == 3);
+    auto m = check_same<std::map<std::string, std::vector<int> > >("{a: [1, 2], b: []}");
+    assert(m["a"][1] == 2 && m["b"].empty());
+    auto um = check_same<std::unordered_map<std::string, std::map<std::string, int> > >(
+            "{x: {k: 1}, y: {k: 2, j: 3}}");
+    assert(um["y"]["j"] == 3);
+    assert(check_same<std::vector<int> >("").empty());
+
+    /// 转换失败抛出异常, fromNode返回false并保留原值
+    auto var = ipmsg::Config::Lookup("nodecast.vec", std::vector<int>({9}));
+    assert(!var->fromNode(YAML::Load("[1, x]")));
+    assert(var->getValue() == std::vector<int>({9}));
+    assert(var->fromNode(YAML::Load("[4, 5]")));
+    assert(var->getValue() == std::vector<int>({4, 5}));
+    std::cout << "cast ok" << std::endl;
+}
+
+template<class T>
+static void bench(const char* name, const YAML::Node& node) {
+    uint64_t start = now_ns();
+    std::stringstream ss;
+    ss << node;
+    T a = ipmsg::LexicalCast<std::string, T>()(ss.str());
+    uint64_t lexical = now_ns() - start;
+    start = now_ns();
+    T b = ipmsg::NodeCast<T>()(node);
+    uint64_t direct = now_ns() - start;
+    assert(a == b);
+    std::cout << name << ": LexicalCast " << lexical / 1000 << " us, NodeCast "
+        << direct / 1000 << " us" << std::endl;
+}
+
+void test_bench() {
+    std::stringstream ss;
+    ss << "[";
+    for(int i = 0; i < 20000; ++i) {
+        ss << (i ? ", " : "") << i;
+    }
+    ss << "]";
+    bench<std::vector<int> >("vector<int> x20000", YAML::Load(ss.str()));
+
+    ss.str("");
+    for(int i = 0; i < 500; ++i) {
+        ss << "k" << i << ": [";
+        for(int j = 0; j < 20; ++j) {
+            ss << (j ? ", " : "") << i * j;
+        }
+        ss << "]\n";
+    }
+    bench<std::map<std::string, std::vector<int> > >("map<string, vector<int>> 500x20", YAML::Load(ss.str()));
+}
+
+int main(int argc, char** argv) {
+    test_cast();
+    test_bench();
+    return 0;
+}
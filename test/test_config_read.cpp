@@ -0,0 +1,142 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <iomanip>
+
+static ipmsg::ConfigVar<int>::ptr g_int =
+    ipmsg::Config::Lookup("bench.int", (int)1, "bench int");
+
+static ipmsg::ConfigVar<std::vector<int> >::ptr g_vec =
+    ipmsg::Config::Lookup("bench.vec", std::vector<int>(64, 0), "bench vec");
+
+static ipmsg::ConfigVar<std::map<std::string, int> >::ptr g_map =
+    ipmsg::Config::Lookup("bench.map", std::map<std::string, int>(), "bench map");
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/// 读者看到的快照内容始终一致, 写入后新值可见, 监听器收到新旧值
+void test_consistency() {
+    int calls = 0;
+    uint64_t id = g_vec->addListener([&calls](const std::vector<int>& old_value
+                , const std::vector<int>& new_value) {
+        assert(old_value.size() == new_value.size());
+        assert(old_value[0] + 1 == new_value[0]);
+        ++calls;
+    });
+    const int writes = 200;
+    std::atomic<bool> stop{false};
+    std::vector<ipmsg::Thread::ptr> thrs;
+    for(int i = 0; i < 4; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([&stop]() {
+            int last = 0;
+            while(!stop) {
+                ipmsg::ConfigVar<std::vector<int> >::Snapshot s = g_vec->getSnapshot();
+                for(auto v : *s) {
+                    assert(v == s->front());
+                }
+                /// 值单调增加
+                assert(s->front() >= last);
+                last = s->front();
+            }
+        }, "reader_" + std::to_string(i))));
+    }
+    for(int i = 1; i <= writes; ++i) {
+        g_vec->setValue(std::vector<int>(64, i));
+    }
+    stop = true;
+    for(auto& t : thrs) {
+        t->join();
+    }
+    g_vec->delListener(id);
+    assert(calls == writes);
+    assert(g_vec->getValue() == std::vector<int>(64, writes));
+
+    g_int->setValue(5);
+    assert(g_int->getValue() == 5 && *g_int->getSnapshot() == 5);
+    g_map->fromString("{a: 1, b: 2}");
+    assert(g_map->getSnapshot()->at("b") == 2);
+    assert(YAML::Load(g_map->toString())["a"].as<int>() == 1);
+    std::cout << "consistency ok" << std::endl;
+}
+
+/**
+ * @brief 原先的实现: 读写锁保护, 返回副本
+ */
+template<class T>
+class LockedValue {
+public:
+    LockedValue(const T& v) :m_val(v) {}
+    const T getValue() {
+        ipmsg::RWMutex::ReadLock lock(m_mutex);
+        return m_val;
+    }
+private:
+    T m_val;
+    ipmsg::RWMutex m_mutex;
+};
+
+static LockedValue<int> s_locked_int(1);
+static LockedValue<std::vector<int> > s_locked_vec(std::vector<int>(64, 0));
+
+/**
+ * @brief 多个线程同时读取, 返回每秒总读取次数
+ */
+template<class F>
+static double bench(int threads, F read) {
+    const uint64_t duration = 100 * 1000 * 1000ull;
+    std::vector<ipmsg::Thread::ptr> thrs;
+    std::vector<uint64_t> counts(threads * 8, 0);
+    std::atomic<bool> stop{false};
+    uint64_t start = now_ns();
+    for(int i = 0; i < threads; ++i) {
+        uint64_t* count = &counts[i * 8];
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([&stop, count, &read]() {
+            uint64_t n = 0;
+            int64_t sum = 0;
+            while(!stop.load(std::memory_order_relaxed)) {
+                for(int j = 0; j < 64; ++j) {
+                    sum += read();
+                }
+                n += 64;
+            }
+            *count = n + (sum == -1);
+        }, "bench_" + std::to_string(i))));
+    }
+    while(now_ns() - start < duration) {
+        usleep(10 * 1000);
+    }
+    stop = true;
+    for(auto& t : thrs) {
+        t->join();
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+    uint64_t total = 0;
+    for(int i = 0; i < threads; ++i) {
+        total += counts[i * 8];
+    }
+    return total / elapsed;
+}
+
+void test_bench() {
+    std::cout << "threads\tint(atomic)\tint(rwlock)\tvec(snapshot)\tvec(getValue)\tvec(rwlock)  [reads/sec]" << std::endl;
+    for(int threads = 1; threads <= 64; threads *= 2) {
+        double a = bench(threads, []() { return g_int->getValue(); });
+        double b = bench(threads, []() { return s_locked_int.getValue(); });
+        double c = bench(threads, []() { return g_vec->getSnapshot()->back(); });
+        double d = bench(threads, []() { return g_vec->getValue().back(); });
+        double e = bench(threads, []() { return s_locked_vec.getValue().back(); });
+        std::cout << threads << std::fixed << std::setprecision(0)
+            << "\t" << a << "\t" << b << "\t" << c << "\t" << d << "\t" << e << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    test_consistency();
+    test_bench();
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <time.h>
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static const int s_sections = 100;
+static const int s_keys = 50;
+
+static std::vector<ipmsg::ConfigVar<int>::ptr> s_ints;
+static std::vector<ipmsg::ConfigVar<std::vector<int> >::ptr> s_vecs;
+
+/**
+ * @brief 生成s_sections * s_keys个整数配置及s_sections个数组配置
+ * @param[in] changed 值加1的整数配置下标, -1表示不修改
+ */
+static YAML::Node make_doc(int changed) {
+    std::stringstream ss;
+    ss << "reload:\n";
+    for(int i = 0; i < s_sections; ++i) {
+        ss << "  s" << i << ":\n";
+        for(int j = 0; j < s_keys; ++j) {
+            int idx = i * s_keys + j;
+            ss << "    k" << j << ": " << idx + (idx == changed) << "\n";
+        }
+        ss << "    list: [" << i << ", " << i + 1 << ", " << i + 2 << "]\n";
+    }
+    return YAML::Load(ss.str());
+}
+
+static void register_vars() {
+    for(int i = 0; i < s_sections; ++i) {
+        std::string section = "reload.s" + std::to_string(i);
+        for(int j = 0; j < s_keys; ++j) {
+            s_ints.push_back(ipmsg::Config::Lookup(section + ".k" + std::to_string(j), (int)-1));
+        }
+        s_vecs.push_back(ipmsg::Config::Lookup(section + ".list", std::vector<int>()));
+    }
+}
+
+/// 只转换来源子树变化的配置参数
+void test_incremental() {
+    register_vars();
+    YAML::Node doc = make_doc(-1);
+    uint64_t start = now_ns();
+    size_t n = ipmsg::Config::LoadFromYaml(doc);
+    uint64_t full = now_ns() - start;
+    assert(n == s_ints.size() + s_vecs.size());
+    assert(s_ints[123]->getValue() == 123);
+    assert(s_vecs[7]->getValue() == std::vector<int>({7, 8, 9}));
+
+    /// 相同内容重新加载不转换
+    assert(ipmsg::Config::LoadFromYaml(make_doc(-1)) == 0);
+
+    /// 只修改一个值
+    doc = make_doc(4321);
+    start = now_ns();
+    n = ipmsg::Config::LoadFromYaml(doc);
+    uint64_t incremental = now_ns() - start;
+    assert(n == 1);
+    assert(s_ints[4321]->getValue() == 4322);
+    assert(s_ints[4320]->getValue() == 4320);
+
+    /// 程序修改过的值, 即使文件没有变化也重新加载
+    s_ints[10]->setValue(-10);
+    assert(ipmsg::Config::LoadFromYaml(doc) == 1);
+    assert(s_ints[10]->getValue() == 10);
+
+    /// 恢复原值
+    assert(ipmsg::Config::LoadFromYaml(make_doc(-1)) == 1);
+    assert(s_ints[4321]->getValue() == 4321);
+
+    /// 新注册的参数即使所在子树没有变化也会加载
+    auto extra = ipmsg::Config::Lookup("reload.s3.extra", (int)0);
+    doc = YAML::Clone(make_doc(-1));
+    doc["reload"]["s3"]["extra"] = 5;
+    assert(ipmsg::Config::LoadFromYaml(doc) == 1);
+    assert(extra->getValue() == 5);
+    start = now_ns();
+    assert(ipmsg::Config::LoadFromYaml(doc) == 0);
+    uint64_t unchanged = now_ns() - start;
+    std::cout << "unchanged " << unchanged / 1000 << " us" << std::endl;
+    std::cout << "incremental ok: " << s_ints.size() + s_vecs.size() << " vars, full "
+        << full / 1000 << " us, one change " << incremental / 1000 << " us" << std::endl;
+}
+
+/// 父子节点都有配置参数, 子节点变化时父节点也重新加载; 序列内部的键不当作配置名
+void test_nested() {
+    auto parent = ipmsg::Config::Lookup("nested.map", std::map<std::string, int>());
+    auto child = ipmsg::Config::Lookup("nested.map.a", (int)0);
+    auto top = ipmsg::Config::Lookup("top", (int)7);
+    auto list = ipmsg::Config::Lookup("nested.list", std::vector<std::map<std::string, int> >());
+    std::vector<std::string> order;
+    parent->addListener([&order](const std::map<std::string, int>&, const std::map<std::string, int>&) {
+        order.push_back("parent");
+    });
+    child->addListener([&order](const int&, const int&) {
+        order.push_back("child");
+    });
+
+    assert(ipmsg::Config::LoadFromYaml(YAML::Load(
+            "nested: {map: {a: 1, b: 2}, list: [{top: 1}, {top: 2}]}")) == 3);
+    assert(order.size() == 2 && order[0] == "parent" && order[1] == "child");
+    assert(parent->getValue().at("b") == 2 && child->getValue() == 1);
+    assert(list->getValue().size() == 2 && list->getValue()[1].at("top") == 2);
+    assert(top->getValue() == 7);
+
+    order.clear();
+    assert(ipmsg::Config::LoadFromYaml(YAML::Load(
+            "nested: {map: {a: 1, b: 3}, list: [{top: 1}, {top: 2}]}")) == 1);
+    assert(order.size() == 1 && order[0] == "parent");
+    assert(ipmsg::Config::LoadFromYaml(YAML::Load(
+            "nested: {map: {a: 1, b: 3}, list: [{top: 1}, {top: 3}]}")) == 1);
+    assert(list->getValue()[1].at("top") == 3 && top->getValue() == 7);
+    std::cout << "nested ok" << std::endl;
+}
+
+/// 加载时回调函数修改的其他参数, 下次加载时即使所在子树没有变化也恢复为文件中的值
+void test_listener_set() {
+    auto other = ipmsg::Config::Lookup("cb.other.x", (int)0);
+    auto trigger = ipmsg::Config::Lookup("cb.trigger", (int)0);
+    trigger->addListener([other](const int&, const int&) {
+        other->setValue(99);
+    });
+    YAML::Node doc = YAML::Load("cb: {other: {x: 5}, trigger: 1}");
+    assert(ipmsg::Config::LoadFromYaml(doc) == 2);
+    assert(other->getValue() == 99);
+    assert(ipmsg::Config::LoadFromYaml(doc) == 1);
+    assert(other->getValue() == 5);
+    assert(ipmsg::Config::LoadFromYaml(doc) == 0);
+    std::cout << "listener set ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_incremental();
+    test_nested();
+    test_listener_set();
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <fstream>
+
+static ipmsg::ConfigVar<int>::ptr g_port =
+    ipmsg::Config::Lookup("watch.port", (int)0, "watch port");
+
+static ipmsg::ConfigVar<std::vector<std::string> >::ptr g_hosts =
+    ipmsg::Config::Lookup("watch.hosts", std::vector<std::string>(), "watch hosts");
+
+static ipmsg::ConfigVar<int>::ptr g_extra =
+    ipmsg::Config::Lookup("watch.extra", (int)0, "watch extra");
+
+static void write_file(const std::string& path, const std::string& content) {
+    std::ofstream ofs(path, std::ios::trunc);
+    ofs << content;
+}
+
+/// 先写临时文件再rename, 编辑器常用的保存方式
+static void replace_file(const std::string& path, const std::string& content) {
+    write_file(path + ".tmp", content);
+    assert(rename((path + ".tmp").c_str(), path.c_str()) == 0);
+}
+
+/**
+ * @brief 等待条件成立, 最多2秒
+ */
+template<class F>
+static bool wait_for(F cond) {
+    for(int i = 0; i < 200; ++i) {
+        if(cond()) {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return cond();
+}
+
+int main(int argc, char** argv) {
+    char tmpl[] = "/tmp/test_config_watcher_XXXXXX";
+    std::string dir = mkdtemp(tmpl);
+    std::string file = dir + "/app.yml";
+    write_file(file, "watch:\n  port: 80\n  hosts: [a, b]\n");
+
+    int changes = 0;
+    g_port->addListener([&changes](const int& old_value, const int& new_value) {
+        ++changes;
+    });
+
+    {
+        ipmsg::ConfigWatcher watcher(50);
+        assert(watcher.addPath(file));
+        assert(!watcher.addPath(dir + "/missing.yml"));
+        assert(watcher.start());
+        assert(g_port->getValue() == 80);
+        assert(g_hosts->getValue().size() == 2);
+
+        /// 修改后自动加载, 并通过回调通知
+        write_file(file, "watch:\n  port: 81\n  hosts: [a, b]\n");
+        assert(wait_for([]() { return g_port->getValue() == 81; }));
+        assert(changes == 2);
+
+        /// 连续多次修改合并为一次加载
+        uint64_t reloads = watcher.getStats().reloads;
+        for(int i = 0; i < 10; ++i) {
+            write_file(file, "watch:\n  port: " + std::to_string(100 + i) + "\n  hosts: [a, b]\n");
+        }
+        assert(wait_for([]() { return g_port->getValue() == 109; }));
+        usleep(200 * 1000);
+        ipmsg::ConfigWatcher::Stats stats = watcher.getStats();
+        assert(stats.reloads - reloads <= 2);
+        assert(stats.events >= 11);
+        std::cout << "debounce: 10 writes -> " << stats.reloads - reloads << " reload(s), latency "
+            << stats.latency_us << " us, parse " << stats.parse_us << " us, apply "
+            << stats.apply_us << " us" << std::endl;
+
+        /// 解析失败保留原值
+        uint64_t failures = stats.failures;
+        write_file(file, "watch:\n  port: [unclosed\n");
+        assert(wait_for([&watcher, failures]() { return watcher.getStats().failures > failures; }));
+        assert(g_port->getValue() == 109);
+
+        /// rename方式保存
+        replace_file(file, "watch:\n  port: 200\n  hosts: [c]\n");
+        assert(wait_for([]() { return g_port->getValue() == 200; }));
+        assert(g_hosts->getValue() == std::vector<std::string>({"c"}));
+
+        /// 监控目录: 新增文件, 按文件名顺序合并
+        std::string conf_d = dir + "/conf.d";
+        assert(mkdir(conf_d.c_str(), 0755) == 0);
+        assert(watcher.addPath(conf_d));
+        write_file(conf_d + "/10-extra.yml", "watch:\n  extra: 1\n");
+        write_file(conf_d + "/20-port.yaml", "watch:\n  port: 300\n");
+        write_file(conf_d + "/ignored.txt", "watch:\n  port: 400\n");
+        assert(wait_for([]() { return g_extra->getValue() == 1 && g_port->getValue() == 300; }));
+        /// 同一Map下的其他键保留
+        assert(g_hosts->getValue() == std::vector<std::string>({"c"}));
+        usleep(200 * 1000);
+        assert(g_port->getValue() == 300);
+
+        /// 只修改其中一个logger, 没有变化的logger保持不变
+        std::string logs = dir + "/logs.yml";
+        write_file(logs, "logs:\n  - name: watch_aa\n    level: info\n"
+                "  - name: watch_bb\n    level: info\n");
+        assert(watcher.addPath(logs));
+        assert(watcher.reload());
+        assert(LOG_NAME("watch_aa")->getLevel() == ipmsg::LogLevel::INFO);
+        write_file(logs, "logs:\n  - name: watch_aa\n    level: info\n"
+                "  - name: watch_bb\n    level: error\n");
+        assert(wait_for([]() { return LOG_NAME("watch_bb")->getLevel() == ipmsg::LogLevel::ERROR; }));
+        assert(LOG_NAME("watch_aa")->getLevel() == ipmsg::LogLevel::INFO);
+        /// 删除的logger被关闭
+        write_file(logs, "logs:\n  - name: watch_bb\n    level: error\n");
+        assert(wait_for([]() { return LOG_NAME("watch_aa")->getLevel() > ipmsg::LogLevel::FATAL; }));
+        assert(LOG_NAME("watch_bb")->getLevel() == ipmsg::LogLevel::ERROR);
+        unlink(logs.c_str());
+
+        unlink((conf_d + "/10-extra.yml").c_str());
+        unlink((conf_d + "/20-port.yaml").c_str());
+        unlink((conf_d + "/ignored.txt").c_str());
+        rmdir(conf_d.c_str());
+        watcher.stop();
+    }
+
+    /// 停止后不再加载
+    write_file(file, "watch:\n  port: 500\n");
+    usleep(200 * 1000);
+    assert(g_port->getValue() != 500);
+    unlink(file.c_str());
+    rmdir(dir.c_str());
+    std::cout << "watcher ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <new>
+#include <stdlib.h>
+
+/**
+ *  统计operator new的调用次数, 验证稳定运行时写日志不再分配内存
+ */
+static thread_local bool t_counting = false;
+static thread_local uint64_t t_allocs = 0;
+
+void* operator new(size_t size) {
+    if(t_counting) {
+        ++t_allocs;
+    }
+    void* p = malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+/**
+ * @brief 丢弃所有输出的流缓冲区
+ */
+class NullStreamBuf : public std::streambuf {
+protected:
+    int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char* s, std::streamsize n) override { return n; }
+};
+
+/**
+ * @brief 格式化后丢弃的Appender
+ */
+class NullLogAppender : public ipmsg::LogAppender {
+public:
+    NullLogAppender()
+        :m_os(&m_buf) {}
+    void log(ipmsg::Logger::ptr logger, ipmsg::LogLevel::Level level, ipmsg::LogEvent::ptr event) override {
+        if(level >= m_level) {
+            MutexType::Lock lock(m_mutex);
+            m_formatter->format(m_os, logger, level, event);
+        }
+    }
+    std::string toYamlString() override { return ""; }
+private:
+    NullStreamBuf m_buf;
+    std::ostream m_os;
+};
+
+void write_logs(ipmsg::Logger::ptr logger, int n) {
+    for(int i = 0; i < n; ++i) {
+        LOG_INFO(logger) << "alloc test " << i << " value=" << 3.14 << ' ' << std::string("str");
+        LOG_DEBUG(logger) << "alloc debug " << i;
+        LOG_FMT_INFO(logger, "alloc fmt %d %s", i, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+    }
+}
+
+int main(int argc, char** argv) {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("alloc"));
+    logger->addAppender(ipmsg::LogAppender::ptr(new NullLogAppender));
+
+    /// 预热: 填充事件池, 初始化时区等
+    write_logs(logger, 100);
+
+    t_counting = true;
+    write_logs(logger, 10000);
+    t_counting = false;
+
+    std::cout << "allocations during 30000 log statements: " << t_allocs << std::endl;
+    assert(t_allocs == 0);
+
+    /// 异步Appender: 调用线程复用格式化缓冲区, 与队列槽位交换字符串
+    ipmsg::Logger::ptr async(new ipmsg::Logger("alloc_async"));
+    ipmsg::AsyncLogAppender::ptr appender(new ipmsg::AsyncLogAppender("/dev/null", 64));
+    async->addAppender(appender);
+    write_logs(async, 10000);
+    appender->flush();
+
+    t_allocs = 0;
+    t_counting = true;
+    write_logs(async, 10000);
+    t_counting = false;
+    appender->flush();
+    std::cout << "allocations during 30000 async log statements: " << t_allocs << std::endl;
+    assert(t_allocs == 0);
+    async->clearAppenders();
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <fstream>
+#include <unistd.h>
+
+static const char* s_file = "./async_log.txt";
+
+static size_t count_lines(const char* file) {
+    std::ifstream ifs(file);
+    std::string line;
+    size_t n = 0;
+    while(std::getline(ifs, line)) {
+        ++n;
+    }
+    return n;
+}
+
+void test_block(int threads, int lines) {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("async"));
+    ipmsg::AsyncLogAppender::ptr appender(new ipmsg::AsyncLogAppender(s_file, 64));
+    logger->addAppender(appender);
+
+    std::vector<ipmsg::Thread::ptr> thrs;
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([logger, lines]() {
+            for(int j = 0; j < lines; ++j) {
+                LOG_INFO(logger) << "async block " << j;
+            }
+        }, "async_" + std::to_string(i))));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    appender->flush();
+
+    size_t n = count_lines(s_file);
+    std::cout << "block: lines=" << n << " dropped=" << appender->getDropped() << std::endl;
+    assert(n == (size_t)threads * lines);
+    assert(appender->getDropped() == 0);
+}
+
+void test_drop(ipmsg::AsyncLogAppender::OverflowPolicy policy, int lines) {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("async"));
+    ipmsg::AsyncLogAppender::ptr appender(new ipmsg::AsyncLogAppender(s_file, 16, policy));
+    logger->addAppender(appender);
+
+    for(int j = 0; j < lines; ++j) {
+        LOG_DEBUG(logger) << "async debug " << j;
+        LOG_INFO(logger) << "async info " << j;
+    }
+    appender->flush();
+
+    size_t n = count_lines(s_file);
+    std::cout << ipmsg::AsyncLogAppender::PolicyToString(policy)
+              << ": lines=" << n << " dropped=" << appender->getDropped()
+              << " dropped_debug=" << appender->getDroppedDebug() << std::endl;
+    assert(n + appender->getDropped() == (size_t)lines * 2);
+    if(policy == ipmsg::AsyncLogAppender::DROP_DEBUG_FIRST) {
+        assert(appender->getDropped() == appender->getDroppedDebug());
+    }
+}
+
+/// 无法识别的策略回退为不阻塞的drop_newest
+void test_policy() {
+    assert(ipmsg::AsyncLogAppender::PolicyFromString("") == ipmsg::AsyncLogAppender::BLOCK);
+    assert(ipmsg::AsyncLogAppender::PolicyFromString("block") == ipmsg::AsyncLogAppender::BLOCK);
+    assert(ipmsg::AsyncLogAppender::PolicyFromString("drop_oldest") == ipmsg::AsyncLogAppender::DROP_NEWEST);
+    std::cout << "policy ok" << std::endl;
+}
+
+/// 文件不变时不重新打开, 被删除后重新创建
+void test_reopen() {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("async"));
+    ipmsg::AsyncLogAppender::ptr appender(new ipmsg::AsyncLogAppender(s_file, 64));
+    logger->addAppender(appender);
+    for(int i = 0; i < 3; ++i) {
+        LOG_INFO(logger) << "async reopen " << i;
+        appender->flush();
+        usleep(1100 * 1000);
+    }
+    assert(appender->getMetrics().reopens == 0);
+    unlink(s_file);
+    LOG_INFO(logger) << "async reopen after unlink";
+    appender->flush();
+    assert(count_lines(s_file) == 1);
+    assert(appender->getMetrics().reopens == 1);
+    std::cout << "reopen ok" << std::endl;
+}
+
+/// 线程缓存的格式器在setFormatter之后更新
+void test_formatter() {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("async"));
+    ipmsg::AsyncLogAppender::ptr appender(new ipmsg::AsyncLogAppender(s_file, 64));
+    appender->setFormatter(ipmsg::LogFormatter::ptr(new ipmsg::LogFormatter("a %m%n")));
+    logger->addAppender(appender);
+    LOG_INFO(logger) << "one";
+    appender->setFormatter(ipmsg::LogFormatter::ptr(new ipmsg::LogFormatter("b %m%n")));
+    LOG_INFO(logger) << "two";
+    appender->flush();
+    std::ifstream ifs(s_file);
+    std::string a, b;
+    std::getline(ifs, a);
+    std::getline(ifs, b);
+    assert(a == "a one" && b == "b two");
+    std::cout << "formatter ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_formatter();
+    test_policy();
+    test_reopen();
+    test_block(4, 10000);
+    test_drop(ipmsg::AsyncLogAppender::DROP_NEWEST, 10000);
+    test_drop(ipmsg::AsyncLogAppender::DROP_DEBUG_FIRST, 10000);
+    unlink(s_file);
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <unistd.h>
+
+static const char* s_file = "./binary_log.bin";
+static const char* s_pattern = "%d{%Y-%m-%d %H:%M:%S}.%f%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+
+/// 写入二进制日志后读回, 与直接格式化的文本逐条比较
+void test_roundtrip(int threads, int lines) {
+    unlink(s_file);
+    ipmsg::LogFormatter::ptr fmt(new ipmsg::LogFormatter(s_pattern));
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("binary"));
+    ipmsg::Logger::ptr other(new ipmsg::Logger("binary.other"));
+    ipmsg::BinaryFileLogAppender::ptr appender(new ipmsg::BinaryFileLogAppender(s_file));
+    logger->addAppender(appender);
+    other->addAppender(appender);
+
+    std::vector<std::string> expect[8];
+    std::vector<ipmsg::Thread::ptr> thrs;
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([&, i]() {
+            std::string out;
+            for(int j = 0; j < lines; ++j) {
+                ipmsg::LogEvent::ptr event = ipmsg::LogEvent::Create(j % 2 ? logger : other
+                        ,ipmsg::LogLevel::INFO, __FILE__, __LINE__, 0, ipmsg::GetThreadId()
+                        ,ipmsg::GetFiberId(), time(0), ipmsg::Thread::GetName());
+                event->getSS() << "binary line " << j << " from " << i;
+                out.clear();
+                fmt->format(out, ipmsg::LogLevel::INFO, *event);
+                expect[i].push_back(out);
+                event->getLogger()->log(ipmsg::LogLevel::INFO, event);
+            }
+        }, "binary_" + std::to_string(i))));
+    }
+    for(auto& t : thrs) {
+        t->join();
+    }
+    appender->flush();
+
+    std::vector<size_t> pos(threads, 0);
+    size_t total = 0;
+    ipmsg::BinaryLogReader reader(s_file);
+    assert(reader.isOpen());
+    std::string out;
+    while(ipmsg::LogEvent::ptr event = reader.next()) {
+        out.clear();
+        fmt->format(out, event->getLevel(), *event);
+        const std::string& content = event->getContent();
+        int i = atoi(content.c_str() + content.rfind(' ') + 1);
+        assert(i >= 0 && i < threads);
+        assert(out == expect[i][pos[i]++]);
+        ++total;
+    }
+    assert(!reader.isError());
+    assert(total == (size_t)threads * lines);
+    std::cout << "roundtrip threads=" << threads << " lines=" << total << " ok" << std::endl;
+}
+
+/// reopen 写入新的文件头, 字符串表重新开始
+void test_reopen() {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("binary"));
+    ipmsg::BinaryFileLogAppender::ptr appender(new ipmsg::BinaryFileLogAppender(s_file));
+    logger->addAppender(appender);
+    for(int i = 0; i < 3; ++i) {
+        LOG_INFO(logger) << "before reopen " << i;
+    }
+    appender->reopen();
+    for(int i = 0; i < 3; ++i) {
+        LOG_INFO(logger) << "after reopen " << i;
+    }
+    appender->flush();
+
+    ipmsg::BinaryLogReader reader(s_file);
+    size_t n = 0;
+    while(ipmsg::LogEvent::ptr event = reader.next()) {
+        assert(event->getLogger()->getName() == "binary");
+        assert(event->getContent().find(n < 3 ? "before" : "after") == 0);
+        ++n;
+    }
+    assert(!reader.isError() && n == 6);
+    std::cout << "reopen ok" << std::endl;
+}
+
+/// 没有后续日志时, 缓冲区中的日志也会在停留时间上限后由后台线程写入文件
+void test_flush_timer() {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("binary_timer"));
+    ipmsg::BinaryFileLogAppender::ptr appender(new ipmsg::BinaryFileLogAppender(s_file));
+    logger->addAppender(appender);
+    LOG_INFO(logger) << "first";
+    LOG_INFO(logger) << "tail";
+    usleep(2500 * 1000);
+
+    size_t total = 0;
+    ipmsg::BinaryLogReader reader(s_file);
+    while(ipmsg::LogEvent::ptr event = reader.next()) {
+        ++total;
+    }
+    assert(total == 2);
+    logger->clearAppenders();
+    std::cout << "flush timer ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_roundtrip(1, 1000);
+    test_roundtrip(4, 5000);
+    test_reopen();
+    test_flush_timer();
+    unlink(s_file);
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+static const char* s_file = "./buffer_log.txt";
+
+static std::vector<std::string> read_lines() {
+    std::vector<std::string> lines;
+    std::ifstream ifs(s_file);
+    std::string line;
+    while(std::getline(ifs, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+static uint64_t now_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+/// 线程退出时写出缓冲, 每个线程的日志保持顺序
+void test_order(int threads, int lines) {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("buffer"));
+    ipmsg::FileLogAppender::ptr appender(new ipmsg::FileLogAppender(s_file));
+    appender->setFormatter(ipmsg::LogFormatter::ptr(new ipmsg::LogFormatter("%m%n")));
+    appender->setBuffer(4096, 1000);
+    logger->addAppender(appender);
+
+    std::vector<ipmsg::Thread::ptr> thrs;
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([logger, lines, i]() {
+            for(int j = 0; j < lines; ++j) {
+                LOG_INFO(logger) << i << " " << j;
+            }
+        }, "buffer_" + std::to_string(i))));
+    }
+    for(auto& t : thrs) {
+        t->join();
+    }
+
+    std::vector<int> next(threads, 0);
+    auto all = read_lines();
+    for(auto& l : all) {
+        int i = 0, j = 0;
+        sscanf(l.c_str(), "%d %d", &i, &j);
+        assert(j == next[i]++);
+    }
+    assert(all.size() == (size_t)threads * lines);
+    std::cout << "order threads=" << threads << " lines=" << all.size() << " ok" << std::endl;
+}
+
+/// 不满一个缓冲区的日志在停留时间上限后由后台线程写出, 也可以显式flush
+void test_latency() {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger = LOG_NAME("buffer_latency");
+    ipmsg::FileLogAppender::ptr appender(new ipmsg::FileLogAppender(s_file));
+    appender->setBuffer(64 * 1024, 50);
+    logger->addAppender(appender);
+
+    LOG_INFO(logger) << "latency";
+    assert(read_lines().empty());
+    usleep(300 * 1000);
+    assert(read_lines().size() == 1);
+
+    LOG_INFO(logger) << "explicit";
+    ipmsg::LoggerMgr::GetInstance()->flush();
+    assert(read_lines().size() == 2);
+    logger->clearAppenders();
+    std::cout << "latency ok" << std::endl;
+}
+
+/// 反复替换Appender(如重新加载配置), 旧Appender析构时写出缓冲, 线程中残留的缓冲区被回收
+void test_replace() {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("buffer_replace"));
+    const int n = 500;
+    for(int i = 0; i < n; ++i) {
+        ipmsg::FileLogAppender::ptr appender(new ipmsg::FileLogAppender(s_file));
+        appender->setFormatter(ipmsg::LogFormatter::ptr(new ipmsg::LogFormatter("%m%n")));
+        appender->setBuffer(4096, 1000);
+        logger->clearAppenders();
+        logger->addAppender(appender);
+        LOG_INFO(logger) << i;
+    }
+    logger->clearAppenders();
+    auto all = read_lines();
+    assert(all.size() == (size_t)n);
+    for(int i = 0; i < n; ++i) {
+        assert(atoi(all[i].c_str()) == i);
+    }
+    std::cout << "replace ok" << std::endl;
+}
+
+/// 有缓冲与无缓冲的吞吐对比
+void bench(size_t buffer, int threads, int lines) {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("buffer"));
+    ipmsg::FileLogAppender::ptr appender(new ipmsg::FileLogAppender(s_file));
+    appender->setBuffer(buffer);
+    logger->addAppender(appender);
+
+    uint64_t start = now_us();
+    std::vector<ipmsg::Thread::ptr> thrs;
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([logger, lines]() {
+            for(int j = 0; j < lines; ++j) {
+                LOG_INFO(logger) << "buffered bench line " << j;
+            }
+        }, "bench_" + std::to_string(i))));
+    }
+    for(auto& t : thrs) {
+        t->join();
+    }
+    uint64_t used = now_us() - start;
+    std::cout << "buffer=" << buffer << " threads=" << threads
+              << " ns/line=" << used * 1000 / ((uint64_t)threads * lines) << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_order(1, 10000);
+    test_order(8, 10000);
+    test_latency();
+    test_replace();
+    for(int threads = 1; threads <= 8; threads *= 2) {
+        bench(0, threads, 100000 / threads);
+        bench(8192, threads, 100000 / threads);
+    }
+    unlink(s_file);
+    return 0;
+}
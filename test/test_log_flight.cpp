@@ -0,0 +1,159 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+
+static const char* s_dump = "./flight_dump.txt";
+
+static std::string read_file(const char* file) {
+    std::ifstream ifs(file);
+    return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+static size_t count(const std::string& str, const std::string& sub) {
+    size_t n = 0;
+    for(size_t pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+/// 子进程记录低于日志器级别的DEBUG日志后abort, 信号处理函数写出最近的记录
+void test_crash() {
+    unlink(s_dump);
+    pid_t pid = fork();
+    if(pid == 0) {
+        ipmsg::Logger::ptr logger = LOG_NAME("flight");
+        logger->setLevel(ipmsg::LogLevel::ERROR);
+        logger->addAppender(ipmsg::FlightRecorderAppender::ptr(
+                    new ipmsg::FlightRecorderAppender(s_dump, 8)));
+        for(int i = 0; i < 20; ++i) {
+            LOG_DEBUG(logger) << "flight debug " << i;
+        }
+        ipmsg::Thread::ptr thr(new ipmsg::Thread([logger]() {
+            LOG_INFO(logger) << "flight from thread";
+        }, "flight_thr"));
+        thr->join();
+        abort();
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+    std::string dump = read_file(s_dump);
+    assert(dump.find("signal 6") == 0);
+    assert(dump.find("backtrace:") != std::string::npos);
+    /// 每个线程只保留最近8条
+    assert(count(dump, "flight debug ") == 8);
+    assert(dump.find("flight debug 11\n") == std::string::npos);
+    assert(dump.find("[DEBUG]\t[flight]") != std::string::npos);
+    assert(dump.find("flight debug 19\n") != std::string::npos);
+    assert(dump.find("flight_thr (exited)") != std::string::npos);
+    assert(dump.find("flight from thread\n") != std::string::npos);
+    std::cout << "crash dump ok" << std::endl;
+}
+
+/// 超长消息截断
+void test_truncate() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("flight_long"));
+    logger->setLevel(ipmsg::LogLevel::ERROR);
+    ipmsg::Logger::SetCaptureLevel(ipmsg::LogLevel::DEBUG);
+    LOG_DEBUG(logger) << std::string(1000, 'x');
+    ipmsg::Logger::SetCaptureLevel((ipmsg::LogLevel::Level)100);
+
+    int fd = open(s_dump, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ipmsg::FlightRecorder::Dump(fd);
+    close(fd);
+    std::string dump = read_file(s_dump);
+    assert(dump.find("xxx...\n") != std::string::npos);
+    assert(dump.find(std::string(200, 'x')) == std::string::npos);
+    std::cout << "truncate ok" << std::endl;
+}
+
+/// 记录级别取所有FlightRecorderAppender中最低的, 删除后恢复
+void test_capture_level() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("flight_level"));
+    logger->setLevel(ipmsg::LogLevel::ERROR);
+    assert(logger->getMinLevel() == ipmsg::LogLevel::ERROR);
+    {
+        ipmsg::FlightRecorderAppender::ptr info(
+                new ipmsg::FlightRecorderAppender(s_dump, 8, ipmsg::LogLevel::INFO));
+        assert(logger->getMinLevel() == ipmsg::LogLevel::INFO);
+        {
+            ipmsg::FlightRecorderAppender::ptr debug(
+                    new ipmsg::FlightRecorderAppender(s_dump, 8, ipmsg::LogLevel::DEBUG));
+            assert(logger->getMinLevel() == ipmsg::LogLevel::DEBUG);
+            /// 后创建的级别较高的不覆盖
+            ipmsg::FlightRecorderAppender::ptr warn(
+                    new ipmsg::FlightRecorderAppender(s_dump, 8, ipmsg::LogLevel::WARN));
+            assert(logger->getMinLevel() == ipmsg::LogLevel::DEBUG);
+        }
+        assert(logger->getMinLevel() == ipmsg::LogLevel::INFO);
+    }
+    assert(logger->getMinLevel() == ipmsg::LogLevel::ERROR);
+    std::cout << "capture level ok" << std::endl;
+}
+
+/// 其他线程仍在写日志时转储, 每条记录的内容都完整, 不会混入覆盖中的新内容
+void test_concurrent_dump() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("flight_dump"));
+    logger->setLevel(ipmsg::LogLevel::ERROR);
+    ipmsg::FlightRecorderAppender::ptr recorder(
+            new ipmsg::FlightRecorderAppender(s_dump, 4, ipmsg::LogLevel::DEBUG));
+    std::atomic<bool> stop{false};
+    ipmsg::Thread::ptr thr(new ipmsg::Thread([logger, &stop]() {
+        for(int i = 0; !stop; ++i) {
+            LOG_DEBUG(logger) << "<" << std::string(150, 'a' + i % 26) << ">";
+        }
+    }, "flight_writer"));
+    for(int n = 0; n < 200; ++n) {
+        int fd = open(s_dump, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ipmsg::FlightRecorder::Dump(fd);
+        close(fd);
+        std::string dump = read_file(s_dump);
+        for(size_t pos = dump.find('<'); pos != std::string::npos; pos = dump.find('<', pos + 1)) {
+            assert(dump.size() > pos + 151 && dump[pos + 151] == '>');
+            assert(dump.compare(pos + 1, 150, std::string(150, dump[pos + 1])) == 0);
+        }
+    }
+    stop = true;
+    thr->join();
+    std::cout << "concurrent dump ok" << std::endl;
+}
+
+void bench() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("flight_bench"));
+    logger->setLevel(ipmsg::LogLevel::ERROR);
+    const int n = 1000000;
+    struct timeval begin, end;
+    gettimeofday(&begin, nullptr);
+    for(int i = 0; i < n; ++i) {
+        LOG_DEBUG(logger) << "flight bench " << i;
+    }
+    gettimeofday(&end, nullptr);
+    uint64_t used = (end.tv_sec - begin.tv_sec) * 1000000ul + end.tv_usec - begin.tv_usec;
+    std::cout << "disabled: " << used * 1000.0 / n << " ns/line" << std::endl;
+
+    ipmsg::Logger::SetCaptureLevel(ipmsg::LogLevel::DEBUG);
+    gettimeofday(&begin, nullptr);
+    for(int i = 0; i < n; ++i) {
+        LOG_DEBUG(logger) << "flight bench " << i;
+    }
+    gettimeofday(&end, nullptr);
+    ipmsg::Logger::SetCaptureLevel((ipmsg::LogLevel::Level)100);
+    used = (end.tv_sec - begin.tv_sec) * 1000000ul + end.tv_usec - begin.tv_usec;
+    std::cout << "recorded: " << used * 1000.0 / n << " ns/line" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_crash();
+    test_truncate();
+    test_capture_level();
+    test_concurrent_dump();
+    bench();
+    unlink(s_dump);
+    return 0;
+}
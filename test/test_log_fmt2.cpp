@@ -0,0 +1,124 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <string.h>
+#include <sys/time.h>
+
+/// 格式串与参数不匹配时编译期即可发现
+static_assert(decltype(ipmsg::LogFmt::ArgTypes(1, "a"))::Check("%d %s", 0), "int and string");
+static_assert(!decltype(ipmsg::LogFmt::ArgTypes(1))::Check("%s", 0), "int as string");
+static_assert(!decltype(ipmsg::LogFmt::ArgTypes(1.5))::Check("%d", 0), "double as int");
+static_assert(!decltype(ipmsg::LogFmt::ArgTypes(1, 2))::Check("%d", 0), "too many arguments");
+static_assert(!decltype(ipmsg::LogFmt::ArgTypes(1))::Check("%d %d", 0), "too few arguments");
+static_assert(!decltype(ipmsg::LogFmt::ArgTypes(1))::Check("%*d", 0), "* width");
+static_assert(decltype(ipmsg::LogFmt::ArgTypes(1))::Check("100%% %lld", 0), "escaped percent");
+
+/**
+ * @brief 保存最后一条日志内容的Appender
+ */
+class LastLogAppender : public ipmsg::LogAppender {
+public:
+    typedef std::shared_ptr<LastLogAppender> ptr;
+    void log(ipmsg::Logger::ptr logger, ipmsg::LogLevel::Level level, ipmsg::LogEvent::ptr event) override {
+        m_last = event->getContent();
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::string m_last;
+};
+
+template<class... Args>
+static std::string fmt2(const char* fmt, const Args&... args) {
+    std::string out;
+    ipmsg::LogFmt::Format(out, fmt, args...);
+    return out;
+}
+
+template<class... Args>
+static std::string fmt1(const char* fmt, const Args&... args) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), fmt, args...);
+    return buf;
+}
+
+/// 输出与snprintf一致
+#define CHECK_FMT(fmt, ...) \
+    do { \
+        std::string a = fmt2(fmt, __VA_ARGS__); \
+        std::string b = fmt1(fmt, __VA_ARGS__); \
+        if(a != b) { \
+            std::cout << "mismatch " << fmt << ": [" << a << "] != [" << b << "]" << std::endl; \
+            assert(false); \
+        } \
+    } while(0)
+
+void test_format() {
+    CHECK_FMT("%d", 0);
+    CHECK_FMT("%d|%i", -123456789, 42);
+    CHECK_FMT("%lld", (long long)INT64_MIN);
+    CHECK_FMT("%llu", (unsigned long long)UINT64_MAX);
+    CHECK_FMT("%5d|%-5d|%05d|%+d|% d", 42, 42, -42, 42, 42);
+    CHECK_FMT("%.3d|%8.3d|%.0d", 7, -7, 0);
+    CHECK_FMT("%x|%X|%#x|%08x|%o|%#o", 255u, 255u, 255u, 48879u, 8u, 8u);
+    CHECK_FMT("%c%c", 'o', 'k');
+    CHECK_FMT("%f|%.2f|%10.3f|%-10.1f|%e|%g", 3.14159, 2.5, -1.0, 0.25, 12345.678, 0.0001);
+    CHECK_FMT("%s|%10s|%-10s|%.3s", "abc", "right", "left", "truncate");
+    CHECK_FMT("%p", (void*)0x1234);
+    CHECK_FMT("100%% %d%%", 5);
+    assert(fmt2("%s=%zu", std::string("size"), (size_t)10) == "size=10");
+    assert(fmt2("%s", (const char*)nullptr) == "(null)");
+    std::cout << "format ok" << std::endl;
+}
+
+void test_macro() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("fmt2"));
+    LastLogAppender::ptr ap(new LastLogAppender);
+    logger->addAppender(ap);
+    std::string name = "peer";
+    LOG_FMT2_INFO(logger, "%s connected fd=%d rtt=%.1fms", name, 12, 0.75);
+    assert(ap->m_last == "peer connected fd=12 rtt=0.8ms");
+    /// 与旧的printf方式写入相同的内容
+    LOG_FMT_INFO(logger, "%s connected fd=%d rtt=%.1fms", name.c_str(), 12, 0.75);
+    assert(ap->m_last == "peer connected fd=12 rtt=0.8ms");
+    logger->setLevel(ipmsg::LogLevel::ERROR);
+    LOG_FMT2_INFO(logger, "%d", 1);
+    assert(ap->m_last == "peer connected fd=12 rtt=0.8ms");
+    std::cout << "macro ok" << std::endl;
+}
+
+static uint64_t now_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+/// 同样的内容分别用LOG_FMT和LOG_FMT2格式化
+void bench() {
+    const int n = 1000000;
+    std::string out;
+    out.reserve(256);
+    const char* name = "session";
+    uint64_t start = now_us();
+    for(int i = 0; i < n; ++i) {
+        out.clear();
+        ipmsg::LogFmt::Format(out, "%s id=%d seq=%llu len=%u", name, i, (unsigned long long)i * 7919, (unsigned)i & 0xffff);
+    }
+    uint64_t used2 = now_us() - start;
+
+    char buf[256];
+    start = now_us();
+    for(int i = 0; i < n; ++i) {
+        out.clear();
+        int len = snprintf(buf, sizeof(buf), "%s id=%d seq=%llu len=%u", name, i, (unsigned long long)i * 7919, (unsigned)i & 0xffff);
+        out.append(buf, len);
+    }
+    uint64_t used1 = now_us() - start;
+    std::cout << "snprintf: " << used1 * 1000.0 / n << " ns/call, "
+              << "LogFmt: " << used2 * 1000.0 / n << " ns/call" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_format();
+    test_macro();
+    bench();
+    return 0;
+}
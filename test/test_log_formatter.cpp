@@ -0,0 +1,137 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <time.h>
+
+/**
+ *  对比FormatItem逐项格式化与编译后的指令序列, 输出必须逐字节相同
+ */
+static const char* s_default_pattern = "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+
+static const char* s_patterns[] = {
+    s_default_pattern,
+    "%m", "%p", "%r", "%c", "%t", "%n", "%d", "%f", "%l", "%T", "%F", "%N",
+    "%d{%H:%M:%S}%T%d{%Y}",
+    "%d{%Y-%m-%d %H:%M:%S.%L}%T%m",
+    "%d{%s.%f}|%d{%%L %L %f}",
+    "[%p] plain text %% with percent%n",
+    "%x unknown item",
+    "%d{unterminated",
+    "%m%n%T%n%T%m",
+    "no items at all",
+    "%J", "%J{%s}%n",
+};
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static ipmsg::LogEvent::ptr make_event(ipmsg::Logger::ptr logger, ipmsg::LogLevel::Level level) {
+    ipmsg::LogEvent::ptr event = ipmsg::LogEvent::Create(logger, level, __FILE__, __LINE__, 12345
+            ,ipmsg::GetThreadId(), 67, time(0), ipmsg::Thread::GetName());
+    event->getSS() << "formatter test message " << 42 << " " << -7 << " " << 3.5;
+    return event;
+}
+
+void test_identical() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("formatter"));
+    ipmsg::LogLevel::Level levels[] = {ipmsg::LogLevel::DEBUG, ipmsg::LogLevel::INFO
+            ,ipmsg::LogLevel::WARN, ipmsg::LogLevel::ERROR, ipmsg::LogLevel::FATAL};
+    for(auto pattern : s_patterns) {
+        ipmsg::LogFormatter::ptr fmt(new ipmsg::LogFormatter(pattern));
+        for(auto level : levels) {
+            auto event = make_event(logger, level);
+            std::stringstream ss;
+            fmt->formatItems(ss, logger, level, event);
+
+            std::string compiled;
+            fmt->format(compiled, level, *event);
+
+            std::stringstream os;
+            fmt->format(os, logger, level, event);
+
+            /// 缓冲区不足时截断, 返回完整长度
+            char small[8];
+            size_t len = fmt->format(small, sizeof(small), level, *event);
+
+            if(ss.str() != compiled || ss.str() != os.str()
+                    || len != compiled.size()
+                    || compiled.compare(0, std::min(len, sizeof(small)), small, std::min(len, sizeof(small))) != 0) {
+                std::cout << "mismatch pattern=" << pattern << std::endl
+                          << "items   =[" << ss.str() << "]" << std::endl
+                          << "compiled=[" << compiled << "]" << std::endl;
+                assert(false);
+            }
+        }
+    }
+    std::cout << "compiled formatter output identical for "
+              << sizeof(s_patterns) / sizeof(s_patterns[0]) << " patterns" << std::endl;
+}
+
+/**
+ *  按秒缓存的时间格式, 在秒数变化时必须重新渲染
+ */
+void test_date_cache() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("formatter"));
+    ipmsg::LogFormatter::ptr fmt(new ipmsg::LogFormatter("%d{%Y-%m-%d %H:%M:%S}"));
+    ipmsg::LogFormatter::ptr ms_fmt(new ipmsg::LogFormatter("%d{%S.%L|%f}"));
+    uint64_t base = time(0);
+    for(uint64_t sec = base; sec < base + 5; ++sec) {
+        for(int k = 0; k < 2; ++k) {
+            ipmsg::LogEvent::ptr event = ipmsg::LogEvent::Create(logger, ipmsg::LogLevel::INFO
+                    ,__FILE__, __LINE__, 0, 0, 0, sec, ipmsg::Thread::GetName());
+            std::string out;
+            fmt->format(out, ipmsg::LogLevel::INFO, *event);
+
+            struct tm tm;
+            time_t t = sec;
+            localtime_r(&t, &tm);
+            char buf[64];
+            strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+            assert(out == buf);
+
+            std::string ms;
+            ms_fmt->format(ms, ipmsg::LogLevel::INFO, *event);
+            char expect[64];
+            snprintf(expect, sizeof(expect), "%02d.%03u|%06u", tm.tm_sec
+                    ,event->getUsec() / 1000, event->getUsec());
+            assert(ms == expect);
+        }
+    }
+    std::cout << "date cache ok" << std::endl;
+}
+
+void bench(int n) {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("formatter"));
+    ipmsg::LogFormatter::ptr fmt(new ipmsg::LogFormatter(s_default_pattern));
+    auto event = make_event(logger, ipmsg::LogLevel::INFO);
+
+    std::stringstream ss;
+    uint64_t begin = now_ns();
+    for(int i = 0; i < n; ++i) {
+        ss.str("");
+        fmt->formatItems(ss, logger, ipmsg::LogLevel::INFO, event);
+    }
+    uint64_t items_ns = now_ns() - begin;
+
+    char buf[512];
+    size_t total = 0;
+    begin = now_ns();
+    for(int i = 0; i < n; ++i) {
+        total += fmt->format(buf, sizeof(buf), ipmsg::LogLevel::INFO, *event);
+    }
+    uint64_t compiled_ns = now_ns() - begin;
+
+    std::cout << "pattern " << s_default_pattern << std::endl
+              << "  items:    " << (double)items_ns / n << " ns/line" << std::endl
+              << "  compiled: " << (double)compiled_ns / n << " ns/line"
+              << " (" << total / n << " bytes/line)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_identical();
+    test_date_cache();
+    bench(argc > 1 ? atoi(argv[1]) : 200000);
+    return 0;
+}
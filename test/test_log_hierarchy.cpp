@@ -0,0 +1,146 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <sys/time.h>
+
+/**
+ * @brief 记录收到的日志条数和最后一条日志所属日志器的Appender
+ */
+class CountLogAppender : public ipmsg::LogAppender {
+public:
+    typedef std::shared_ptr<CountLogAppender> ptr;
+    void log(ipmsg::Logger::ptr logger, ipmsg::LogLevel::Level level, ipmsg::LogEvent::ptr event) override {
+        ++m_count;
+        m_last = event->getLogger()->getName();
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<int> m_count{0};
+    std::string m_last;
+};
+
+/**
+ * @brief append()和log()都没有重写的Appender
+ */
+class NullLogAppender : public ipmsg::LogAppender {
+public:
+    std::string toYamlString() override { return ""; }
+};
+
+static uint64_t now_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+/// 级别沿点分名称继承, 设置级别后下级日志器立即生效
+void test_level() {
+    ipmsg::Logger::ptr tcp = LOG_NAME("h1.net.tcp");
+    ipmsg::Logger::ptr net = LOG_NAME("h1.net");
+    /// 后创建的上级日志器会接管已存在的下级日志器
+    assert(tcp->getParent() == net);
+    assert(net->getParent() == LOG_ROOT());
+    assert(tcp->getLevel() == ipmsg::LogLevel::UNKNOW);
+    assert(tcp->getEffectiveLevel() == LOG_ROOT()->getLevel());
+
+    uint64_t epoch = ipmsg::Logger::GetEpoch();
+    net->setLevel(ipmsg::LogLevel::ERROR);
+    assert(ipmsg::Logger::GetEpoch() > epoch);
+    assert(tcp->getEffectiveLevel() == ipmsg::LogLevel::ERROR);
+    assert(!LOG_LEVEL_ENABLED(tcp, ipmsg::LogLevel::WARN));
+    assert(LOG_LEVEL_ENABLED(tcp, ipmsg::LogLevel::ERROR));
+
+    tcp->setLevel(ipmsg::LogLevel::INFO);
+    assert(tcp->getEffectiveLevel() == ipmsg::LogLevel::INFO);
+    tcp->setLevel(ipmsg::LogLevel::UNKNOW);
+    assert(tcp->getEffectiveLevel() == ipmsg::LogLevel::ERROR);
+    std::cout << "level ok" << std::endl;
+}
+
+/// 没有日志目标的日志器输出到最近的有日志目标的上级日志器
+void test_appender() {
+    ipmsg::Logger::ptr net = LOG_NAME("h2.net");
+    ipmsg::Logger::ptr udp = LOG_NAME("h2.net.udp");
+    CountLogAppender::ptr ap(new CountLogAppender);
+    net->addAppender(ap);
+
+    LOG_INFO(udp) << "to net";
+    assert(ap->m_count == 1);
+    assert(ap->m_last == "h2.net.udp");
+
+    /// 中间层在之后创建, 日志目标仍然沿链查找
+    ipmsg::Logger::ptr mid = LOG_NAME("h2.net.udp.a");
+    ipmsg::Logger::ptr leaf = LOG_NAME("h2.net.udp.a.b");
+    LOG_INFO(leaf) << "to net";
+    assert(ap->m_count == 2);
+
+    CountLogAppender::ptr ap2(new CountLogAppender);
+    udp->addAppender(ap2);
+    LOG_INFO(leaf) << "to udp";
+    assert(ap->m_count == 2);
+    assert(ap2->m_count == 1);
+
+    udp->clearAppenders();
+    LOG_INFO(leaf) << "to net";
+    assert(ap->m_count == 3);
+    std::cout << "appender ok" << std::endl;
+}
+
+/// 创建日志器的同时在其他线程中查找, 查找结果必须唯一
+void test_concurrent() {
+    std::vector<ipmsg::Thread::ptr> thrs;
+    std::vector<ipmsg::Logger*> found(4 * 200);
+    for(int i = 0; i < 4; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([i, &found]() {
+            for(int j = 0; j < 200; ++j) {
+                found[i * 200 + j] = LOG_NAME("h3.c" + std::to_string(j)).get();
+            }
+        }, "lookup_" + std::to_string(i))));
+    }
+    for(auto& t : thrs) {
+        t->join();
+    }
+    for(int j = 0; j < 200; ++j) {
+        ipmsg::Logger* l = LOG_NAME("h3.c" + std::to_string(j)).get();
+        for(int i = 0; i < 4; ++i) {
+            assert(found[i * 200 + j] == l);
+        }
+    }
+    std::cout << "concurrent ok" << std::endl;
+}
+
+/// 查找已存在的日志器和关闭级别检查的开销
+void bench() {
+    const int n = 1000000;
+    std::string name = "h4.bench.logger";
+    LOG_NAME(name)->setLevel(ipmsg::LogLevel::ERROR);
+    uint64_t start = now_us();
+    for(int i = 0; i < n; ++i) {
+        LOG_DEBUG(LOG_NAME(name)) << "disabled";
+    }
+    uint64_t used = now_us() - start;
+    std::cout << "LOG_NAME+disabled check: " << used * 1000.0 / n << " ns/call" << std::endl;
+}
+
+/// 默认的append()/log()互不递归, 栈上的日志事件也能传给只重写了log()的Appender
+void test_default_shim() {
+    ipmsg::Logger::ptr logger = LOG_NAME("h1.shim");
+    ipmsg::LogEvent event(logger, ipmsg::LogLevel::INFO, __FILE__, __LINE__, 0
+            , 0, 0, time(0), "shim");
+    CountLogAppender::ptr count(new CountLogAppender);
+    count->append(*logger, ipmsg::LogLevel::INFO, event);
+    assert(count->m_count == 1 && count->m_last == "h1.shim");
+
+    NullLogAppender null;
+    null.append(*logger, ipmsg::LogLevel::INFO, event);
+    null.append(*logger, ipmsg::LogLevel::INFO, event);
+    assert(null.getMetrics().dropped == 2);
+}
+
+int main(int argc, char** argv) {
+    test_level();
+    test_appender();
+    test_default_shim();
+    test_concurrent();
+    bench();
+    return 0;
+}
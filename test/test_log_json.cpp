@@ -0,0 +1,130 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <time.h>
+
+/**
+ * @brief 只保存最后一条日志的日志目标
+ */
+class CaptureLogAppender : public ipmsg::LogAppender {
+public:
+    typedef std::shared_ptr<CaptureLogAppender> ptr;
+    void append(ipmsg::Logger& logger, ipmsg::LogLevel::Level level, const ipmsg::LogEvent& event) override {
+        last.clear();
+        m_formatter->format(last, level, event);
+    }
+    std::string toYamlString() override { return ""; }
+    std::string last;
+};
+
+static ipmsg::Logger::ptr make_logger(const std::string& name, const std::string& pattern
+        ,CaptureLogAppender::ptr& ap) {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger(name));
+    logger->setFormatter(pattern);
+    ap.reset(new CaptureLogAppender);
+    logger->addAppender(ap);
+    return logger;
+}
+
+/// 文本格式中字段以 key=value 追加在内容之后
+void test_text() {
+    CaptureLogAppender::ptr ap;
+    ipmsg::Logger::ptr logger = make_logger("json_text", "%m", ap);
+    std::string name = "a b";
+    LOG_INFO(logger).kv("user", 42).kv("bytes", (uint64_t)1024).kv("ratio", 0.5)
+        .kv("ok", true).kv("name", name).kv("empty", "").kv("c", 'x') << "hello";
+    assert(ap->last == "hello user=42 bytes=1024 ratio=0.5 ok=true name=\"a b\" empty=\"\" c=x");
+    LOG_INFO(logger) << "no fields";
+    assert(ap->last == "no fields");
+    std::cout << "text ok" << std::endl;
+}
+
+/// JSON格式的转义及字段类型
+void test_json() {
+    CaptureLogAppender::ptr ap;
+    ipmsg::Logger::ptr logger = make_logger("json\"logger", "%J{%s}", ap);
+    LOG_WARN(logger).kv("user", -7).kv("pi", 3.14159).kv("flag", false).kv("nan", 0.0 / 0.0)
+        .kv("path", "C:\\dir\n\"x\"\x01").kv(std::string("utf8"), "中文") << "quote\" tab\t end";
+    const std::string& line = ap->last;
+    assert(line.find("\"level\":\"WARN\"") != std::string::npos);
+    assert(line.find("\"logger\":\"json\\\"logger\"") != std::string::npos);
+    assert(line.find("\"msg\":\"quote\\\" tab\\t end\"") != std::string::npos);
+    assert(line.find("\"user\":-7,\"pi\":3.14159,\"flag\":false,\"nan\":null,") != std::string::npos);
+    assert(line.find("\"path\":\"C:\\\\dir\\n\\\"x\\\"\\u0001\"") != std::string::npos);
+    assert(line.back() == '}');
+
+    /// 输出是合法的JSON(也是合法的YAML)
+    YAML::Node node = YAML::Load(line);
+    assert(node["time"].as<uint64_t>() == (uint64_t)time(0) || node["time"].as<uint64_t>() + 1 == (uint64_t)time(0));
+    assert(node["msg"].as<std::string>() == "quote\" tab\t end");
+    assert(node["path"].as<std::string>() == "C:\\dir\n\"x\"\x01");
+    assert(node["utf8"].as<std::string>() == "中文");
+    assert(node["user"].as<int>() == -7);
+    assert(node["line"].as<int>() > 0);
+    std::cout << line << std::endl;
+}
+
+/// 超过内部容量的字段及事件回收后复用
+void test_many() {
+    CaptureLogAppender::ptr ap;
+    ipmsg::Logger::ptr logger = make_logger("json_many", "%J", ap);
+    for(int round = 0; round < 3; ++round) {
+        {
+            ipmsg::LogEventWrap wrap(ipmsg::LogEvent::Create(logger, ipmsg::LogLevel::INFO, __FILE__, __LINE__
+                    ,0, ipmsg::GetThreadId(), ipmsg::GetFiberId(), time(0), ipmsg::Thread::GetName()));
+            for(int i = 0; i < 20; ++i) {
+                wrap.getSS().kv("k" + std::to_string(i), i * round);
+            }
+            wrap.getSS() << "many";
+        }
+        YAML::Node node = YAML::Load(ap->last);
+        for(int i = 0; i < 20; ++i) {
+            assert(node["k" + std::to_string(i)].as<int>() == i * round);
+        }
+        assert(node["k20"].IsNull() || !node["k20"]);
+    }
+    LOG_INFO(logger) << "reused";
+    assert(ap->last.find("\"k0\"") == std::string::npos);
+    std::cout << "many ok" << std::endl;
+}
+
+/// 编译后的指令与FormatItem的输出相同
+void test_items() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("json_items"));
+    ipmsg::LogEvent::ptr event = ipmsg::LogEvent::Create(logger, ipmsg::LogLevel::ERROR, __FILE__, __LINE__
+            ,0, ipmsg::GetThreadId(), ipmsg::GetFiberId(), time(0), ipmsg::Thread::GetName());
+    event->getSS().kv("id", 9).kv("s", "x y") << "items";
+    const char* patterns[] = {"%J%n", "%m", "[%p] %m %J{%Y}%n"};
+    for(auto p : patterns) {
+        ipmsg::LogFormatter::ptr fmt(new ipmsg::LogFormatter(p));
+        std::stringstream ss;
+        fmt->formatItems(ss, logger, ipmsg::LogLevel::ERROR, event);
+        assert(ss.str() == fmt->format(logger, ipmsg::LogLevel::ERROR, event));
+    }
+    std::cout << "items ok" << std::endl;
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void bench() {
+    CaptureLogAppender::ptr ap;
+    ipmsg::Logger::ptr logger = make_logger("json_bench", "%J%n", ap);
+    const int n = 200000;
+    uint64_t start = now_ns();
+    for(int i = 0; i < n; ++i) {
+        LOG_INFO(logger).kv("user", i).kv("bytes", 1024).kv("path", "/index.html") << "request done";
+    }
+    std::cout << "%J with 3 fields: " << (now_ns() - start) / (double)n << " ns/line" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_text();
+    test_json();
+    test_many();
+    test_items();
+    bench();
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <time.h>
+
+/**
+ *  关闭的日志语句的开销: 运行期级别过滤与编译期移除
+ */
+ipmsg::Logger::ptr g_logger(new ipmsg::Logger("level"));
+static uint64_t s_evaluated = 0;
+
+static int expensive() {
+    ++s_evaluated;
+    return 1;
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/// 每次循环都强制重新读取日志器, 与热点循环中的真实情况一致
+#define BARRIER() asm volatile("" ::: "memory")
+
+double bench_stream(int n) {
+    uint64_t begin = now_ns();
+    for(int i = 0; i < n; ++i) {
+        LOG_DEBUG(g_logger) << "disabled " << expensive();
+        BARRIER();
+    }
+    return (double)(now_ns() - begin) / n;
+}
+
+double bench_fmt(int n) {
+    uint64_t begin = now_ns();
+    for(int i = 0; i < n; ++i) {
+        LOG_FMT_DEBUG(g_logger, "disabled %d", expensive());
+        BARRIER();
+    }
+    return (double)(now_ns() - begin) / n;
+}
+
+double bench_empty(int n) {
+    uint64_t begin = now_ns();
+    for(int i = 0; i < n; ++i) {
+        BARRIER();
+    }
+    return (double)(now_ns() - begin) / n;
+}
+
+/// 不带花括号的if中使用日志宏, 后面的else属于外层的if
+void test_dangling_else() {
+    int branch = 0;
+    bool flag = true;
+    if(flag)
+        LOG_DEBUG(g_logger) << "disabled";
+    else
+        ++branch;
+    if(flag)
+        LOG_FMT_DEBUG(g_logger, "disabled %d", 1);
+    else
+        ++branch;
+    if(flag)
+        LOG_FMT2_DEBUG(g_logger, "disabled %d", 1);
+    else
+        ++branch;
+    assert(branch == 0);
+}
+
+/// 以下语句在编译期被移除
+#undef IPMSG_LOG_MIN_LEVEL
+#define IPMSG_LOG_MIN_LEVEL 2
+
+double bench_compiled_out(int n) {
+    uint64_t begin = now_ns();
+    for(int i = 0; i < n; ++i) {
+        LOG_DEBUG(g_logger) << "removed " << expensive();
+        LOG_FMT_DEBUG(g_logger, "removed %d", expensive());
+        BARRIER();
+    }
+    return (double)(now_ns() - begin) / n;
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 100000000;
+    g_logger->setLevel(ipmsg::LogLevel::INFO);
+    test_dangling_else();
+
+    double empty = bench_empty(n);
+    double stream = bench_stream(n);
+    double fmt = bench_fmt(n);
+    g_logger->setLevel(ipmsg::LogLevel::DEBUG);
+    double removed = bench_compiled_out(n);
+
+    std::cout << "empty loop:          " << empty << " ns" << std::endl
+              << "disabled LOG_DEBUG:  " << stream << " ns" << std::endl
+              << "disabled LOG_FMT:    " << fmt << " ns" << std::endl
+              << "compiled out (both): " << removed << " ns" << std::endl;
+    /// 关闭的语句不计算参数
+    assert(s_evaluated == 0);
+    return 0;
+}
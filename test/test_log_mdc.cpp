@@ -0,0 +1,160 @@
+#include "ipmsg.h"
+#include <assert.h>
+
+/**
+ * @brief 保存所有格式化结果的日志目标
+ */
+class CaptureLogAppender : public ipmsg::LogAppender {
+public:
+    typedef std::shared_ptr<CaptureLogAppender> ptr;
+    void append(ipmsg::Logger& logger, ipmsg::LogLevel::Level level, const ipmsg::LogEvent& event) override {
+        std::string str;
+        m_formatter->format(str, level, event);
+        ipmsg::Mutex::Lock lock(mutex);
+        lines.push_back(str);
+    }
+    std::string toYamlString() override { return ""; }
+    ipmsg::Mutex mutex;
+    std::vector<std::string> lines;
+};
+
+static ipmsg::Logger::ptr make_logger(const std::string& pattern, CaptureLogAppender::ptr& ap) {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("mdc"));
+    logger->setFormatter(pattern);
+    ap.reset(new CaptureLogAppender);
+    logger->addAppender(ap);
+    return logger;
+}
+
+/// 线程上下文及%X的输出
+void test_thread() {
+    CaptureLogAppender::ptr ap;
+    ipmsg::Logger::ptr logger = make_logger("[%X{req}] %m|%X", ap);
+    LOG_INFO(logger) << "empty";
+    ipmsg::LogMDC::Put("req", "r1");
+    ipmsg::LogMDC::Put("user", "u1");
+    LOG_INFO(logger) << "put";
+    {
+        ipmsg::LogMDC::Scope scope("req", "r2");
+        LOG_INFO(logger) << "scope";
+    }
+    LOG_INFO(logger) << "restored";
+    ipmsg::LogMDC::Remove("user");
+    LOG_INFO(logger) << "removed";
+    assert(ipmsg::LogMDC::Get("req") == "r1");
+    assert(ipmsg::LogMDC::Get("user") == "");
+
+    /// 其他线程看不到本线程的上下文
+    ipmsg::Thread::ptr t(new ipmsg::Thread([logger]() {
+        LOG_INFO(logger) << "other";
+    }, "mdc_other"));
+    t->join();
+    ipmsg::LogMDC::Clear();
+
+    const char* expect[] = {
+        "[] empty|",
+        "[r1] put|req=r1 user=u1",
+        "[r2] scope|req=r2 user=u1",
+        "[r1] restored|req=r1 user=u1",
+        "[r1] removed|req=r1",
+        "[] other|",
+    };
+    assert(ap->lines.size() == 6);
+    for(size_t i = 0; i < 6; ++i) {
+        assert(ap->lines[i] == expect[i]);
+    }
+
+    /// 编译后的指令与FormatItem的输出相同
+    ipmsg::LogMDC::Put("req", "r3");
+    ipmsg::LogEvent::ptr event = ipmsg::LogEvent::Create(logger, ipmsg::LogLevel::INFO, __FILE__, __LINE__
+            ,0, ipmsg::GetThreadId(), ipmsg::GetFiberId(), time(0), ipmsg::Thread::GetName());
+    event->getSS() << "items";
+    const char* patterns[] = {"%X{req}%T%X{none}%m%X%n", "%J"};
+    for(auto p : patterns) {
+        ipmsg::LogFormatter::ptr fmt(new ipmsg::LogFormatter(p));
+        std::stringstream ss;
+        fmt->formatItems(ss, logger, ipmsg::LogLevel::INFO, event);
+        assert(ss.str() == fmt->format(logger, ipmsg::LogLevel::INFO, event));
+    }
+    assert(ipmsg::LogFormatter("%J").format(logger, ipmsg::LogLevel::INFO, event)
+            .find(",\"msg\":\"items\",\"req\":\"r3\"}") != std::string::npos);
+    event.reset();
+    ipmsg::LogMDC::Clear();
+    std::cout << "thread ok" << std::endl;
+}
+
+static ipmsg::Logger::ptr s_logger;
+
+static void handle(const std::string& req) {
+    ipmsg::LogMDC::Put("req", req);
+    LOG_INFO(s_logger) << "begin";
+    ipmsg::Fiber::YieldToHold();
+    LOG_INFO(s_logger) << "end";
+}
+
+/// 同一线程上交替运行的协程各自保持上下文, 主协程使用线程的上下文
+void test_fiber() {
+    CaptureLogAppender::ptr ap;
+    s_logger = make_logger("%X{req} %m", ap);
+    ipmsg::Fiber::GetThis();
+    ipmsg::LogMDC::Put("req", "main");
+    ipmsg::Fiber::ptr a(new ipmsg::Fiber(std::bind(handle, "a")));
+    ipmsg::Fiber::ptr b(new ipmsg::Fiber(std::bind(handle, "b")));
+    /// 新协程继承创建者的上下文
+    ipmsg::Fiber::ptr c(new ipmsg::Fiber([]() {
+        LOG_INFO(s_logger) << "inherited";
+    }));
+    a->swapIn();
+    b->swapIn();
+    LOG_INFO(s_logger) << "between";
+    a->swapIn();
+    b->swapIn();
+    c->swapIn();
+    LOG_INFO(s_logger) << "done";
+
+    const char* expect[] = {
+        "a begin", "b begin", "main between", "a end", "b end", "main inherited", "main done",
+    };
+    assert(ap->lines.size() == 7);
+    for(size_t i = 0; i < 7; ++i) {
+        assert(ap->lines[i] == expect[i]);
+    }
+    std::cout << "fiber ok" << std::endl;
+}
+
+/// 协程在另一个线程上继续运行时上下文跟随协程
+void test_migrate() {
+    CaptureLogAppender::ptr ap;
+    s_logger = make_logger("%X{req} %m", ap);
+    ipmsg::Fiber::ptr f;
+    ipmsg::Thread::ptr t1(new ipmsg::Thread([&f]() {
+        ipmsg::Fiber::GetThis();
+        ipmsg::LogMDC::Put("req", "t1");
+        f.reset(new ipmsg::Fiber(std::bind(handle, "moved")));
+        f->swapIn();
+        LOG_INFO(s_logger) << "t1";
+    }, "mdc_t1"));
+    t1->join();
+    ipmsg::Thread::ptr t2(new ipmsg::Thread([&f]() {
+        ipmsg::Fiber::GetThis();
+        ipmsg::LogMDC::Put("req", "t2");
+        f->swapIn();
+        LOG_INFO(s_logger) << "t2";
+        f.reset();
+    }, "mdc_t2"));
+    t2->join();
+    const char* expect[] = {"moved begin", "t1 t1", "moved end", "t2 t2"};
+    assert(ap->lines.size() == 4);
+    for(size_t i = 0; i < 4; ++i) {
+        assert(ap->lines[i] == expect[i]);
+    }
+    std::cout << "migrate ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    LOG_NAME("system")->setLevel(ipmsg::LogLevel::INFO);
+    test_thread();
+    test_fiber();
+    test_migrate();
+    return 0;
+}
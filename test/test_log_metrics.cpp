@@ -0,0 +1,111 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/// 按级别统计日志器的输出条数, 低于级别的不统计
+void test_logger() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("metrics"));
+    logger->setLevel(ipmsg::LogLevel::INFO);
+    std::string file = "/tmp/test_log_metrics_" + std::to_string(getpid()) + ".log";
+    logger->addAppender(ipmsg::LogAppender::ptr(new ipmsg::FileLogAppender(file)));
+    for(int i = 0; i < 10; ++i) {
+        LOG_DEBUG(logger) << "debug " << i;
+        LOG_INFO(logger) << "info " << i;
+    }
+    LOG_ERROR(logger) << "error";
+    ipmsg::Logger::Metrics m = logger->getMetrics();
+    assert(m.events[ipmsg::LogLevel::DEBUG] == 0);
+    assert(m.events[ipmsg::LogLevel::INFO] == 10);
+    assert(m.events[ipmsg::LogLevel::ERROR] == 1);
+    assert(m.throttled == 0);
+
+    ipmsg::LogAppender::Metrics am = logger->getAppenders().front()->getMetrics();
+    assert(am.events == 11);
+    struct stat st;
+    assert(stat(file.c_str(), &st) == 0);
+    assert(am.bytes > 0 && am.bytes == (uint64_t)st.st_size);
+    assert(am.write_ns > 0);
+    assert(am.reopens == 0);
+
+    logger->setRateLimit(1, 5);
+    for(int i = 0; i < 20; ++i) {
+        LOG_INFO(logger) << "throttled " << i;
+    }
+    m = logger->getMetrics();
+    assert(m.events[ipmsg::LogLevel::INFO] + m.throttled == 30);
+    assert(m.throttled >= 14);
+    unlink(file.c_str());
+    std::cout << "logger ok throttled=" << m.throttled << std::endl;
+}
+
+/// 多个线程写同一日志器, 分片求和后不丢计数
+void test_threads() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("metrics_threads"));
+    std::string file = "/tmp/test_log_metrics_threads_" + std::to_string(getpid()) + ".log";
+    ipmsg::FileLogAppender::ptr ap(new ipmsg::FileLogAppender(file));
+    ap->setBuffer(64 * 1024);
+    logger->addAppender(ap);
+    const int threads = 8;
+    const int lines = 10000;
+    std::vector<ipmsg::Thread::ptr> thrs;
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([logger]() {
+            for(int j = 0; j < lines; ++j) {
+                LOG_WARN(logger) << "line " << j;
+            }
+        }, "metrics_" + std::to_string(i))));
+    }
+    for(auto& t : thrs) {
+        t->join();
+    }
+    logger->flush();
+    assert(logger->getMetrics().events[ipmsg::LogLevel::WARN] == (uint64_t)threads * lines);
+    ipmsg::LogAppender::Metrics am = ap->getMetrics();
+    assert(am.events == (uint64_t)threads * lines);
+    assert(am.format_ns > 0);
+    unlink(file.c_str());
+    std::cout << "threads ok format_ns=" << am.format_ns << " write_ns=" << am.write_ns << std::endl;
+}
+
+/// 通过LoggerManager导出
+void test_export() {
+    ipmsg::Logger::ptr logger = LOG_NAME("metrics_export");
+    std::string file = "/tmp/test_log_metrics_export_" + std::to_string(getpid()) + ".log";
+    logger->addAppender(ipmsg::LogAppender::ptr(new ipmsg::FileLogAppender(file)));
+    logger->setLevel(ipmsg::LogLevel::DEBUG);
+    LOG_INFO(logger) << "exported";
+    LOG_INFO(logger) << "exported";
+
+    std::string yaml = ipmsg::LoggerMgr::GetInstance()->toMetricsYamlString();
+    YAML::Node node = YAML::Load(yaml);
+    bool found = false;
+    for(auto n : node) {
+        if(n["name"].as<std::string>() == "metrics_export") {
+            assert(n["events"]["INFO"].as<uint64_t>() == 2);
+            assert(n["appenders"][0]["type"].as<std::string>() == "FileLogAppender");
+            assert(n["appenders"][0]["events"].as<uint64_t>() == 2);
+            found = true;
+        }
+    }
+    assert(found);
+
+    std::string json = ipmsg::LoggerMgr::GetInstance()->toMetricsJson();
+    assert(json.find("{\"name\":\"metrics_export\",\"events\":{\"DEBUG\":0,\"INFO\":2,") != std::string::npos);
+
+    std::string prom = ipmsg::LoggerMgr::GetInstance()->toPrometheus();
+    assert(prom.find("# TYPE ipmsg_log_events_total counter\n") != std::string::npos);
+    assert(prom.find("ipmsg_log_events_total{logger=\"metrics_export\",level=\"INFO\"} 2\n") != std::string::npos);
+    assert(prom.find("ipmsg_log_appender_events_total{logger=\"metrics_export\",appender=\"0\",type=\"FileLogAppender\"} 2\n")
+            != std::string::npos);
+    assert(prom.find("ipmsg_log_appender_write_seconds_total{logger=\"metrics_export\"") != std::string::npos);
+    unlink(file.c_str());
+    std::cout << prom;
+}
+
+int main(int argc, char** argv) {
+    test_logger();
+    test_threads();
+    test_export();
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <signal.h>
+
+static const char* s_file = "./mmap_log.txt";
+
+static std::string read_file() {
+    std::ifstream ifs(s_file, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+static uint64_t now_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+/// 多个线程写入, 跨越多个块, 每行完整且同一线程的日志保持顺序
+void test_concurrent(int threads, int lines) {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("mmap"));
+    ipmsg::MmapFileLogAppender::ptr appender(new ipmsg::MmapFileLogAppender(s_file, 8192));
+    appender->setFormatter(ipmsg::LogFormatter::ptr(new ipmsg::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+
+    std::vector<ipmsg::Thread::ptr> thrs;
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([logger, lines, i]() {
+            for(int j = 0; j < lines; ++j) {
+                LOG_INFO(logger) << i << " " << j << " mmap appender line";
+            }
+        }, "mmap_" + std::to_string(i))));
+    }
+    for(auto& t : thrs) {
+        t->join();
+    }
+    uint64_t size = appender->getSize();
+    logger->clearAppenders();
+    appender.reset();
+
+    std::string data = read_file();
+    assert(data.size() == size);
+    assert(data.find('\0') == std::string::npos);
+    std::vector<int> next(threads, 0);
+    std::stringstream ss(data);
+    std::string line;
+    size_t count = 0;
+    while(std::getline(ss, line)) {
+        int i = -1, j = -1;
+        assert(sscanf(line.c_str(), "%d %d", &i, &j) == 2);
+        assert(line == std::to_string(i) + " " + std::to_string(j) + " mmap appender line");
+        assert(j == next[i]++);
+        ++count;
+    }
+    assert(count == (size_t)threads * lines);
+    std::cout << "concurrent threads=" << threads << " size=" << size << " ok" << std::endl;
+}
+
+/// 异常退出后文件末尾残留的'\0'会被跳过, 新日志接在原有内容之后
+void test_reopen() {
+    unlink(s_file);
+    {
+        std::ofstream ofs(s_file, std::ios::binary);
+        ofs << "old line\n" << std::string(10000, '\0');
+    }
+    {
+        ipmsg::Logger::ptr logger(new ipmsg::Logger("mmap"));
+        ipmsg::MmapFileLogAppender::ptr appender(new ipmsg::MmapFileLogAppender(s_file, 4096));
+        appender->setFormatter(ipmsg::LogFormatter::ptr(new ipmsg::LogFormatter("%m%n")));
+        logger->addAppender(appender);
+        LOG_INFO(logger) << "new line";
+    }
+    assert(read_file() == "old line\nnew line\n");
+    std::cout << "reopen ok" << std::endl;
+}
+
+template<class T>
+void bench(const char* name, T* appender, int lines) {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("mmap"));
+    logger->addAppender(ipmsg::LogAppender::ptr(appender));
+    uint64_t start = now_us();
+    for(int i = 0; i < lines; ++i) {
+        LOG_INFO(logger) << "mmap bench line " << i;
+    }
+    uint64_t used = now_us() - start;
+    std::cout << name << ": " << used * 1000 / lines << " ns/line" << std::endl;
+}
+
+/// 映射失败(文件大小超过限制)的日志计为丢弃, 限制解除后继续写入, 不会卡在未写满的块上
+void test_map_failure() {
+    unlink(s_file);
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("mmap_fail"));
+    ipmsg::MmapFileLogAppender::ptr appender(new ipmsg::MmapFileLogAppender(s_file, 8192));
+    appender->setFormatter(ipmsg::LogFormatter::ptr(new ipmsg::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit old;
+    getrlimit(RLIMIT_FSIZE, &old);
+    struct rlimit limit = old;
+    limit.rlim_cur = 2 * 8192;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    for(int i = 0; i < 1000; ++i) {
+        LOG_INFO(logger) << "before " << i << " mmap appender line";
+    }
+    setrlimit(RLIMIT_FSIZE, &old);
+    uint64_t dropped = appender->getMetrics().dropped;
+    assert(dropped > 0 && dropped < 1000);
+
+    for(int i = 0; i < 5000; ++i) {
+        LOG_INFO(logger) << "after " << i << " mmap appender line";
+    }
+    assert(appender->getMetrics().dropped == dropped);
+    logger->clearAppenders();
+    appender.reset();
+
+    std::string data = read_file();
+    assert(data.find("before 0 ") != std::string::npos);
+    assert(data.find("after 4999 ") != std::string::npos);
+    std::cout << "map failure dropped=" << dropped << " ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_concurrent(1, 10000);
+    test_concurrent(8, 10000);
+    test_reopen();
+    test_map_failure();
+
+    int lines = argc > 1 ? atoi(argv[1]) : 200000;
+    unlink(s_file);
+    bench("FileLogAppender", new ipmsg::FileLogAppender(s_file), lines);
+    unlink(s_file);
+    bench("MmapFileLogAppender", new ipmsg::MmapFileLogAppender(s_file), lines);
+    unlink(s_file);
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <unistd.h>
+
+/**
+ * @brief 记录日志内容的Appender
+ */
+class CaptureLogAppender : public ipmsg::LogAppender {
+public:
+    typedef std::shared_ptr<CaptureLogAppender> ptr;
+    void log(ipmsg::Logger::ptr logger, ipmsg::LogLevel::Level level, ipmsg::LogEvent::ptr event) override {
+        MutexType::Lock lock(m_mutex);
+        lines.push_back(event->getContent());
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::vector<std::string> lines;
+};
+
+static ipmsg::Logger::ptr make_logger(CaptureLogAppender::ptr& capture) {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("rate"));
+    capture.reset(new CaptureLogAppender);
+    logger->addAppender(capture);
+    return logger;
+}
+
+void test_every_n() {
+    CaptureLogAppender::ptr capture;
+    auto logger = make_logger(capture);
+    for(int i = 0; i < 25; ++i) {
+        LOG_WARN_EVERY_N(logger, 10) << "every_n " << i;
+    }
+    assert(capture->lines.size() == 3);
+    assert(capture->lines[0] == "every_n 0");
+    assert(capture->lines[1] == "every_n 10 [suppressed 9]");
+    assert(capture->lines[2] == "every_n 20 [suppressed 9]");
+
+    /// 不同调用位置的状态互相独立
+    LOG_WARN_EVERY_N(logger, 10) << "other site";
+    assert(capture->lines.size() == 4 && capture->lines[3] == "other site");
+    std::cout << "every_n ok" << std::endl;
+}
+
+void test_every_ms() {
+    CaptureLogAppender::ptr capture;
+    auto logger = make_logger(capture);
+    for(int i = 0; i < 3; ++i) {
+        for(int j = 0; j < 100; ++j) {
+            LOG_INFO_EVERY_MS(logger, 100) << "every_ms " << i;
+        }
+        usleep(150 * 1000);
+    }
+    assert(capture->lines.size() == 3);
+    assert(capture->lines[0] == "every_ms 0");
+    assert(capture->lines[2] == "every_ms 2 [suppressed 99]");
+    std::cout << "every_ms ok" << std::endl;
+}
+
+static void log_rate(ipmsg::Logger::ptr logger, const std::string& msg) {
+    LOG_ERROR_RATE(logger, 10, 5) << msg;
+}
+
+void test_rate() {
+    CaptureLogAppender::ptr capture;
+    auto logger = make_logger(capture);
+    for(int i = 0; i < 1000; ++i) {
+        log_rate(logger, "rate " + std::to_string(i));
+    }
+    /// 突发5条之后全部丢弃
+    assert(capture->lines.size() == 5);
+    usleep(250 * 1000);
+    log_rate(logger, "rate after");
+    assert(capture->lines.size() == 6);
+    assert(capture->lines[5] == "rate after [suppressed 995]");
+    std::cout << "rate ok" << std::endl;
+}
+
+/// 日志器级别的限流通过YAML配置
+void test_logger_throttle() {
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: rate_yaml\n"
+        "    level: info\n"
+        "    rate_limit: 100\n"
+        "    burst: 20\n"
+        "    appenders:\n"
+        "      - type: StdoutLogAppender\n");
+    ipmsg::Config::LoadFromYaml(root);
+    ipmsg::Logger::ptr logger = LOG_NAME("rate_yaml");
+    assert(logger->getRateLimit() == 100 && logger->getBurst() == 20);
+
+    CaptureLogAppender::ptr capture(new CaptureLogAppender);
+    logger->clearAppenders();
+    logger->addAppender(capture);
+    for(int i = 0; i < 1000; ++i) {
+        LOG_INFO(logger) << "throttle " << i;
+    }
+    assert(capture->lines.size() == 20);
+    usleep(50 * 1000);
+    LOG_INFO(logger) << "throttle after";
+    assert(capture->lines.back() == "throttle after [suppressed 980]");
+    std::cout << "logger throttle ok" << std::endl;
+}
+
+/// 未触发限流时的开销
+void bench() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("rate_bench"));
+    logger->setLevel(ipmsg::LogLevel::ERROR);
+    const int n = 10000000;
+    uint64_t start = ipmsg::LogSite::NowUs();
+    for(int i = 0; i < n; ++i) {
+        LOG_WARN_EVERY_N(logger, 1000) << "disabled " << i;
+    }
+    uint64_t used = ipmsg::LogSite::NowUs() - start;
+    std::cout << "disabled level: " << used * 1000.0 / n << " ns/line" << std::endl;
+
+    ipmsg::LogSite site;
+    uint64_t total = 0;
+    start = ipmsg::LogSite::NowUs();
+    for(int i = 0; i < n; ++i) {
+        total += site.everyN(1000);
+    }
+    used = ipmsg::LogSite::NowUs() - start;
+    std::cout << "everyN check: " << used * 1000.0 / n << " ns/call (" << total << ")" << std::endl;
+}
+
+/// 不带花括号的if中使用限流宏, 后面的else属于外层的if, 不会在日志被丢弃时执行
+void test_dangling_else() {
+    CaptureLogAppender::ptr capture;
+    auto logger = make_logger(capture);
+    int hits = 0;
+    bool flag = true;
+    for(int i = 0; i < 4; ++i) {
+        if(flag)
+            LOG_INFO_EVERY_N(logger, 2) << "every_n";
+        else
+            ++hits;
+        if(flag)
+            LOG_INFO_EVERY_MS(logger, 60000) << "every_ms";
+        else
+            ++hits;
+        if(flag)
+            LOG_INFO_RATE(logger, 1, 1) << "rate";
+        else
+            ++hits;
+    }
+    assert(hits == 0);
+    assert(capture->lines.size() == 4);
+    std::cout << "dangling else ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_every_n();
+    test_dangling_else();
+    test_every_ms();
+    test_rate();
+    test_logger_throttle();
+    bench();
+    return 0;
+}
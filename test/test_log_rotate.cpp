@@ -0,0 +1,162 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+static const char* s_dir = "./rotate_test";
+static const std::string s_file = std::string(s_dir) + "/rotate.log";
+
+static std::vector<std::string> list_dir() {
+    std::vector<std::string> files;
+    DIR* d = opendir(s_dir);
+    while(struct dirent* ent = readdir(d)) {
+        if(ent->d_name[0] != '.') {
+            files.push_back(ent->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+static void clean_dir() {
+    mkdir(s_dir, 0755);
+    for(auto& i : list_dir()) {
+        unlink((std::string(s_dir) + "/" + i).c_str());
+    }
+}
+
+static off_t file_size(const std::string& file) {
+    struct stat st;
+    return stat(file.c_str(), &st) ? -1 : st.st_size;
+}
+
+/// 按大小切分, 只保留3个历史文件
+void test_size() {
+    clean_dir();
+    ipmsg::FileLogAppender::RotatePolicy policy;
+    policy.max_size = 4096;
+    policy.max_files = 3;
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("rotate"));
+    logger->addAppender(ipmsg::FileLogAppender::ptr(new ipmsg::FileLogAppender(s_file, policy)));
+    for(int i = 0; i < 1000; ++i) {
+        LOG_INFO(logger) << "rotate by size " << i;
+    }
+    logger->clearAppenders();   /// 析构时等待后台清理完成
+    auto files = list_dir();
+    assert(files.size() == 4);
+    for(auto& i : files) {
+        off_t size = file_size(std::string(s_dir) + "/" + i);
+        assert(size > 0 && size <= 4096);
+    }
+    std::cout << "size rotate files=" << files.size() << " ok" << std::endl;
+}
+
+/// 历史文件在后台压缩
+void test_compress() {
+    clean_dir();
+    ipmsg::FileLogAppender::RotatePolicy policy;
+    policy.max_files = 2;
+    policy.compress = true;
+    ipmsg::FileLogAppender::ptr appender(new ipmsg::FileLogAppender(s_file, policy));
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("rotate"));
+    logger->addAppender(appender);
+    for(int n = 0; n < 3; ++n) {
+        for(int i = 0; i < 100; ++i) {
+            LOG_INFO(logger) << "rotate compress " << n << " " << i;
+        }
+        appender->rotate();
+    }
+    logger->clearAppenders();
+    appender.reset();   /// 析构时等待压缩完成
+    auto files = list_dir();
+    assert(files.size() == 3);
+    assert(files[0] == "rotate.log");
+    for(size_t i = 1; i < 3; ++i) {
+        assert(files[i].size() > 3 && files[i].compare(files[i].size() - 3, 3, ".gz") == 0);
+    }
+    std::cout << "compress ok" << std::endl;
+}
+
+/// 同一秒内切分超过9次, 保留的是最新的历史文件
+void test_same_second() {
+    clean_dir();
+    ipmsg::FileLogAppender::RotatePolicy policy;
+    policy.max_files = 3;
+    ipmsg::FileLogAppender::ptr appender(new ipmsg::FileLogAppender(s_file, policy));
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("rotate"));
+    logger->setFormatter("%m%n");
+    logger->addAppender(appender);
+    for(int n = 0; n < 12; ++n) {
+        LOG_INFO(logger) << "gen " << n;
+        appender->rotate();
+    }
+    logger->clearAppenders();
+    appender.reset();
+    auto files = list_dir();
+    assert(files.size() == 4);
+    std::set<std::string> kept;
+    for(auto& i : files) {
+        std::ifstream ifs(std::string(s_dir) + "/" + i);
+        std::string line;
+        if(std::getline(ifs, line)) {
+            kept.insert(line);
+        }
+    }
+    assert(kept == std::set<std::string>({"gen 9", "gen 10", "gen 11"}));
+    std::cout << "same second ok" << std::endl;
+}
+
+/// 文件被外部移走后重新创建, 不会继续写入旧的inode
+void test_external_rotate() {
+    clean_dir();
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("rotate"));
+    logger->addAppender(ipmsg::FileLogAppender::ptr(new ipmsg::FileLogAppender(s_file)));
+    LOG_INFO(logger) << "before logrotate";
+    std::string moved = s_file + ".moved";
+    rename(s_file.c_str(), moved.c_str());
+    sleep(1);
+    LOG_INFO(logger) << "after logrotate";
+    std::string line;
+    std::ifstream ifs(s_file);
+    assert(std::getline(ifs, line) && line.find("after logrotate") != std::string::npos);
+    std::ifstream old(moved);
+    assert(std::getline(old, line) && line.find("before logrotate") != std::string::npos);
+    assert(!std::getline(old, line));
+    std::cout << "external rotate ok" << std::endl;
+}
+
+/// 已存在的旧文件属于上一个周期, 第一次写入时先切分
+void test_daily() {
+    clean_dir();
+    {
+        std::ofstream ofs(s_file);
+        ofs << "yesterday" << std::endl;
+    }
+    struct utimbuf tb;
+    tb.actime = tb.modtime = time(0) - 86400 * 2;
+    utime(s_file.c_str(), &tb);
+
+    ipmsg::FileLogAppender::RotatePolicy policy;
+    policy.mode = ipmsg::FileLogAppender::ROTATE_DAILY;
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("rotate"));
+    logger->addAppender(ipmsg::FileLogAppender::ptr(new ipmsg::FileLogAppender(s_file, policy)));
+    LOG_INFO(logger) << "today";
+    auto files = list_dir();
+    assert(files.size() == 2);
+    assert(file_size(std::string(s_dir) + "/" + files[1]) == 10);
+    std::cout << "daily ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_size();
+    test_compress();
+    test_same_second();
+    test_external_rotate();
+    test_daily();
+    clean_dir();
+    rmdir(s_dir);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/**
+ * @brief 只格式化不输出的Appender, 不访问共享数据, 用来测量分发本身的开销
+ */
+class NullLogAppender : public ipmsg::LogAppender {
+public:
+    typedef std::shared_ptr<NullLogAppender> ptr;
+    void append(ipmsg::Logger& logger, ipmsg::LogLevel::Level level, const ipmsg::LogEvent& event) override {
+        static thread_local std::string s_buf;
+        s_buf.clear();
+        m_formatter->format(s_buf, level, event);
+        s_bytes += s_buf.size();
+    }
+    std::string toYamlString() override { return ""; }
+
+    static thread_local uint64_t s_bytes;
+};
+
+thread_local uint64_t NullLogAppender::s_bytes = 0;
+
+/**
+ * @brief 只重写旧接口log()的Appender, 经兼容层每条日志都要构造智能指针
+ */
+class LegacyNullLogAppender : public ipmsg::LogAppender {
+public:
+    void log(ipmsg::Logger::ptr logger, ipmsg::LogLevel::Level level, ipmsg::LogEvent::ptr event) override {
+        static thread_local std::string s_buf;
+        s_buf.clear();
+        m_formatter->format(s_buf, level, *event);
+        NullLogAppender::s_bytes += s_buf.size();
+    }
+    std::string toYamlString() override { return ""; }
+};
+
+static uint64_t now_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+/// 多个线程通过root写日志, 输出每个线程数下的吞吐
+void bench(const char* name, int threads, int lines) {
+    ipmsg::Logger::ptr root = LOG_ROOT();
+    std::vector<ipmsg::Thread::ptr> thrs;
+    uint64_t start = now_us();
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([root, lines]() {
+            for(int j = 0; j < lines; ++j) {
+                LOG_INFO(root) << "scale " << j;
+            }
+        }, "scale_" + std::to_string(i))));
+    }
+    for(auto& t : thrs) {
+        t->join();
+    }
+    uint64_t used = now_us() - start;
+    uint64_t total = (uint64_t)threads * lines;
+    std::cout << name << " threads=" << threads << " lines=" << total
+              << " used=" << used / 1000 << "ms"
+              << " lines/s=" << (used ? total * 1000000 / used : 0) << std::endl;
+}
+
+/// 写日志的同时增删appender, 快照释放不能影响正在遍历的线程
+void test_swap() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("scale"));
+    logger->addAppender(NullLogAppender::ptr(new NullLogAppender));
+    std::atomic<bool> stop{false};
+    std::vector<ipmsg::Thread::ptr> thrs;
+    for(int i = 0; i < 4; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([logger, &stop]() {
+            while(!stop) {
+                LOG_INFO(logger) << "swap";
+            }
+        }, "swap_" + std::to_string(i))));
+    }
+    for(int i = 0; i < 2000; ++i) {
+        NullLogAppender::ptr ap(new NullLogAppender);
+        logger->addAppender(ap);
+        logger->delAppender(ap);
+        if(i % 100 == 0) {
+            std::list<ipmsg::LogAppender::ptr> list{ap, NullLogAppender::ptr(new NullLogAppender)};
+            logger->setAppenders(list);
+        }
+    }
+    stop = true;
+    for(auto& t : thrs) {
+        t->join();
+    }
+    std::cout << "swap ok" << std::endl;
+}
+
+/**
+ * @brief 输出时阻塞直到被放行的Appender
+ */
+class BlockingLogAppender : public ipmsg::LogAppender {
+public:
+    void append(ipmsg::Logger& logger, ipmsg::LogLevel::Level level, const ipmsg::LogEvent& event) override {
+        m_entered = true;
+        while(!m_release) {
+            usleep(1000);
+        }
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<bool> m_entered{false};
+    std::atomic<bool> m_release{false};
+};
+
+/// 阻塞的Appender不能拖住其他线程替换日志目标, 被替换的Appender在输出结束前保持有效
+void test_blocking() {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("scale_blocking"));
+    std::shared_ptr<BlockingLogAppender> blocking(new BlockingLogAppender);
+    std::weak_ptr<BlockingLogAppender> weak = blocking;
+    logger->addAppender(blocking);
+    ipmsg::Thread::ptr thr(new ipmsg::Thread([logger]() {
+        LOG_INFO(logger) << "blocked";
+    }, "blocking"));
+    while(!blocking->m_entered) {
+        usleep(1000);
+    }
+    BlockingLogAppender* raw = blocking.get();
+    blocking.reset();
+    /// 替换会等待宽限期, 输出期间已不在读临界区内
+    uint64_t start = now_us();
+    logger->clearAppenders();
+    assert(now_us() - start < 1000 * 1000);
+    assert(!weak.expired());
+    raw->m_release = true;
+    thr->join();
+    assert(weak.expired());
+    std::cout << "blocking ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_swap();
+    test_blocking();
+
+    int lines = argc > 1 ? atoi(argv[1]) : 100000;
+    /// 旧接口每条日志都要增减root日志器的引用计数, 线程多时在同一缓存行上竞争
+    LOG_ROOT()->setAppenders({ipmsg::LogAppender::ptr(new LegacyNullLogAppender)});
+    for(int threads = 1; threads <= 64; threads *= 2) {
+        bench("legacy", threads, lines / threads * 4);
+    }
+    LOG_ROOT()->setAppenders({NullLogAppender::ptr(new NullLogAppender)});
+    for(int threads = 1; threads <= 64; threads *= 2) {
+        bench("append", threads, lines / threads * 4);
+    }
+    return 0;
+}
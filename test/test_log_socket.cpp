@@ -0,0 +1,165 @@
+#include "ipmsg.h"
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static const char* s_pattern = "%p %m%n";
+
+/**
+ * @brief 绑定Unix域数据报套接字
+ */
+static int bind_unix(const std::string& path, int rcvbuf = 0) {
+    unlink(path.c_str());
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if(rcvbuf) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    int rt = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    assert(rt == 0);
+    return fd;
+}
+
+/**
+ * @brief 收取当前已到达的所有数据报, 返回日志行数
+ */
+static int recv_lines(int fd, int& datagrams, std::string* last = nullptr) {
+    char buf[65536];
+    int lines = 0;
+    while(true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if(n <= 0) {
+            break;
+        }
+        ++datagrams;
+        for(ssize_t i = 0; i < n; ++i) {
+            lines += buf[i] == '\n';
+        }
+        if(last) {
+            last->assign(buf, n);
+        }
+    }
+    return lines;
+}
+
+static ipmsg::Logger::ptr make_logger(const std::string& name, ipmsg::LogAppender::ptr ap) {
+    ipmsg::Logger::ptr logger(new ipmsg::Logger(name));
+    logger->setFormatter(s_pattern);
+    logger->addAppender(ap);
+    return logger;
+}
+
+/// 多条日志合并为少量数据报发出
+void test_unix() {
+    std::string path = "/tmp/test_log_socket_" + std::to_string(getpid()) + ".sock";
+    int fd = bind_unix(path);
+    ipmsg::UnixSocketLogAppender::ptr ap(new ipmsg::UnixSocketLogAppender(path, 512, 100));
+    ipmsg::Logger::ptr logger = make_logger("unix", ap);
+    for(int i = 0; i < 100; ++i) {
+        LOG_INFO(logger) << "unix line " << i;
+    }
+    ap->flush();
+    int datagrams = 0;
+    std::string last;
+    int lines = recv_lines(fd, datagrams, &last);
+    assert(lines == 100);
+    assert(datagrams > 1 && datagrams < 100);
+    assert(ap->getSent() == 100 && ap->getDropped() == 0);
+    assert(last.find("INFO unix line 99\n") != std::string::npos);
+    close(fd);
+    unlink(path.c_str());
+    std::cout << "unix ok datagrams=" << datagrams << std::endl;
+}
+
+/// UDP地址, 以及不调用flush时由后台线程按flush_ms发出
+void test_udp() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int rt = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    assert(rt == 0);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &len);
+    std::string address = "127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+
+    ipmsg::UdpLogAppender::ptr ap(new ipmsg::UdpLogAppender(address, 1400, 50));
+    ipmsg::Logger::ptr logger = make_logger("udp", ap);
+    LOG_WARN(logger) << "udp timed";
+    int datagrams = 0;
+    assert(recv_lines(fd, datagrams) == 0);
+    usleep(500 * 1000);
+    std::string last;
+    assert(recv_lines(fd, datagrams, &last) == 1);
+    assert(last == "WARN udp timed\n");
+    close(fd);
+    std::cout << "udp ok" << std::endl;
+}
+
+/// 接收方不读取时丢弃并计数, 写日志不阻塞
+void test_drop() {
+    std::string path = "/tmp/test_log_socket_drop_" + std::to_string(getpid()) + ".sock";
+    int fd = bind_unix(path, 4096);
+    ipmsg::UnixSocketLogAppender::ptr ap(new ipmsg::UnixSocketLogAppender(path, 1024, 100));
+    ipmsg::Logger::ptr logger = make_logger("drop", ap);
+    const int total = 20000;
+    for(int i = 0; i < total; ++i) {
+        LOG_INFO(logger) << "drop line " << i;
+    }
+    ap->flush();
+    assert(ap->getDropped() > 0);
+    assert(ap->getSent() + ap->getDropped() == (uint64_t)total);
+    std::cout << "drop ok sent=" << ap->getSent() << " dropped=" << ap->getDropped() << std::endl;
+    close(fd);
+    unlink(path.c_str());
+
+    /// 接收方不存在时同样只计数
+    LOG_INFO(logger) << "no receiver";
+    ap->flush();
+    assert(ap->getSent() + ap->getDropped() == (uint64_t)total + 1);
+}
+
+/// 通过YAML配置
+void test_yaml() {
+    std::string path = "/tmp/test_log_socket_yaml_" + std::to_string(getpid()) + ".sock";
+    int fd = bind_unix(path);
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: socket_yaml\n"
+        "    level: info\n"
+        "    formatter: \"%m%n\"\n"
+        "    appenders:\n"
+        "      - type: UnixSocketLogAppender\n"
+        "        address: " + path + "\n"
+        "        batch_bytes: 4K\n"
+        "        flush_ms: 20\n");
+    ipmsg::Config::LoadFromYaml(root);
+    ipmsg::Logger::ptr logger = LOG_NAME("socket_yaml");
+    std::string yaml = logger->toYamlString();
+    assert(yaml.find("UnixSocketLogAppender") != std::string::npos);
+    assert(yaml.find("batch_bytes: 4096") != std::string::npos);
+    LOG_INFO(logger) << "from yaml";
+    logger->flush();
+    int datagrams = 0;
+    std::string last;
+    assert(recv_lines(fd, datagrams, &last) == 1);
+    assert(last == "from yaml\n");
+    close(fd);
+    unlink(path.c_str());
+    std::cout << "yaml ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_unix();
+    test_udp();
+    test_drop();
+    test_yaml();
+    return 0;
+}
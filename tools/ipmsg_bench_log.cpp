@@ -0,0 +1,286 @@
+/**
+* @file ipmsg_bench_log.cpp
+* @brief 日志吞吐与单次调用延迟的基准测试, 结果以JSON输出便于比较不同版本
+*
+*  用法: ipmsg_bench_log [-t max_threads] [-n lines_per_thread] [-d dir] [-f filter] [-o output.json]
+*
+*  每个用例输出 lines_per_sec, ns_per_line(墙钟时间/总条数, 包含最后的flush)
+*  以及单次调用延迟的 p50/p99/p999/max, 均包含timer_overhead_ns的计时开销. 运行期间标准输出被重定向到/dev/null,
+*  未指定-o时JSON写到原来的标准输出
+*/
+#include "ipmsg.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <inttypes.h>
+#include <algorithm>
+
+/**
+ * @brief 日志语句的写法
+ */
+enum MacroKind {
+    /// LOG_INFO(logger) << ...
+    STREAM = 0,
+    /// LOG_FMT_INFO
+    FMT = 1,
+    /// LOG_FMT2_INFO
+    FMT2 = 2
+};
+
+static const char* MacroName(MacroKind kind) {
+    switch(kind) {
+        case FMT: return "fmt";
+        case FMT2: return "fmt2";
+        default: return "stream";
+    }
+}
+
+/**
+ * @brief 基准用例
+ */
+struct BenchCase {
+    /// 用例名称, 同时作为-f过滤的对象
+    std::string name;
+    /// 日志目标的类型
+    std::string appender;
+    MacroKind macro;
+    /// 为true时日志器级别为ERROR, 测量被关闭的INFO语句
+    bool disabled;
+};
+
+/**
+ * @brief 单个用例的结果
+ */
+struct BenchResult {
+    int threads = 0;
+    uint64_t lines = 0;
+    double seconds = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+static uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+/**
+ * @brief 创建用例的日志目标, 文件类目标写到dir下
+ */
+static ipmsg::LogAppender::ptr CreateAppender(const std::string& type, const std::string& file) {
+    if(type == "stdout") {
+        return ipmsg::LogAppender::ptr(new ipmsg::StdoutLogAppender);
+    } else if(type == "file") {
+        return ipmsg::LogAppender::ptr(new ipmsg::FileLogAppender(file));
+    } else if(type == "file_buffered") {
+        ipmsg::FileLogAppender::ptr ap(new ipmsg::FileLogAppender(file));
+        ap->setBuffer(64 * 1024);
+        return ap;
+    } else if(type == "async_file") {
+        return ipmsg::LogAppender::ptr(new ipmsg::AsyncLogAppender(file));
+    } else if(type == "mmap_file") {
+        return ipmsg::LogAppender::ptr(new ipmsg::MmapFileLogAppender(file, 16 * 1024 * 1024));
+    } else if(type == "binary_file") {
+        return ipmsg::LogAppender::ptr(new ipmsg::BinaryFileLogAppender(file));
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 单个线程写lines条日志, 记录每次调用的耗时
+ */
+static void WriteLines(ipmsg::Logger::ptr logger, MacroKind macro, int lines, std::vector<uint32_t>& lat) {
+    const char* name = "bench";
+    std::string sname = name;
+    lat.resize(lines);
+    for(int i = 0; i < lines; ++i) {
+        uint64_t start = NowNs();
+        switch(macro) {
+            case STREAM:
+                LOG_INFO(logger) << "bench line " << i << " value=" << 3.25 << " name=" << sname;
+                break;
+            case FMT:
+                LOG_FMT_INFO(logger, "bench line %d value=%g name=%s", i, 3.25, name);
+                break;
+            case FMT2:
+                LOG_FMT2_INFO(logger, "bench line %d value=%g name=%s", i, 3.25, sname);
+                break;
+        }
+        lat[i] = std::min(NowNs() - start, (uint64_t)UINT32_MAX);
+    }
+}
+
+static BenchResult RunCase(const BenchCase& c, int threads, int lines, const std::string& dir) {
+    std::string file = dir + "/" + c.name + ".log";
+    ipmsg::Logger::ptr logger(new ipmsg::Logger("bench"));
+    logger->setLevel(c.disabled ? ipmsg::LogLevel::ERROR : ipmsg::LogLevel::DEBUG);
+    ipmsg::LogAppender::ptr ap = CreateAppender(c.appender, file);
+    if(ap) {
+        logger->addAppender(ap);
+    }
+
+    std::vector<std::vector<uint32_t> > lat(threads);
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<ipmsg::Thread::ptr> thrs;
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(ipmsg::Thread::ptr(new ipmsg::Thread([&, i]() {
+            ++ready;
+            while(!go) {
+                sched_yield();
+            }
+            WriteLines(logger, c.macro, lines, lat[i]);
+        }, "bench_" + std::to_string(i))));
+    }
+    while(ready != threads) {
+        sched_yield();
+    }
+    uint64_t start = NowNs();
+    go = true;
+    for(auto& t : thrs) {
+        t->join();
+    }
+    /// 异步与缓冲的目标需要写出后才算完成
+    logger->flush();
+    uint64_t used = NowNs() - start;
+
+    logger->clearAppenders();
+    ap.reset();
+    unlink(file.c_str());
+
+    std::vector<uint32_t> all;
+    all.reserve((size_t)threads * lines);
+    for(auto& v : lat) {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    BenchResult r;
+    r.threads = threads;
+    r.lines = all.size();
+    r.seconds = used / 1e9;
+    if(!all.empty()) {
+        auto at = [&all](double q) {
+            size_t n = std::min(all.size() - 1, (size_t)(q * all.size()));
+            std::nth_element(all.begin(), all.begin() + n, all.end());
+            return (uint64_t)all[n];
+        };
+        r.p50 = at(0.5);
+        r.p99 = at(0.99);
+        r.p999 = at(0.999);
+        r.max = *std::max_element(all.begin(), all.end());
+    }
+    return r;
+}
+
+/**
+ * @brief 测量两次读取时钟本身的耗时(中位数), 延迟和吞吐中都包含这部分开销
+ */
+static uint64_t TimerOverhead() {
+    std::vector<uint64_t> v(10000);
+    for(auto& i : v) {
+        uint64_t start = NowNs();
+        i = NowNs() - start;
+    }
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    return v[v.size() / 2];
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-t max_threads] [-n lines_per_thread] [-d dir] [-f filter] [-o output.json]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int max_threads = 4;
+    int lines = 100000;
+    std::string dir = "/tmp";
+    std::string filter;
+    std::string output;
+    int opt;
+    while((opt = getopt(argc, argv, "t:n:d:f:o:h")) != -1) {
+        switch(opt) {
+            case 't':
+                max_threads = std::max(1, atoi(optarg));
+                break;
+            case 'n':
+                lines = std::max(1, atoi(optarg));
+                break;
+            case 'd':
+                dir = optarg;
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    std::vector<BenchCase> cases = {
+        {"disabled_stream", "file", STREAM, true},
+        {"disabled_fmt", "file", FMT, true},
+        {"disabled_fmt2", "file", FMT2, true},
+        {"stdout_stream", "stdout", STREAM, false},
+        {"file_stream", "file", STREAM, false},
+        {"file_fmt", "file", FMT, false},
+        {"file_fmt2", "file", FMT2, false},
+        {"file_buffered_stream", "file_buffered", STREAM, false},
+        {"async_file_stream", "async_file", STREAM, false},
+        {"mmap_file_stream", "mmap_file", STREAM, false},
+        {"binary_file_stream", "binary_file", STREAM, false},
+    };
+    std::vector<int> thread_counts;
+    for(int t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);
+
+    /// StdoutLogAppender的输出丢弃, JSON写到原来的标准输出或-o指定的文件
+    fflush(stdout);
+    int out_fd = output.empty() ? dup(STDOUT_FILENO)
+        : open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out_fd < 0) {
+        perror("open output");
+        return 1;
+    }
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    /// 默认的root日志器也会写标准输出, 基准过程中关闭
+    LOG_ROOT()->setLevel(ipmsg::LogLevel::FATAL);
+
+    FILE* out = fdopen(out_fd, "w");
+    fprintf(out, "{\n  \"lines_per_thread\": %d,\n  \"timer_overhead_ns\": %" PRIu64 ",\n  \"cases\": ["
+            ,lines, TimerOverhead());
+    bool first = true;
+    for(auto& c : cases) {
+        if(!filter.empty() && c.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        for(int t : thread_counts) {
+            BenchResult r = RunCase(c, t, lines, dir);
+            double lps = r.seconds > 0 ? r.lines / r.seconds : 0;
+            double ns = r.lines ? r.seconds * 1e9 / r.lines : 0;
+            fprintf(stderr, "%-22s threads=%-3d lines/s=%-12.0f ns/line=%-9.1f p50=%" PRIu64
+                    " p99=%" PRIu64 " p999=%" PRIu64 "\n",
+                    c.name.c_str(), t, lps, ns, r.p50, r.p99, r.p999);
+            fprintf(out, "%s\n    {\"name\": \"%s\", \"appender\": \"%s\", \"macro\": \"%s\", "
+                    "\"disabled\": %s, \"threads\": %d, \"lines\": %" PRIu64 ", \"seconds\": %.6f, "
+                    "\"lines_per_sec\": %.0f, \"ns_per_line\": %.1f, \"p50_ns\": %" PRIu64
+                    ", \"p99_ns\": %" PRIu64 ", \"p999_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64 "}",
+                    first ? "" : ",", c.name.c_str(), c.appender.c_str(), MacroName(c.macro),
+                    c.disabled ? "true" : "false", t, r.lines, r.seconds, lps, ns,
+                    r.p50, r.p99, r.p999, r.max);
+            first = false;
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,62 @@
+/**
+* @file ipmsg_logcat.cpp
+* @brief 将BinaryFileLogAppender输出的二进制日志还原为文本
+*
+*  用法: ipmsg_logcat [-p pattern] file...
+*/
+#include "ipmsg.h"
+#include <unistd.h>
+#include <stdio.h>
+
+static const char* s_default_pattern
+    = "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-p pattern] file...\n", prog);
+}
+
+int main(int argc, char** argv) {
+    std::string pattern = s_default_pattern;
+    int opt;
+    while((opt = getopt(argc, argv, "p:h")) != -1) {
+        switch(opt) {
+            case 'p':
+                pattern = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ipmsg::LogFormatter formatter(pattern);
+    if(formatter.isError()) {
+        fprintf(stderr, "invalid pattern: %s\n", pattern.c_str());
+        return 1;
+    }
+
+    int rt = 0;
+    std::string out;
+    for(int i = optind; i < argc; ++i) {
+        ipmsg::BinaryLogReader reader(argv[i]);
+        if(!reader.isOpen()) {
+            fprintf(stderr, "open %s failed\n", argv[i]);
+            rt = 1;
+            continue;
+        }
+        while(ipmsg::LogEvent::ptr event = reader.next()) {
+            out.clear();
+            formatter.format(out, event->getLevel(), *event);
+            fwrite(out.data(), 1, out.size(), stdout);
+        }
+        if(reader.isError()) {
+            fprintf(stderr, "%s: corrupt record, stop decoding\n", argv[i]);
+            rt = 1;
+        }
+    }
+    return rt;
+}